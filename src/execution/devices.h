@@ -24,6 +24,7 @@
 #include <tuple>
 #include <ostream>
 
+#include "config.h"
 #include "utils/macros.h"
 
 namespace salus {
@@ -78,6 +79,16 @@ namespace devices {
 constexpr DeviceSpec CPU0 {DeviceType::CPU, 0};
 constexpr DeviceSpec GPU0 {DeviceType::GPU, 0};
 constexpr DeviceSpec GPU1 {DeviceType::GPU, 1};
+
+// Upper bound of GPUs tracked in per session usage accounting
+constexpr int kMaxGPUs = 5;
+
+// GPUs the scheduler places ops on and pages from
+#if defined(SALUS_ENABLE_MULTI_DEVICE)
+constexpr int kNumScheduledGPUs = kMaxGPUs;
+#else
+constexpr int kNumScheduledGPUs = 1;
+#endif
 } // namespace devices
 
 } // namespace salus
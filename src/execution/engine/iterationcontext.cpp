@@ -28,7 +28,8 @@ namespace salus {
 
 void IterationContext::scheduleTask(std::unique_ptr<OperationTask> &&task)
 {
-    auto opItem = std::make_shared<OperationItem>();
+    // item and its control block come from one recycled block of the session's pool
+    auto opItem = std::allocate_shared<OperationItem>(sstl::PoolAllocator<OperationItem>(m_item->opItemPool));
     opItem->sess = m_item;
     opItem->op = std::move(task);
     LogOpTracing() << "OpItem Event " << opItem->op << " event: queued";
@@ -36,8 +37,14 @@ void IterationContext::scheduleTask(std::unique_ptr<OperationTask> &&task)
     m_taskExec.queueTask(std::move(opItem));
 }
 
-void IterationContext::finish()
+void IterationContext::finish(bool completed)
 {
+    using std::chrono::duration_cast;
+    if (completed) {
+        m_item->recordIterationDuration(
+            m_graphId, duration_cast<IterDurationModel::Duration>(SchedClock::now() - m_start));
+    }
+
     if (m_done) {
         m_done(*m_item);
     }
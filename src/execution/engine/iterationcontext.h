@@ -20,8 +20,10 @@
 #ifndef SALUS_EXEC_ITERATIONCONTEXT_H
 #define SALUS_EXEC_ITERATIONCONTEXT_H
 
+#include "execution/scheduler/schedclock.h"
 #include "execution/scheduler/sessionitem.h"
 
+#include <chrono>
 #include <functional>
 
 namespace salus {
@@ -30,7 +32,8 @@ class IterationContext
 {
     TaskExecutor &m_taskExec;
     PSessionItem m_item;
-    uint64_t m_graphId;
+    uint64_t m_graphId = 0;
+    std::chrono::system_clock::time_point m_start;
 
     using DoneCallback = std::function<void (SessionItem &)>;
     DoneCallback m_done;
@@ -39,6 +42,7 @@ public:
     IterationContext(TaskExecutor &taskExec, PSessionItem item, DoneCallback done)
         : m_taskExec(taskExec)
         , m_item(std::move(item))
+        , m_start(SchedClock::now())
         , m_done(std::move(done))
     {
     }
@@ -57,7 +61,13 @@ public:
         return m_graphId;
     }
 
-    void finish();
+    /**
+     * @brief Mark the iteration as ended.
+     * @param completed Whether the iteration ran to completion. Only completed iterations
+     * feed the session's iteration duration model, so canceled or preempted runs don't
+     * skew its predictions with partial durations.
+     */
+    void finish(bool completed = true);
 };
 
 } // namespace salus
@@ -20,7 +20,6 @@
 #include "execution/engine/resourcecontext.h"
 
 #include "execution/engine/allocationlistener.h"
-#include "utils/containerutils.h"
 #include "utils/threadutils.h"
 
 #include <utility>
@@ -66,13 +65,13 @@ ResourceContext::OperationScope ResourceContext::alloc(ResourceType type) const
 {
     OperationScope scope(*this, resMon.lock());
 
+    ResourceTag tag{type, m_spec};
     auto staging = scope.proxy.queryStaging(m_ticket);
-    auto num = sstl::optionalGet(staging, {type, m_spec});
-    if (!num) {
+    if (!staging || !staging->has(tag)) {
         return scope;
     }
 
-    scope.res[{type, m_spec}] = *num;
+    scope.res.set(tag, staging->get(tag));
     scope.valid = scope.proxy.allocate(m_ticket, scope.res);
 
     return scope;
@@ -82,7 +81,7 @@ ResourceContext::OperationScope ResourceContext::alloc(ResourceType type, size_t
 {
     OperationScope scope(*this, resMon.lock());
 
-    scope.res[{type, m_spec}] = num;
+    scope.res.set({type, m_spec}, num);
     scope.valid = scope.proxy.allocate(m_ticket, scope.res);
 
     return scope;
@@ -91,7 +90,8 @@ ResourceContext::OperationScope ResourceContext::alloc(ResourceType type, size_t
 void ResourceContext::dealloc(ResourceType type, size_t num) const
 {
     ResourceTag tag{type, m_spec};
-    Resources res{{tag, num}};
+    DenseResources res;
+    res.set(tag, num);
 
     bool last = resMon.free(m_ticket, res);
     for (const auto &l : m_listeners) {
@@ -111,13 +111,20 @@ void ResourceContext::OperationScope::commit()
     if (!valid) {
         return;
     }
+    valid = false;
+
+    // Listeners take session locks, which paging holds while calling into the monitor,
+    // so unlock the monitor before notifying them.
+    {
+        auto unlock = std::move(proxy);
+    }
 
     // the allocation is used by the session (i.e. the session left the scope without rollback)
-    for (auto [tag, val] : res) {
+    res.forEach([this](const auto &tag, auto val) {
         for (const auto &l : context.m_listeners) {
             l->notifyAlloc(context.m_graphId, context.ticket(), tag, val);
         }
-    }
+    });
 }
 
 std::ostream &operator<<(std::ostream &os, const ResourceContext &c)
@@ -116,7 +116,7 @@ public:
 
         void rollback();
 
-        const Resources &resources() const
+        const DenseResources &resources() const
         {
             return res;
         }
@@ -128,7 +128,7 @@ public:
 
         bool valid;
         ResourceMonitor::LockedProxy proxy;
-        Resources res;
+        DenseResources res;
         const ResourceContext &context;
     };
 
@@ -34,6 +34,7 @@ using std::chrono::microseconds;
 using std::chrono::milliseconds;
 using std::chrono::nanoseconds;
 using std::chrono::seconds;
+using std::chrono::steady_clock;
 using std::chrono::system_clock;
 using FpSeconds = std::chrono::duration<double, seconds::period>;
 using namespace std::chrono_literals;
@@ -42,13 +43,18 @@ using namespace date;
 namespace salus {
 
 namespace {
-inline void logScheduleFailure(const Resources &usage, const ResourceMonitor &resMon)
+// Upper bound on how long blocked tasks wait before being retried when nothing wakes up the scheduler
+constexpr auto kBlockedRetryInterval = 1ms;
+// How often session counters are aggregated into the performance log
+constexpr auto kStatsReportInterval = 100ms;
+
+inline void logScheduleFailure(const DenseResources &usage, const ResourceMonitor &resMon)
 {
     UNUSED(usage);
     UNUSED(resMon);
 
 #ifndef NDEBUG
-    VLOG(2) << "Try to allocate resource failed. Requested: " << usage;
+    VLOG(2) << "Try to allocate resource failed. Requested: " << usage.toResources();
     // Don't call resMon.DebugString directly in log line, as logging acquires lock, and
     // may causing deadlock.
     const auto &str = resMon.DebugString();
@@ -81,6 +87,8 @@ TaskExecutor::TaskExecutor(ThreadPool &pool, ResourceMonitor &resMonitor, Schedu
 {
 }
 
+TaskExecutor::~TaskExecutor() = default;
+
 void TaskExecutor::startExecution()
 {
     // Start scheduling thread
@@ -94,9 +102,16 @@ void TaskExecutor::stopExecution()
     // unblock scheduling thread
     m_note_has_work.notify();
 
-    if (m_schedThread->joinable()) {
+    if (m_schedThread && m_schedThread->joinable()) {
         m_schedThread->join();
     }
+
+    // paging job refers to this
+    while (m_pagingJobs > 0) {
+        m_pagingFinished.wait_for(10ms);
+    }
+
+    LOG(INFO) << "Op placement counters:\n" << m_costModel.dumpCounters();
 }
 
 void TaskExecutor::insertSession(PSessionItem sess)
@@ -130,6 +145,20 @@ void TaskExecutor::queueTask(POpItem &&opItem)
     }
 
     item->queueTask(std::move(opItem));
+    markReady(item);
+}
+
+void TaskExecutor::markReady(const PSessionItem &item)
+{
+    if (item->inReadySet.exchange(true)) {
+        // already in ready set, will be looked at in next pass
+        return;
+    }
+
+    {
+        auto g = sstl::with_guard(m_readyMu);
+        m_readySessions.emplace_back(item);
+    }
     m_note_has_work.notify();
 }
 
@@ -137,212 +166,380 @@ void TaskExecutor::scheduleLoop()
 {
     threading::set_thread_name("TaskExecutor");
 
-    auto scheduler = SchedulerRegistary::instance().create(m_schedParam.scheduler, *this);
-    DCHECK(scheduler);
-    VLOG(2) << "Using scheduler: " << scheduler;
+    m_scheduler = SchedulerRegistary::instance().create(m_schedParam.scheduler, *this);
+    DCHECK(m_scheduler);
+    VLOG(2) << "Using scheduler: " << m_scheduler;
     LOG(INFO) << "TaskExecutor scheduling thread started";
 
     m_nRunningTasks = 0;
     m_nNoPagingRunningTasks = 0;
 
-    size_t schedIterCount = 0;
-    boost::container::small_vector<PSessionItem, 5> candidates;
-    bool interrupted = false;
+    m_perfLogEnabled = logging::perfLogEnabled();
+    m_nextStatsReport = steady_clock::now();
 
     while (!m_shouldExit) {
-        SessionChangeSet changeset;
-        // First accept and append any new sessions
-        {
-            auto g = sstl::with_guard(m_newMu);
-
-            changeset.numAddedSessions = m_newSessions.size();
+        size_t totalRemainingCount = 0;
+        size_t scheduled = 0;
+        if (!schedulePass(totalRemainingCount, scheduled)) {
+            break;
+        }
 
-            if (changeset.numAddedSessions) {
-                // list::splice doesn't invalidate iterators, so use
-                // m_newSessions.begin() here is ok, and a must.
-                changeset.addedSessionBegin = m_newSessions.begin();
-                changeset.addedSessionEnd = m_sessions.end();
+        if (m_perfLogEnabled) {
+            maybeReportStats();
+        }
 
-                m_sessions.splice(m_sessions.end(), m_newSessions);
-            } else {
-                changeset.addedSessionBegin = m_sessions.end();
-                changeset.addedSessionEnd = m_sessions.end();
-            }
-            DCHECK(m_newSessions.empty());
+        // keep checking for sessions to finish
+        if (m_interrupted) {
+            continue;
         }
 
-        // then check if there's any pending deletions.
-        // NOTE: this must happen after adding new sessions.
-        // because newly added sessions may be deleted immediately
-        // and the remove_if code below can't find it
-        {
-            auto g = sstl::with_guard(m_delMu);
+        maybeWaitForAWhile(scheduled);
 
-            using std::swap;
-            swap(changeset.deletedSessions, m_deletedSessions);
-            DCHECK(m_deletedSessions.empty());
+        if (!totalRemainingCount) {
+            VLOG(2) << "TaskExecutor wait on m_note_has_work";
+            m_note_has_work.wait();
+        } else if (!scheduled) {
+            // Every pending task is blocked. Task completion wakes us up, but resources may also
+            // be freed elsewhere (e.g. tensor deallocation), so don't sleep forever.
+            m_note_has_work.wait_for(kBlockedRetryInterval);
         }
+    }
 
-        if (VLOG_IS_ON(2)) {
-            for (auto sit = changeset.addedSessionBegin; sit != changeset.addedSessionEnd; ++sit) {
-                VLOG(2) << "TaskExecutor accepting session " << (*sit)->sessHandle;
-            }
-            for (const auto &sess : changeset.deletedSessions) {
-                VLOG(2) << "TaskExecutor deleting session " << sess->sessHandle;
-            }
+    // Cleanup
+    CHECK(m_deletedSessions.empty());
+    CHECK(m_newSessions.empty());
+    CHECK(m_sessions.empty());
+    LOG(INFO) << "TaskExecutor stopped";
+}
+
+void TaskExecutor::maybeReportStats()
+{
+    auto now = steady_clock::now();
+    if (now < m_nextStatsReport) {
+        return;
+    }
+    m_nextStatsReport = now + kStatsReportInterval;
+
+    CLOG(INFO, logging::kPerfTag)
+        << "Scheduler iter stat: " << m_schedIterCount << " running: " << m_nRunningTasks
+        << " noPageRunning: " << m_nNoPagingRunningTasks << " passes: " << m_schedIterCount - m_reportedIterCount
+        << " sessions: " << m_sessions.size() << " blocked: " << m_blockedSessions.size();
+    m_reportedIterCount = m_schedIterCount;
+
+    // Worker counters are only kept with SALUS_ENABLE_THREADPOOL_STATS, and are all 0 with no workers
+    // listed otherwise. Overflow counters are always kept.
+    auto workers = m_pool.workerStats();
+    ThreadPool::WorkerStats total;
+    for (const auto &ws : workers) {
+        total.tasks += ws.tasks;
+        total.localTasks += ws.localTasks;
+        total.stolenTasks += ws.stolenTasks;
+        total.overflowTasks += ws.overflowTasks;
+        total.stealAttempts += ws.stealAttempts;
+        total.spins += ws.spins;
+        total.parks += ws.parks;
+        total.unparks += ws.unparks;
+        total.maxQueueDepth = std::max(total.maxQueueDepth, ws.maxQueueDepth);
+    }
+    auto overflow = m_pool.overflowStats();
+    CLOG(INFO, logging::kPerfTag)
+        << "ThreadPool stat: workers: " << workers.size() << " tasks: " << total.tasks
+        << " local: " << total.localTasks << " stolen: " << total.stolenTasks
+        << " overflow: " << total.overflowTasks << " steal_attempts: " << total.stealAttempts
+        << " spins: " << total.spins << " parks: " << total.parks << " unparks: " << total.unparks
+        << " max_queue_depth: " << total.maxQueueDepth << " overflowed: " << overflow.overflowed
+        << " inlined: " << overflow.inlined << " rejected: " << overflow.rejected
+        << " overflow_depth: " << overflow.depth << " max_overflow_depth: " << overflow.maxDepth;
+
+    for (auto &item : m_sessions) {
+        auto snap = item->stats.snapshot();
+        const auto &last = item->reportedStats;
+        auto queueTime = snap.queueTimeUs.since(last.queueTimeUs);
+        if (snap.queued == last.queued && snap.scheduled == last.scheduled && item->bgQueue.empty()) {
+            // idle since last report
+            continue;
         }
+        CLOG(INFO, logging::kPerfTag)
+            << "Sched iter " << m_schedIterCount << " session: " << item->sessHandle
+            << " pending: " << item->bgQueue.size() << " scheduled: " << snap.scheduled - last.scheduled << " "
+            << m_scheduler->debugString(item) << " queued: " << snap.queued - last.queued
+            << " blocked: " << snap.blocked - last.blocked << " paged: " << snap.paged - last.paged
+            << " queue_us_p50: " << queueTime.quantile(0.5) << " queue_us_p99: " << queueTime.quantile(0.99);
+        item->reportedStats = std::move(snap);
+    }
+}
 
-        // Delete sessions as requested
-        // NOTE: don't clear del yet, we need that in changeset for scheduling
-        m_sessions.remove_if([&changeset](auto sess) {
-            bool deleted = changeset.deletedSessions.count(sess) > 0;
-            if (deleted) {
-                LOG(INFO) << "Deleting session " << sess->sessHandle << "@" << as_hex(sess);
-                if (sess->cleanupCb) {
-                    sess->cleanupCb();
-                    // reset cb to release anything that may depend on this
-                    // before going out of destructor.
-                    sess->cleanupCb = nullptr;
-                }
+void TaskExecutor::runSchedulingPass()
+{
+    CHECK(!m_schedThread) << "Scheduling thread is running";
 
-                // The deletion of session's executor is async to this thread.
-                // So it's legit for tickets to be nonempty
-                // DCHECK(item->tickets.empty());
+    if (!m_scheduler) {
+        m_scheduler = SchedulerRegistary::instance().create(m_schedParam.scheduler, *this);
+        DCHECK(m_scheduler);
+    }
 
-                // Fix the addedSessionBegin iterator if we are to delete it
-                if (changeset.addedSessionBegin != changeset.addedSessionEnd && *changeset.addedSessionBegin == sess) {
-                    ++changeset.addedSessionBegin;
-                }
-            }
-            return deleted;
-        });
-
-        if (m_interrupting && !interrupted) {
-            interrupted = true;
-            // Request interrupt on any existing sessions
-            for (const auto &sess : m_sessions) {
-                sess->interrupt();
+    size_t totalRemainingCount = 0;
+    size_t scheduled = 0;
+    schedulePass(totalRemainingCount, scheduled);
+}
+
+bool TaskExecutor::schedulePass(size_t &totalRemainingCount, size_t &scheduled)
+{
+    // Take sessions with new tasks. This must happen before accepting new sessions,
+    // so any session in it that is not accepted yet has already been deleted.
+    std::vector<PSessionItem> ready;
+    {
+        auto g = sstl::with_guard(m_readyMu);
+        using std::swap;
+        swap(ready, m_readySessions);
+    }
+
+    SessionChangeSet changeset;
+    // First accept and append any new sessions
+    {
+        auto g = sstl::with_guard(m_newMu);
+
+        changeset.numAddedSessions = m_newSessions.size();
+
+        if (changeset.numAddedSessions) {
+            // list::splice doesn't invalidate iterators, so use
+            // m_newSessions.begin() here is ok, and a must.
+            changeset.addedSessionBegin = m_newSessions.begin();
+            changeset.addedSessionEnd = m_sessions.end();
+
+            for (auto &sess : m_newSessions) {
+                sess->accepted = true;
             }
+            m_sessions.splice(m_sessions.end(), m_newSessions);
+        } else {
+            changeset.addedSessionBegin = m_sessions.end();
+            changeset.addedSessionEnd = m_sessions.end();
         }
+        DCHECK(m_newSessions.empty());
+    }
 
-        // Prepare session ready for this iter of schedule:
-        // - move from front end queue to backing storage
-        // - reset lastScheduled
-        size_t totalRemainingCount = 0;
+    // then check if there's any pending deletions.
+    // NOTE: this must happen after adding new sessions.
+    // because newly added sessions may be deleted immediately
+    // and the remove_if code below can't find it
+    {
+        auto g = sstl::with_guard(m_delMu);
 
-        // since iteration based execution, we can enable this
-        const bool enableOOMProtect = true;
-        for (auto &item : m_sessions) {
-            {
-                auto g = sstl::with_guard(item->mu);
-                item->bgQueue.splice(item->bgQueue.end(), item->queue);
+        using std::swap;
+        swap(changeset.deletedSessions, m_deletedSessions);
+        DCHECK(m_deletedSessions.empty());
+    }
+
+    if (VLOG_IS_ON(2)) {
+        for (auto sit = changeset.addedSessionBegin; sit != changeset.addedSessionEnd; ++sit) {
+            VLOG(2) << "TaskExecutor accepting session " << (*sit)->sessHandle;
+        }
+        for (const auto &sess : changeset.deletedSessions) {
+            VLOG(2) << "TaskExecutor deleting session " << sess->sessHandle;
+        }
+    }
+
+    // Delete sessions as requested
+    // NOTE: don't clear del yet, we need that in changeset for scheduling
+    m_sessions.remove_if([&changeset](auto sess) {
+        bool deleted = changeset.deletedSessions.count(sess) > 0;
+        if (deleted) {
+            sess->accepted = false;
+            LOG(INFO) << "Deleting session " << sess->sessHandle << "@" << as_hex(sess);
+            if (sess->cleanupCb) {
+                sess->cleanupCb();
+                // reset cb to release anything that may depend on this
+                // before going out of destructor.
+                sess->cleanupCb = nullptr;
             }
 
-            if (item->forceEvicted) {
-                VLOG(2) << "Canceling pending tasks in forced evicted seesion: " << item->sessHandle;
-                // cancel all pending tasks
-                for (auto &opItem : item->bgQueue) {
-                    opItem->op->cancel();
-                }
-                item->bgQueue.clear();
+            // The deletion of session's executor is async to this thread.
+            // So it's legit for tickets to be nonempty
+            // DCHECK(item->tickets.empty());
+
+            // Fix the addedSessionBegin iterator if we are to delete it
+            if (changeset.addedSessionBegin != changeset.addedSessionEnd && *changeset.addedSessionBegin == sess) {
+                ++changeset.addedSessionBegin;
             }
+        }
+        return deleted;
+    });
 
-            totalRemainingCount += item->bgQueue.size();
+    if (m_interrupting && !m_interrupted) {
+        m_interrupted = true;
+        // Request interrupt on any existing sessions
+        for (const auto &sess : m_sessions) {
+            sess->interrupt();
+        }
+    }
 
-            item->protectOOM = enableOOMProtect;
-            item->lastScheduled = 0;
+    // Only look at sessions with new tasks, plus sessions left with pending tasks if
+    // anything could have unblocked them since last pass.
+    const auto releaseEpoch = m_resMonitor.releaseEpoch();
+    const bool retryRequested = m_retryBlocked.exchange(false);
+    const bool retryBlocked = m_interrupted || m_lastPassScheduled > 0 || retryRequested
+                              || releaseEpoch != m_lastReleaseEpoch;
+    m_lastReleaseEpoch = releaseEpoch;
+
+    boost::container::small_vector<PSessionItem, 5> active;
+    auto activate = [&active](const PSessionItem &item) {
+        if (item->accepted && !item->activeInPass) {
+            item->activeInPass = true;
+            active.emplace_back(item);
         }
+    };
+    for (auto &item : ready) {
+        // clear before draining the queue, so tasks arriving after that mark it again.
+        // This also covers a push still in progress when draining, which pop can't see yet.
+        item->inReadySet = false;
+        activate(item);
+    }
+    sstl::erase_if(m_blockedSessions, [&](const auto &item) {
+        if (!item->accepted) {
+            return true;
+        }
+        if (retryBlocked) {
+            activate(item);
+        }
+        return item->activeInPass;
+    });
 
-        if (interrupted) {
-            // only do session acception and deletion if interrupted
-            changeset.deletedSessions.clear();
-            if (m_sessions.empty()) {
-                break;
-            } else {
-                LOG(INFO) << "Waiting for " << m_sessions.size() << " sessions to finish";
+    // Prepare session ready for this iter of schedule:
+    // - move from front end queue to backing storage
+    // - reset lastScheduled
+    // since iteration based execution, we can enable this
+    const bool enableOOMProtect = true;
+    // scavenger sessions are only scheduled when no normal session has pending ops
+    bool normalPending = false;
+    for (auto &item : active) {
+        item->queue.drainTo(item->bgQueue);
+
+        if (item->forceEvicted) {
+            VLOG(2) << "Canceling pending tasks in forced evicted seesion: " << item->sessHandle;
+            // cancel all pending tasks
+            for (auto &opItem : item->bgQueue) {
+                opItem->op->cancel();
             }
-            continue;
+            item->bgQueue.clear();
         }
 
-        // Select and sort candidates.
-        scheduler->notifyPreSchedulingIteration(m_sessions, changeset, &candidates);
+        totalRemainingCount += item->bgQueue.size();
+        normalPending = normalPending || (!item->scavenger && !item->bgQueue.empty());
 
-        // Deleted sessions are no longer needed, release them.
+        item->protectOOM = enableOOMProtect;
+        item->lastScheduled = 0;
+    }
+    for (auto &item : m_blockedSessions) {
+        totalRemainingCount += item->bgQueue.size();
+        normalPending = normalPending || (!item->scavenger && !item->bgQueue.empty());
+    }
+
+    // Sessions still having pending tasks wait in blocked list until next retry
+    auto settleActive = [this, &active]() {
+        for (auto &item : active) {
+            item->activeInPass = false;
+            if (!item->bgQueue.empty()) {
+                item->stats.blocked.fetch_add(1, std::memory_order_relaxed);
+                m_blockedSessions.emplace_back(item);
+            }
+        }
+        m_hasBlocked = !m_blockedSessions.empty();
+    };
+
+    if (m_interrupted) {
+        // only do session acception and deletion if interrupted
+        settleActive();
         changeset.deletedSessions.clear();
+        if (m_sessions.empty()) {
+            return false;
+        }
+        LOG(INFO) << "Waiting for " << m_sessions.size() << " sessions to finish";
+        return true;
+    }
 
-        // Schedule tasks from candidate sessions
-        // NOTE: remainingCount only counts for candidate sessions in this sched iter.
-        size_t remainingCount = 0;
-        size_t scheduled = 0;
-        for (auto &item : candidates) {
-            VLOG(3) << "Scheduling all opItem in session " << item->sessHandle << ": queue size "
-                    << item->bgQueue.size();
+    if (active.empty() && changeset.numAddedSessions == 0 && changeset.deletedSessions.empty()) {
+        // nothing changed since last pass
+        m_lastPassScheduled = 0;
+        m_hasBlocked = !m_blockedSessions.empty();
+        return true;
+    }
+    ++m_schedIterCount;
+
+    // Select and sort candidates.
+    boost::container::small_vector<PSessionItem, 5> candidates;
+    m_scheduler->notifyPreSchedulingIteration(m_sessions, changeset, &candidates);
 
-            // Try schedule from this session
-            auto [count, shouldContinue] = scheduler->maybeScheduleFrom(item);
-            item->lastScheduled = count;
+    // Deleted sessions are no longer needed, release them.
+    changeset.deletedSessions.clear();
 
+    // Schedule tasks from candidate sessions
+    // NOTE: remainingCount only counts for candidate sessions in this sched iter.
+    size_t remainingCount = 0;
+    for (auto &item : candidates) {
+        if (!item->activeInPass) {
+            // nothing new to schedule from this session since last pass
             remainingCount += item->bgQueue.size();
-            scheduled += item->lastScheduled;
-
-            if (!shouldContinue) {
+            if (!m_scheduler->continueAfterIdle()) {
                 break;
             }
+            continue;
         }
 
-        // Log performance counters
-        CLOG(INFO, logging::kPerfTag)
-            << "Scheduler iter stat: " << schedIterCount << " running: " << m_nRunningTasks
-            << " noPageRunning: " << m_nNoPagingRunningTasks;
-        for (auto &item : m_sessions) {
-            CLOG(INFO, logging::kPerfTag)
-                << "Sched iter " << schedIterCount << " session: " << item->sessHandle
-                << " pending: " << item->bgQueue.size() << " scheduled: " << item->lastScheduled << " "
-                << scheduler->debugString(item);
+        if (item->scavenger && normalPending) {
+            VLOG(3) << "Skipping scavenger session " << item->sessHandle << " with normal work pending";
+            remainingCount += item->bgQueue.size();
+            continue;
         }
 
-        // Update conditions and check if we need paging
-        bool noProgress = remainingCount > 0 && scheduled == 0 && m_nNoPagingRunningTasks == 0;
-        reportNoProgress(noProgress);
-
-        /*
-        bool didPaging = false;
-        // TODO: we currently assume we are paging GPU memory to CPU
-        for (const auto &dev : {devices::GPU0}) {
-            if (noProgress && scheduler->insufficientMemory(dev)) {
-                if (m_sessions.size() > 1) {
-                    didPaging = doPaging(dev, devices::CPU0);
-                } else if (m_sessions.size() == 1) {
-                    LOG(ERROR) << "OOM on device " << dev
-                               << " for single session happened: " << m_sessions.front()->sessHandle;
-                    {
-                        auto g = sstl::with_guard(m_sessions.front()->tickets_mu);
-                        auto usage = m_resMonitor.queryUsages(m_sessions.front()->tickets);
-                        LOG(ERROR) << "This session usage:" << resources::DebugString(usage);
-                    }
-                    LOG(ERROR) << m_resMonitor.DebugString();
-                }
-            }
-        }
-        // succeed, retry another sched iter immediately
-        if (didPaging) {
-            continue;
+        VLOG(3) << "Scheduling all opItem in session " << item->sessHandle << ": queue size "
+                << item->bgQueue.size();
+
+        // Try schedule from this session
+        auto [count, shouldContinue] = m_scheduler->maybeScheduleFrom(item);
+        item->lastScheduled = count;
+
+        remainingCount += item->bgQueue.size();
+        scheduled += item->lastScheduled;
+
+        if (!shouldContinue) {
+            break;
         }
-        */
+    }
 
-        maybeWaitForAWhile(scheduled);
+    settleActive();
+    m_lastPassScheduled = scheduled;
 
-        if (!totalRemainingCount) {
-            VLOG(2) << "TaskExecutor wait on m_note_has_work";
-            m_note_has_work.wait();
+    // Update conditions and check if we need paging
+    bool noProgress = remainingCount > 0 && scheduled == 0 && m_nNoPagingRunningTasks == 0;
+    reportNoProgress(noProgress);
+    if (!noProgress) {
+        m_oomReported = false;
+    }
+
+    // Page out other sessions' memory if every pending task is waiting for memory on the device.
+    // TODO: we currently assume we are paging GPU memory to CPU
+    for (int i = 0; i != devices::kNumScheduledGPUs; ++i) {
+        const DeviceSpec dev{DeviceType::GPU, i};
+        if (!noProgress || !m_scheduler->insufficientMemory(dev)) {
+            continue;
+        }
+        if (m_sessions.size() > 1) {
+            startPaging(dev, devices::CPU0);
+        } else if (m_sessions.size() == 1 && !m_oomReported) {
+            // dump once per episode, the state won't change until something makes progress
+            m_oomReported = true;
+            LOG(ERROR) << "OOM on device " << dev
+                       << " for single session happened: " << m_sessions.front()->sessHandle;
+            {
+                auto g = sstl::with_guard(m_sessions.front()->tickets_mu);
+                auto usage = m_resMonitor.queryUsages(m_sessions.front()->tickets);
+                LOG(ERROR) << "This session usage:" << resources::DebugString(usage);
+            }
+            LOG(ERROR) << m_resMonitor.DebugString();
         }
     }
 
-    // Cleanup
-    CHECK(m_deletedSessions.empty());
-    CHECK(m_newSessions.empty());
-    CHECK(m_sessions.empty());
-    LOG(INFO) << "TaskExecutor stopped";
+    return true;
 }
 
 bool TaskExecutor::maybeWaitForAWhile(size_t scheduled)
@@ -360,20 +557,10 @@ bool TaskExecutor::maybeWaitForAWhile(size_t scheduled)
     return false;
 }
 
-POpItem TaskExecutor::runTask(POpItem &&opItem)
+ThreadPool::Closure TaskExecutor::makeRunClosure(POpItem opItem)
 {
-    auto item = opItem->sess.lock();
-    if (!item) {
-        // discard
-        return nullptr;
-    }
-
-    // NOTE: this is waited by schedule thread, so we can't afford running
-    // the operation inline. If the thread pool is full, simply consider the
-    // opItem as not scheduled.
-
     // opItem has to be captured by value, we need it in case the thread pool is full
-    auto c = m_pool.tryRun([opItem, this]() mutable {
+    return [opItem, this]() mutable {
         DCHECK(opItem);
 
         if (auto item = opItem->sess.lock()) {
@@ -381,6 +568,9 @@ POpItem TaskExecutor::runTask(POpItem &&opItem)
 
             // capture an session item untile done
             cbs.done = [item, opItem, this]() {
+                const auto &op = *opItem->op;
+                m_costModel.record(op.opType(), op.resourceContext().spec().type,
+                                   steady_clock::now() - opItem->startedAt, opItem->placement);
                 // succeed
                 taskStopped(*opItem, false);
             };
@@ -398,6 +588,8 @@ POpItem TaskExecutor::runTask(POpItem &&opItem)
                 }
 
                 taskStopped(*opItem, true);
+                // estimation was wrong, let the scheduler ask again
+                opItem->estimated = false;
                 // failed due to OOM. Push back to queue and retry later
                 VLOG(2) << "Putting back OOM failed task: " << opItem->op;
                 queueTask(std::move(opItem));
@@ -406,16 +598,80 @@ POpItem TaskExecutor::runTask(POpItem &&opItem)
 
             VLOG(2) << "Running opItem in session " << item->sessHandle << ": " << opItem->op;
             taskRunning(*opItem);
+            opItem->startedAt = steady_clock::now();
             opItem->op->run(std::move(cbs));
         }
-    });
+    };
+}
+
+void TaskExecutor::taskSubmitted(const OperationItem &opItem, SessionItem &item)
+{
+    item.stats.scheduled.fetch_add(1, std::memory_order_relaxed);
+    item.stats.queueTimeUs.record(duration_cast<microseconds>(steady_clock::now() - opItem.queuedAt).count());
+}
+
+POpItem TaskExecutor::runTask(POpItem &&opItem)
+{
+    auto item = opItem->sess.lock();
+    if (!item) {
+        // discard
+        return nullptr;
+    }
+
+    // NOTE: this is waited by schedule thread, so we can't afford running
+    // the operation inline. If the worker queue is full the task goes to the overflow
+    // queue, and only if that is full too, the opItem is considered as not scheduled.
+    auto c = m_pool.tryRun(makeRunClosure(opItem), item->opPriority, ThreadPool::OverflowPolicy::Overflow);
     if (!c) {
+        taskSubmitted(*opItem, *item);
         // successfully sent to thread pool, we can reset opItem
         opItem.reset();
     }
     return std::move(opItem);
 }
 
+void TaskExecutor::runTasks(std::vector<POpItem> &opItems)
+{
+    std::vector<ThreadPool::Closure> closures;
+    std::vector<std::pair<POpItem *, PSessionItem>> submitting;
+    closures.reserve(opItems.size());
+    submitting.reserve(opItems.size());
+
+    auto flush = [&, this](ThreadPool::Priority priority) {
+        // same as runTask, overflow rather than inline, rejected ones stay in place
+        m_pool.runBatch(closures, priority, ThreadPool::OverflowPolicy::Overflow);
+        for (size_t i = 0; i != closures.size(); ++i) {
+            if (!closures[i]) {
+                auto &[opItem, item] = submitting[i];
+                taskSubmitted(**opItem, *item);
+                opItem->reset();
+            }
+        }
+        closures.clear();
+        submitting.clear();
+    };
+
+    // One batch for each run of tasks with the same priority, which is normally all of them
+    auto priority = ThreadPool::Priority::Normal;
+    for (auto &opItem : opItems) {
+        auto item = opItem->sess.lock();
+        if (!item) {
+            // discard
+            opItem.reset();
+            continue;
+        }
+        if (!closures.empty() && item->opPriority != priority) {
+            flush(priority);
+        }
+        priority = item->opPriority;
+        closures.emplace_back(makeRunClosure(opItem));
+        submitting.emplace_back(&opItem, std::move(item));
+    }
+    if (!closures.empty()) {
+        flush(priority);
+    }
+}
+
 void TaskExecutor::taskRunning(OperationItem &opItem)
 {
     LogOpTracing() << "OpItem Event " << opItem.op << " event: running";
@@ -446,9 +702,56 @@ void TaskExecutor::taskStopped(OperationItem &opItem, bool failed)
     if (!opItem.op->isAsync()) {
         m_nNoPagingRunningTasks -= 1;
     }
+
+    // the freed staging resources and thread pool slot may unblock pending tasks
+    m_retryBlocked = true;
+    if (m_hasBlocked) {
+        m_note_has_work.notify();
+    }
+}
+
+void TaskExecutor::startPaging(const DeviceSpec &spec, const DeviceSpec &target)
+{
+    if (m_pagingInFlight.exchange(true)) {
+        return;
+    }
+    m_pagingJobs += 1;
+
+    const ResourceTag srcTag{ResourceType::MEMORY, spec};
+
+    // Step 1: select candidate sessions
+    std::vector<std::pair<size_t, PSessionItem>> candidates;
+    candidates.reserve(m_sessions.size());
+
+    // Step 1.1: count total memory usage for each session
+    for (auto &pSess : m_sessions) {
+        candidates.emplace_back(pSess->resourceUsage(srcTag), pSess);
+    }
+
+    auto c = m_pool.tryRun([this, candidates = std::move(candidates), spec, target]() mutable {
+        doPaging(std::move(candidates), spec, target);
+
+        // cleared before waking up the scheduling thread, so the retry pass can page again
+        // if the memory released is not enough
+        m_pagingInFlight = false;
+
+        // memory may be released, or sessions evicted
+        m_retryBlocked = true;
+        m_note_has_work.notify();
+
+        m_pagingFinished.notify();
+        // must be the last access to this, stopExecution may return right after
+        m_pagingJobs -= 1;
+    }, ThreadPool::Priority::High, ThreadPool::OverflowPolicy::Overflow);
+    if (c) {
+        VLOG(2) << "Thread pool full, postpone paging";
+        m_pagingJobs -= 1;
+        m_pagingInFlight = false;
+    }
 }
 
-bool TaskExecutor::doPaging(const DeviceSpec &spec, const DeviceSpec &target)
+bool TaskExecutor::doPaging(std::vector<std::pair<size_t, PSessionItem>> candidates, const DeviceSpec &spec,
+                            const DeviceSpec &target)
 {
     auto now = system_clock::now();
     size_t released = 0;
@@ -462,17 +765,8 @@ bool TaskExecutor::doPaging(const DeviceSpec &spec, const DeviceSpec &target)
             << " released: " << released << " forceevict: '" << forceEvicitedSess << "'";
     });
 
-    const ResourceTag srcTag{ResourceType::MEMORY, spec};
     const ResourceTag dstTag{ResourceType::MEMORY, target};
-
-    // Step 1: select candidate sessions
-    std::vector<std::pair<size_t, std::reference_wrapper<PSessionItem>>> candidates;
-    candidates.reserve(m_sessions.size());
-
-    // Step 1.1: count total memory usage for each session
-    for (auto &pSess : m_sessions) {
-        candidates.emplace_back(pSess->resourceUsage(srcTag), pSess);
-    }
+    VLOG(2) << "Paging from " << spec << " to " << target;
 
     // sort in decending order
     std::sort(candidates.begin(), candidates.end(),
@@ -488,13 +782,13 @@ bool TaskExecutor::doPaging(const DeviceSpec &spec, const DeviceSpec &target)
 
     if (VLOG_IS_ON(2)) {
         for (auto [usage, pSess] : candidates) {
-            VLOG(2) << "Session " << pSess.get()->sessHandle << " usage: " << usage;
+            VLOG(2) << "Session " << pSess->sessHandle << " usage: " << usage;
         }
     }
 
     // Step 2: inform owner to do paging given suggestion
     for (size_t i = 1; i != candidates.size(); ++i) {
-        auto &pSess = candidates[i].second.get();
+        auto &pSess = candidates[i].second;
         std::vector<std::pair<size_t, uint64_t>> victims;
         {
             auto g = sstl::with_guard(pSess->tickets_mu);
@@ -502,13 +796,11 @@ bool TaskExecutor::doPaging(const DeviceSpec &spec, const DeviceSpec &target)
                 // no need to go beyond
                 break;
             }
-            victims = m_resMonitor.sortVictim(pSess->tickets);
+            victims = m_resMonitor.sortVictim(pSess->tickets, spec);
         }
 
-        // we will be doing paging on this session. Lock it's input queue lock
-        // also prevents the executor from clearing the paging callbacks.
-        // This should not create deadlock as nothing could finish at this time,
-        // thus no new tasks could be submitted.
+        // we will be doing paging on this session. Holding its lock
+        // prevents the executor from clearing the paging callbacks.
         auto g = sstl::with_guard(pSess->mu);
         if (!pSess->pagingCb) {
             continue;
@@ -531,6 +823,7 @@ bool TaskExecutor::doPaging(const DeviceSpec &spec, const DeviceSpec &target)
             // request the session to do paging
             released += pSess->pagingCb.volunteer(victim, std::move(rctx));
             if (released > 0) {
+                pSess->stats.paged.fetch_add(1, std::memory_order_relaxed);
                 // someone freed some memory on GPU, we are good to go.
                 VLOG(2) << "    released " << released << " bytes via paging";
                 return true;
@@ -542,20 +835,22 @@ bool TaskExecutor::doPaging(const DeviceSpec &spec, const DeviceSpec &target)
 
     LOG(ERROR) << "All paging request failed. Dump all session usage";
     for (auto [usage, pSess] : candidates) {
-        LOG(ERROR) << "Session " << pSess.get()->sessHandle << " usage: " << usage;
+        LOG(ERROR) << "Session " << pSess->sessHandle << " usage: " << usage;
     }
     LOG(ERROR) << "Dump resource monitor status: " << m_resMonitor.DebugString();
 
     // Forcely kill one session
     for (auto [usage, pSess] : candidates) {
         // for logging
-        forceEvicitedSess = pSess.get()->sessHandle;
+        forceEvicitedSess = pSess->sessHandle;
 
         // Don't retry anymore for OOM kernels in this session
-        pSess.get()->protectOOM = false;
+        pSess->protectOOM = false;
 
-        VLOG(2) << "Force evict session: " << pSess.get()->sessHandle << " with usage " << usage;
-        pSess.get()->interrupt();
+        VLOG(2) << "Force evict session: " << pSess->sessHandle << " with usage " << usage;
+        pSess->interrupt();
+        // get its pending tasks canceled
+        markReady(pSess);
 
         return true;
     }
@@ -566,6 +861,13 @@ bool TaskExecutor::doPaging(const DeviceSpec &spec, const DeviceSpec &target)
 std::unique_ptr<ResourceContext> TaskExecutor::makeResourceContext(PSessionItem sess, uint64_t graphId,
                                                                    const DeviceSpec &spec,
                                                                    const Resources &res, Resources *missing)
+{
+    return makeResourceContext(std::move(sess), graphId, spec, DenseResources(res), missing);
+}
+
+std::unique_ptr<ResourceContext> TaskExecutor::makeResourceContext(PSessionItem sess, uint64_t graphId,
+                                                                   const DeviceSpec &spec,
+                                                                   const DenseResources &res, Resources *missing)
 {
     auto maybeTicket = m_resMonitor.preAllocate(res, missing);
     if (!maybeTicket) {
@@ -573,7 +875,13 @@ std::unique_ptr<ResourceContext> TaskExecutor::makeResourceContext(PSessionItem
         return nullptr;
     }
 
-    auto rctx = std::make_unique<ResourceContext>(m_resMonitor, graphId, spec, *maybeTicket);
+    return makeResourceContext(std::move(sess), graphId, spec, *maybeTicket);
+}
+
+std::unique_ptr<ResourceContext> TaskExecutor::makeResourceContext(PSessionItem sess, uint64_t graphId,
+                                                                   const DeviceSpec &spec, uint64_t ticket)
+{
+    auto rctx = std::make_unique<ResourceContext>(m_resMonitor, graphId, spec, ticket);
 
 #if defined(SALUS_ENABLE_STATIC_STREAM)
     rctx->sessHandle = sess->sessHandle;
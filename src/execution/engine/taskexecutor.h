@@ -20,17 +20,21 @@
 #ifndef SALUS_EXEC_TASKEXECUTOR_H
 #define SALUS_EXEC_TASKEXECUTOR_H
 
+#include "execution/scheduler/opcostmodel.h"
 #include "execution/scheduler/schedulingparam.h"
+#include "execution/threadpool/threadpool.h"
 #include "resources/resources.h"
 #include "utils/threadutils.h"
 
 #include <atomic>
+#include <chrono>
 #include <thread>
 #include <list>
 #include <memory>
+#include <vector>
 
+class BaseScheduler;
 class ResourceMonitor;
-class ThreadPool;
 struct SessionItem;
 using PSessionItem = std::shared_ptr<SessionItem>;
 struct OperationItem;
@@ -53,15 +57,39 @@ class TaskExecutor
 {
 public:
     explicit TaskExecutor(ThreadPool &pool, ResourceMonitor &resMonitor, SchedulingParam &param);
+    ~TaskExecutor();
 
     void startExecution();
     void stopExecution();
 
+    /**
+     * @brief Accept and delete sessions, and schedule queued tasks once, on the calling thread.
+     *
+     * Only for driving the executor without the scheduling thread, e.g. in the offline simulator.
+     */
+    void runSchedulingPass();
+
     const SchedulingParam &schedulingParam() const
     {
         return m_schedParam;
     }
 
+    /**
+     * @brief The pool tasks are run in, also used by schedulers to parallelize submission.
+     */
+    ThreadPool &pool()
+    {
+        return m_pool;
+    }
+
+    /**
+     * @brief The model placing ops on CPU or GPU, learned from ops run by this executor.
+     */
+    OpCostModel &costModel()
+    {
+        return m_costModel;
+    }
+
     void insertSession(PSessionItem sess);
 
     /**
@@ -75,6 +103,18 @@ public:
                                                          uint64_t graphId,
                                                          const DeviceSpec &spec,
                                                          const Resources &res, Resources *missing = nullptr);
+    std::unique_ptr<ResourceContext> makeResourceContext(PSessionItem sess,
+                                                         uint64_t graphId,
+                                                         const DeviceSpec &spec,
+                                                         const DenseResources &res, Resources *missing = nullptr);
+
+    /**
+     * @brief Make a resource context around a ticket already pre-allocated from the resource monitor
+     */
+    std::unique_ptr<ResourceContext> makeResourceContext(PSessionItem sess,
+                                                         uint64_t graphId,
+                                                         const DeviceSpec &spec,
+                                                         uint64_t ticket);
 
     // Incoming kernels
     void queueTask(POpItem &&opItem);
@@ -82,10 +122,16 @@ public:
     // actually run task
     POpItem runTask(POpItem &&opItem);
 
+    /**
+     * @brief Like runTask, but hand all tasks to the thread pool in a single batch.
+     * Tasks sent to the pool, or discarded, are reset in place. The rest are left as is.
+     */
+    void runTasks(std::vector<POpItem> &opItems);
+
     void deleteSession(PSessionItem item);
 
 private:
-    friend class BaseScheduler;
+    friend class ::BaseScheduler;
 
     ResourceMonitor &m_resMonitor;
     ThreadPool &m_pool;
@@ -98,8 +144,48 @@ private:
     sstl::notification m_note_has_work;
 
     void scheduleLoop();
+    bool schedulePass(size_t &totalRemainingCount, size_t &scheduled);
     bool maybeWaitForAWhile(size_t scheduled);
 
+    std::unique_ptr<::BaseScheduler> m_scheduler;
+    // outlives schedulers, so what's learned is kept when the scheduler changes
+    OpCostModel m_costModel;
+    bool m_interrupted = false;
+    size_t m_schedIterCount = 0;
+
+    /**
+     * @brief Aggregate session counters into the performance log, at most every kStatsReportInterval.
+     *
+     * Counters are bumped lock free on the hot path, so only this periodic report pays for formatting.
+     */
+    void maybeReportStats();
+    bool m_perfLogEnabled = false;
+    std::chrono::steady_clock::time_point m_nextStatsReport;
+    size_t m_reportedIterCount = 0;
+
+    /**
+     * @brief Sessions that got new tasks since last scheduling pass.
+     *
+     * Each session appears at most once, guarded by SessionItem::inReadySet.
+     */
+    std::vector<PSessionItem> m_readySessions GUARDED_BY(m_readyMu);
+    std::mutex m_readyMu;
+    void markReady(const PSessionItem &item);
+
+    /**
+     * @brief Sessions left with pending tasks after last pass. Only accessed by scheduling thread.
+     *
+     * They are retried only when something could have unblocked them: resources returned to
+     * the resource monitor, a task stopped, paging finished, or the last pass made progress.
+     */
+    std::vector<PSessionItem> m_blockedSessions;
+    std::atomic_bool m_hasBlocked{false};
+    std::atomic_bool m_retryBlocked{false};
+    uint64_t m_lastReleaseEpoch = 0;
+    size_t m_lastPassScheduled = 0;
+    // whether the single session OOM state has been dumped since the last pass with progress
+    bool m_oomReported = false;
+
     // Sessions
     std::list<PSessionItem> m_newSessions GUARDED_BY(m_newMu);
     std::mutex m_newMu;
@@ -116,17 +202,37 @@ private:
     // Task life cycle
     void taskStopped(OperationItem &opItem, bool failed);
     void taskRunning(OperationItem &opItem);
+    // the closure running opItem in thread pool, shared by runTask and runTasks
+    ThreadPool::Closure makeRunClosure(POpItem opItem);
+    void taskSubmitted(const OperationItem &opItem, SessionItem &item);
 
     std::atomic_int_fast64_t m_nRunningTasks{0};
     std::atomic_int_fast64_t m_nNoPagingRunningTasks{0};
 
+    /**
+     * @brief Start paging on device 'spec' in thread pool, unless one is already in progress.
+     *
+     * Only called from scheduling thread, which never waits for paging to finish. Blocked tasks
+     * are retried once it finishes.
+     *
+     * @param spec
+     * @param target page out to device 'target'
+     */
+    void startPaging(const DeviceSpec &spec, const DeviceSpec &target);
+    std::atomic_bool m_pagingInFlight{false};
+    // paging jobs still referring to this, waited by stopExecution
+    std::atomic_int m_pagingJobs{0};
+    sstl::notification m_pagingFinished;
+
     /**
      * @brief Do paging on device 'spec'
+     * @param candidates sessions and their memory usage on 'spec', snapshot taken on scheduling thread
      * @param spec
      * @param target page out to device 'target'
      * @return
      */
-    bool doPaging(const DeviceSpec &spec, const DeviceSpec &target);
+    bool doPaging(std::vector<std::pair<size_t, PSessionItem>> candidates, const DeviceSpec &spec,
+                  const DeviceSpec &target);
 };
 
 } // namespace salus
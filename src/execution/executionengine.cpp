@@ -17,13 +17,12 @@
  * limitations under the License.
  */
 
-#include "oplibraries/tensorflow/device/gpu/lane/lanemgr.h"
-
 #include "execution/executionengine.h"
 
 #include "execution/engine/iterationcontext.h"
 #include "execution/engine/resourcecontext.h"
 #include "execution/iterationtask.h"
+#include "execution/scheduler/schedclock.h"
 #include "platform/logging.h"
 #include "platform/thread_annotations.h"
 #include "utils/containerutils.h"
@@ -51,6 +50,30 @@ using namespace date;
 
 namespace salus {
 
+namespace {
+// The lane whose scavenger iterations are being canceled by current thread, while holding
+// its scavengerMu. Cancellation may finish the iteration inline on the same thread.
+thread_local const void *PreemptingLane = nullptr;
+
+/**
+ * @brief Worker placement of the op thread pool, from SALUS_POOL_AFFINITY: none, compact or scatter
+ */
+ThreadPoolOptions::Affinity poolAffinity()
+{
+    std::string_view name = sstl::fromEnvVarStr("SALUS_POOL_AFFINITY", "none");
+    if (name == "compact") {
+        return ThreadPoolOptions::Affinity::Compact;
+    }
+    if (name == "scatter") {
+        return ThreadPoolOptions::Affinity::Scatter;
+    }
+    if (name != "none") {
+        LOG(WARNING) << "Unknown SALUS_POOL_AFFINITY " << name << ", workers are not pinned";
+    }
+    return ThreadPoolOptions::Affinity::None;
+}
+} // namespace
+
 ExecutionEngine &ExecutionEngine::instance()
 {
     static ExecutionEngine eng;
@@ -58,13 +81,20 @@ ExecutionEngine &ExecutionEngine::instance()
 }
 
 ExecutionEngine::ExecutionEngine()
-    : m_taskExecutor(m_pool, m_resMonitor, m_schedParam)
+    : m_pool(ThreadPoolOptions()
+                 .setAffinity(poolAffinity())
+                 .setElastic(sstl::fromEnvVar("SALUS_POOL_MIN_THREADS", size_t{0})))
+    , m_taskExecutor(m_pool, m_resMonitor, m_schedParam)
 {
 }
 
-void ExecutionEngine::startScheduler()
+void ExecutionEngine::startScheduler(const std::vector<size_t> &gpuMemory)
 {
-    m_resMonitor.initializeLimits();
+    if (gpuMemory.empty()) {
+        m_resMonitor.initializeLimits();
+    } else {
+        m_resMonitor.initializeLimitsForGPUs(gpuMemory);
+    }
     m_taskExecutor.startExecution();
 
     m_schedThread = std::make_unique<std::thread>(std::bind(&ExecutionEngine::scheduleLoop, this));
@@ -77,7 +107,7 @@ void ExecutionEngine::stopScheduler()
     // unblock scheduling thread
     m_note_has_work.notify();
 
-    if (m_schedThread->joinable()) {
+    if (m_schedThread && m_schedThread->joinable()) {
         m_schedThread->join();
     }
 
@@ -128,77 +158,21 @@ void ExecutionEngine::scheduleLoop()
     LOG(INFO) << "ExecutionEngine scheduling thread started";
     threading::set_thread_name("ExecutionEngine");
 
-    // a map of lane id to thread local queues.
-    std::unordered_map<uint64_t, LaneQueue> queues;
-    queues.reserve(15);
+    m_lanes.reserve(15);
 
     // staging queue
     IterQueue staging;
 
     while (true) {
-        DCHECK(staging.empty());
-        // accept new iters
-        {
-            auto g = sstl::with_guard(m_mu);
-            staging.swap(m_iterQueue);
-        }
-
-        // record the timestamp
-        auto currStamp = system_clock::now();
-
-        // move things to aproriate queue
-        for (auto &iter : staging) {
-            auto ectx = iter.wectx.lock();
-            if (!ectx) {
-                continue;
-            }
-            auto &lane = queues[ectx->laneId()];
-            lane.queue.emplace_back(std::move(iter));
-            lane.lastSeen = currStamp;
-            if (lane.sessions.emplace(ectx->m_item).second) {
-                lane.id = ectx->laneId();
-                // new session to lane and remove old one
-                auto it = lane.sessions.begin();
-                auto ed = lane.sessions.end();
-                while (it != ed) {
-                    if (auto s = it->lock()) {
-                        s->numFinishedIters = 0;
-                        ++it;
-                    } else {
-                        it = lane.sessions.erase(it);
-                    }
-                }
-                // put session to the back of fifo
-                lane.fifoQueue.emplace_back(ectx->m_item);
-            }
-        }
-        staging.clear();
+        acceptIterations(staging);
 
         // break if interrupting, after accepting every thing
         if (m_interrupting) {
             break;
         }
 
-        // schedule each lane separately, release lane that is inactive for too long.
-        // it doesn't matter if later that lane has iter comes, just recreate it.
-
-        size_t scheduled = 0;
         size_t pending = 0;
-
-        constexpr const auto MaxInactiveTime = 10s;
-        for (auto it = queues.begin(); it != queues.end();) {
-            auto &lctx = it->second;
-            if (lctx.queue.empty()
-                && currStamp - lctx.lastSeen > MaxInactiveTime
-                && lctx.numExpensiveIterRunning.load(std::memory_order_acquire) == 0) {
-                it = queues.erase(it);
-            } else {
-                scheduled += scheduleOnQueue(lctx, staging);
-                staging.clear();
-                pending += lctx.queue.size();
-                ++it;
-            }
-        }
+        auto scheduled = scheduleLanes(staging, pending);
 
         maybeWaitForWork(pending, scheduled);
     }
@@ -216,6 +190,109 @@ void ExecutionEngine::scheduleLoop()
     LOG(INFO) << "ExecutionEngine stopped";
 }
 
+size_t ExecutionEngine::runSchedulingPass()
+{
+    CHECK(!m_schedThread) << "Scheduling thread is running";
+
+    // let the task executor accept and release sessions first
+    m_taskExecutor.runSchedulingPass();
+
+    IterQueue staging;
+    acceptIterations(staging);
+
+    size_t pending = 0;
+    scheduleLanes(staging, pending);
+    return pending;
+}
+
+void ExecutionEngine::acceptIterations(IterQueue &staging)
+{
+    DCHECK(staging.empty());
+    {
+        auto g = sstl::with_guard(m_mu);
+        staging.swap(m_iterQueue);
+    }
+
+    // record the timestamp
+    auto currStamp = SchedClock::now();
+
+    // move things to aproriate queue
+    for (auto &iter : staging) {
+        auto ectx = iter.wectx.lock();
+        if (!ectx) {
+            continue;
+        }
+        auto &lane = m_lanes[ectx->laneId()];
+        lane.queue.emplace_back(std::move(iter));
+        lane.lastSeen = currStamp;
+        if (lane.sessions.emplace(ectx->m_item, ectx->m_item.get()).second) {
+            lane.id = ectx->laneId();
+            // new session to lane, starting no earlier than the sessions already there,
+            // so it doesn't hold the lane until it catches up with their running time
+            auto &vtime = ectx->m_item->virtualRunningTime;
+            auto floor = static_cast<uint64_t>(lane.vtimes.minVirtualTime());
+            if (vtime.load() < floor) {
+                vtime = floor;
+            }
+            for (auto &[wsess, raw] : lane.sessions) {
+                UNUSED(raw);
+                if (auto s = wsess.lock()) {
+                    s->numFinishedIters = 0;
+                }
+            }
+            refreshLaneSessions(lane);
+            // put session to the back of fifo
+            lane.fifoQueue.emplace_back(ectx->m_item);
+        }
+    }
+    staging.clear();
+}
+
+size_t ExecutionEngine::scheduleLanes(IterQueue &staging, size_t &pending)
+{
+    auto currStamp = SchedClock::now();
+
+    // schedule each lane separately, release lane that is inactive for too long.
+    // it doesn't matter if later that lane has iter comes, just recreate it.
+    size_t scheduled = 0;
+
+    constexpr const auto MaxInactiveTime = 10s;
+    for (auto it = m_lanes.begin(); it != m_lanes.end();) {
+        auto &lctx = it->second;
+        if (lctx.queue.empty()
+            && currStamp - lctx.lastSeen > MaxInactiveTime
+            && lctx.numExpensiveIterRunning.load(std::memory_order_acquire) == 0) {
+            it = m_lanes.erase(it);
+        } else {
+            // sessions that left no longer dilute their tenant's share
+            auto expired = std::any_of(lctx.sessions.begin(), lctx.sessions.end(),
+                                       [](const auto &p) { return p.first.expired(); });
+            if (expired) {
+                refreshLaneSessions(lctx);
+            }
+            scheduled += scheduleOnQueue(lctx, staging);
+            staging.clear();
+            pending += lctx.queue.size();
+            ++it;
+        }
+    }
+    return scheduled;
+}
+
+void ExecutionEngine::refreshLaneSessions(LaneQueue &lctx)
+{
+    lctx.shares.clear();
+    for (auto it = lctx.sessions.begin(); it != lctx.sessions.end();) {
+        if (auto s = it->first.lock()) {
+            lctx.shares.add(s->tenant, s->weight);
+            ++it;
+        } else {
+            lctx.vtimes.erase(it->second);
+            it = lctx.sessions.erase(it);
+        }
+    }
+}
+
 int ExecutionEngine::scheduleOnQueue(LaneQueue &lctx, IterQueue &staging)
 {
     lctx.queue.swap(staging);
@@ -223,6 +300,20 @@ int ExecutionEngine::scheduleOnQueue(LaneQueue &lctx, IterQueue &staging)
 
     int scheduled = 0;
 
+    // Scavenger iterations are only admitted when there is no normal work pending,
+    // and running ones are asked to give up the lane if there is. Only expensive
+    // iterations compete for the lane, cheap ones are always admitted in checkIter.
+    lctx.normalPending = std::any_of(staging.begin(), staging.end(), [](const auto &iterItem) {
+        if (iterItem.iter->isCanceled() || !iterItem.iter->isExpensive()) {
+            return false;
+        }
+        auto ectx = iterItem.wectx.lock();
+        return ectx && !ectx->m_item->scavenger;
+    });
+    if (lctx.normalPending) {
+        preemptScavengers(lctx);
+    }
+
     // First let go every mainIter=false
     for (auto &iterItem : staging) {
         if (iterItem.iter->isCanceled()) {
@@ -260,24 +351,8 @@ int ExecutionEngine::scheduleOnQueue(LaneQueue &lctx, IterQueue &staging)
         return ectxA->m_item->numFinishedIters < ectxB->m_item->numFinishedIters;
     };
 
-    auto fairSorter = [](const auto &iterItemA, const auto &iterItemB) {
-        std::shared_ptr<ExecutionContext> ectxA = iterItemA.wectx.lock();
-        std::shared_ptr<ExecutionContext> ectxB = iterItemB.wectx.lock();
-        if (!ectxB) {
-            return true; // A goes first
-        }
-        if (!ectxA) {
-            return false; // B goes first
-        }
-
-        // fairness (equalize time)
-        auto reA = ectxA->m_item->usedRunningTime.load();
-        auto reB = ectxB->m_item->usedRunningTime.load();
-        return reA < reB;
-    };
-
     if (m_schedParam.scheduler == "fair") {
-        staging.sort(fairSorter);
+        sortByVirtualTime(lctx, staging);
     } else if (m_schedParam.scheduler == "rr") {
         staging.sort(rrSorter);
     } else if (m_schedParam.scheduler == "pack") {
@@ -286,8 +361,18 @@ int ExecutionEngine::scheduleOnQueue(LaneQueue &lctx, IterQueue &staging)
         PSessionItem sessItem = nullptr;
         auto it = lctx.fifoQueue.begin();
         auto ed = lctx.fifoQueue.end();
-        while (it != ed && !(sessItem = it->lock())) {
-            it = lctx.fifoQueue.erase(it);
+        while (it != ed) {
+            sessItem = it->lock();
+            if (!sessItem) {
+                it = lctx.fifoQueue.erase(it);
+                continue;
+            }
+            if (!sessItem->scavenger || !lctx.normalPending) {
+                break;
+            }
+            // would not be admitted anyway, don't let it block the lane
+            sessItem = nullptr;
+            ++it;
         }
         if (sessItem) {
             if (lctx.lastSessionItem != sessItem.get()) {
@@ -324,8 +409,13 @@ int ExecutionEngine::scheduleOnQueue(LaneQueue &lctx, IterQueue &staging)
         // find the sessItem with least remaining time
         int64_t minRemainingTime = std::numeric_limits<int64_t>::max();
         PSessionItem sessItem = nullptr;
-        for (auto &ws : lctx.sessions) {
+        for (auto &[ws, raw] : lctx.sessions) {
+            UNUSED(raw);
             if (auto s = ws.lock()) {
+                if (s->scavenger && lctx.normalPending) {
+                    // would not be admitted anyway, don't let it block the lane
+                    continue;
+                }
                 auto remain = static_cast<int64_t>(s->totalRunningTime) - static_cast<int64_t>(s->usedRunningTime);
                 if (remain <= minRemainingTime) {
                     minRemainingTime = remain;
@@ -398,8 +488,78 @@ int ExecutionEngine::scheduleOnQueue(LaneQueue &lctx, IterQueue &staging)
     return scheduled;
 }
 
-bool ExecutionEngine::checkIter(IterationItem &iterItem, ExecutionContext &, LaneQueue &lctx)
+void ExecutionEngine::sortByVirtualTime(LaneQueue &lctx, IterQueue &staging)
+{
+    // Group iterations by session, keeping the order within a session
+    std::unordered_map<SessionItem *, IterQueue> bySession;
+    bySession.reserve(lctx.sessions.size());
+    while (!staging.empty()) {
+        auto ectx = staging.front().wectx.lock();
+        if (!ectx) {
+            // nothing can be done for this iteration
+            staging.pop_front();
+            continue;
+        }
+        auto sess = ectx->m_item.get();
+        auto [it, inserted] = bySession.try_emplace(sess);
+        if (inserted) {
+            // fairness (equalize weighted time), account for the predicted length of the iteration
+            // so that a session with long iterations doesn't get ahead after being scheduled
+            auto weight = lctx.shares.effectiveWeight(sess->tenant, sess->weight);
+            auto predicted = sess->predictIterationDuration(staging.front().iter->graphId());
+            auto vtime = sess->virtualRunningTime.load()
+                         + duration_cast<microseconds>(predicted).count() / weight;
+            lctx.vtimes.update(sess, vtime);
+        }
+        it->second.splice(it->second.end(), staging, staging.begin());
+    }
+
+    // Then put them back in the order of virtual time
+    for (auto &[vtime, sess] : lctx.vtimes) {
+        UNUSED(vtime);
+        auto it = bySession.find(sess);
+        if (it != bySession.end()) {
+            staging.splice(staging.end(), it->second);
+        }
+    }
+}
+
+void ExecutionEngine::preemptScavengers(LaneQueue &lctx)
+{
+    auto g = sstl::with_guard(lctx.scavengerMu);
+    // Cancel while holding the lock, so the iteration can't finish and have its owner
+    // gone in the middle.
+    PreemptingLane = &lctx;
+    for (auto &[raw, sc] : lctx.runningScavengers) {
+        UNUSED(raw);
+        if (sc.finished || sc.iter->isCanceled()) {
+            continue;
+        }
+        LOG(INFO) << "event: cancel_scavenger_iter "
+                  << nlohmann::json({
+                                        {"graphId", sc.iter->graphId()},
+                                        {"laneId", lctx.id},
+                                    });
+        sc.iter->cancel();
+    }
+    PreemptingLane = nullptr;
+
+    // Remove any that finished inline during cancellation
+    for (auto it = lctx.runningScavengers.begin(); it != lctx.runningScavengers.end();) {
+        if (it->second.finished) {
+            it = lctx.runningScavengers.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
+
+bool ExecutionEngine::checkIter(IterationItem &iterItem, ExecutionContext &ectx, LaneQueue &lctx)
 {
+    if (ectx.m_item->scavenger && lctx.normalPending) {
+        return false;
+    }
+
     if (!iterItem.iter->isExpensive()) {
         return true;
     }
@@ -418,6 +578,8 @@ bool ExecutionEngine::runIter(IterationItem &iterItem, ExecutionContext &ectx, L
         VLOG(2) << "event: skip_iter "
                 << nlohmann::json({{"sess", ectx.m_item->sessHandle},
                                    {"graphId", iterItem.iter->graphId()},
+                                   {"predicted", ectx.predictedIterationTime(iterItem.iter->graphId()).count()},
+                                   {"scavenger", ectx.m_item->scavenger},
                                    {"reason", "unavailable resources"}});
         return false;
     }
@@ -432,13 +594,34 @@ bool ExecutionEngine::runIter(IterationItem &iterItem, ExecutionContext &ectx, L
     }
 
     bool expensive = iterItem.iter->isExpensive();
+    auto weight = lctx.shares.effectiveWeight(ectx.m_item->tenant, ectx.m_item->weight);
+
+    // Keep expensive scavenger iterations around until they finish, so they can be canceled.
+    // Only expensive iterations call back on finish.
+    auto iter = iterItem.iter.get();
+    bool preemptible = expensive && ectx.m_item->scavenger;
+    if (preemptible) {
+        auto g = sstl::with_guard(lctx.scavengerMu);
+        lctx.runningScavengers.try_emplace(iter, LaneQueue::ScavengerIter{std::move(iterItem.iter)});
+    }
 
     auto iCtx = std::make_shared<IterationContext>(m_taskExecutor, ectx.m_item,
-                                                   [&lctx, expensive, start = system_clock::now()](auto &sessItem) {
+                                                   [&lctx, expensive, weight, preemptible, iter,
+                                                    start = SchedClock::now()](auto &sessItem) {
+                                                       if (preemptible && PreemptingLane == &lctx) {
+                                                           // finished inline in preemptScavengers, which
+                                                           // already holds the lock and cleans up later
+                                                           lctx.runningScavengers.at(iter).finished = true;
+                                                       } else if (preemptible) {
+                                                           auto g = sstl::with_guard(lctx.scavengerMu);
+                                                           lctx.runningScavengers.erase(iter);
+                                                       }
                                                        if (expensive) {
-                                                           auto usedTime =
-                                                               duration_cast<milliseconds>(system_clock::now() - start).count();
+                                                           auto dur = SchedClock::now() - start;
+                                                           auto usedTime = duration_cast<milliseconds>(dur).count();
                                                            sessItem.usedRunningTime += usedTime;
+                                                           sessItem.virtualRunningTime += static_cast<uint64_t>(
+                                                               duration_cast<microseconds>(dur).count() / weight);
                                                            ++sessItem.numFinishedIters;
                                                            if (VLOG_IS_ON(1)) {
                                                                LogOpTracing() << "event: sess_add_time " << nlohmann::json({
@@ -451,7 +634,8 @@ bool ExecutionEngine::runIter(IterationItem &iterItem, ExecutionContext &ectx, L
                                                            lctx.numExpensiveIterRunning--;
                                                        }
                                                    });
-    iterItem.iter->runAsync(std::move(iCtx));
+    iCtx->setGraphId(iter->graphId());
+    iter->runAsync(std::move(iCtx));
     return true;
 }
 
@@ -555,9 +739,55 @@ void ExecutionContext::dropExlusiveMode()
     m_engine.m_note_has_work.notify();
 }
 
+IterDurationModel::Duration ExecutionContext::predictedIterationTime(uint64_t graphId, double k) const
+{
+    DCHECK(m_item);
+    return m_item->predictIterationDuration(graphId, k);
+}
+
 void ExecutionContext::setExpectedRunningTime(uint64_t time)
 {
     DCHECK(m_item);
     m_item->totalRunningTime = time;
 }
+
+void ExecutionContext::setGPUs(std::vector<DeviceSpec> gpus)
+{
+    DCHECK(m_item);
+    auto end = std::remove_if(gpus.begin(), gpus.end(), [](const auto &gpu) {
+        if (gpu.type != DeviceType::GPU || gpu.id < 0 || gpu.id >= devices::kMaxGPUs) {
+            LOG(WARNING) << "Ignoring unsupported device " << gpu << " for session scheduling";
+            return true;
+        }
+        return false;
+    });
+    gpus.erase(end, gpus.end());
+    if (gpus.empty()) {
+        gpus.emplace_back(devices::GPU0);
+    }
+    m_item->gpus = std::move(gpus);
+}
+
+void ExecutionContext::setScavenger(bool scavenger)
+{
+    DCHECK(m_item);
+    m_item->scavenger = scavenger;
+}
+
+void ExecutionContext::setOpPriority(ThreadPool::Priority priority)
+{
+    DCHECK(m_item);
+    m_item->opPriority = priority;
+}
+
+void ExecutionContext::setSchedulingWeight(double weight, uint64_t tenant)
+{
+    DCHECK(m_item);
+    if (weight <= 0) {
+        LOG(WARNING) << "Ignoring non-positive scheduling weight " << weight << ", using 1 instead";
+        weight = 1.0;
+    }
+    m_item->weight = weight;
+    m_item->tenant = tenant;
+}
 } // namespace salus
@@ -22,6 +22,8 @@
 
 #include "execution/devices.h"
 #include "execution/engine/taskexecutor.h"
+#include "execution/scheduler/iterdurationmodel.h"
+#include "execution/scheduler/virtualtimequeue.h"
 #include "execution/scheduler/schedulingparam.h"
 #include "execution/threadpool/threadpool.h"
 #include "platform/logging.h"
@@ -39,9 +41,11 @@
 #include <chrono>
 #include <future>
 #include <list>
+#include <map>
 #include <memory>
 #include <unordered_map>
 #include <set>
+#include <vector>
 
 namespace salus {
 class IterationTask;
@@ -55,7 +59,11 @@ public:
 
     ~ExecutionEngine();
 
-    void startScheduler();
+    /**
+     * @brief Start scheduling with limits for the discovered GPUs
+     * @param gpuMemory usable memory of each GPU. If empty, a single GPU is assumed
+     */
+    void startScheduler(const std::vector<size_t> &gpuMemory = {});
     void stopScheduler();
 
     ThreadPool &pool()
@@ -75,6 +83,14 @@ public:
 
     std::shared_ptr<ExecutionContext> makeContext();
 
+    /**
+     * @brief Accept new iterations and run one scheduling pass on every lane, on the calling thread.
+     *
+     * Only for driving the engine without the scheduling thread, e.g. in the offline simulator.
+     * @return number of iterations still pending after the pass
+     */
+    size_t runSchedulingPass();
+
 private:
     friend class ExecutionContext;
 
@@ -111,7 +127,22 @@ private:
         IterQueue queue;
         std::chrono::system_clock::time_point lastSeen;
         std::atomic_int_fast64_t numExpensiveIterRunning {0};
-        std::set<std::weak_ptr<SessionItem>, std::owner_less<std::weak_ptr<SessionItem>>> sessions;
+        // raw pointers are only used as keys into vtimes, never dereferenced
+        std::map<std::weak_ptr<SessionItem>, SessionItem *, std::owner_less<std::weak_ptr<SessionItem>>> sessions;
+        VirtualTimeQueue<SessionItem *> vtimes;
+        TenantShares shares;
+
+        // Whether any expensive normal class iteration is waiting in this pass
+        bool normalPending = false;
+        // Expensive scavenger iterations currently running, kept alive so they can be canceled.
+        // Removed in the iteration's finish callback, before the iteration's owner is notified.
+        struct ScavengerIter
+        {
+            std::unique_ptr<IterationTask> iter;
+            bool finished = false;
+        };
+        std::mutex scavengerMu;
+        std::unordered_map<IterationTask *, ScavengerIter> runningScavengers GUARDED_BY(scavengerMu);
         SessionItem *lastSessionItem = nullptr;
         std::list<std::weak_ptr<SessionItem>> fifoQueue;
     };
@@ -119,13 +150,22 @@ private:
     IterQueue m_iterQueue GUARDED_BY(m_mu);
     void scheduleIteration(IterationItem &&item);
 
+    // a map of lane id to lane queues, only accessed by the scheduling thread.
+    std::unordered_map<uint64_t, LaneQueue> m_lanes;
+
     std::unique_ptr<std::thread> m_schedThread;
     std::atomic<bool> m_interrupting{false};
     sstl::notification m_note_has_work;
 
     void scheduleLoop();
+    void acceptIterations(IterQueue &staging);
+    size_t scheduleLanes(IterQueue &staging, size_t &pending);
+    // Drop sessions that are gone from the lane, and recompute tenant shares of the rest
+    static void refreshLaneSessions(LaneQueue &lctx);
     int scheduleOnQueue(LaneQueue &lctx, IterQueue &staging);
+    void sortByVirtualTime(LaneQueue &lctx, IterQueue &staging);
     bool checkIter(IterationItem &iterItem, ExecutionContext &ectx, LaneQueue &lctx);
+    void preemptScavengers(LaneQueue &lctx);
     bool runIter(IterationItem &iterItem, ExecutionContext &ectx, LaneQueue &lctx);
     bool maybeWaitForAWhile(size_t scheduled);
     void maybeWaitForWork(size_t pending, size_t scheduled);
@@ -188,6 +228,41 @@ public:
 
     void setExpectedRunningTime(uint64_t time);
 
+    /**
+     * @brief Set the GPUs the session has lanes on, the first one being the primary.
+     * Ops of the session are only pre-allocated on these GPUs. Must be called before the
+     * session is inserted into the engine.
+     */
+    void setGPUs(std::vector<DeviceSpec> gpus);
+
+    /**
+     * @brief Mark the session as scavenger class. Scavenger sessions only run when no
+     * normal class work is pending on the same lane, and get canceled when normal work arrives.
+     */
+    void setScavenger(bool scavenger);
+
+    /**
+     * @brief Set the thread pool priority the session's ops run at. Ops of latency sensitive
+     * sessions should not wait behind bulk work on the same workers.
+     */
+    void setOpPriority(ThreadPool::Priority priority);
+
+    /**
+     * @brief Set the weight used in weighted fair sharing.
+     * @param weight relative share, must be positive
+     * @param tenant sessions of the same non-zero tenant split the weight among them
+     */
+    void setSchedulingWeight(double weight, uint64_t tenant);
+
+    /**
+     * @brief Predicted duration of the next iteration of graph `graphId`, learned from
+     * previously finished iterations. Can be used for admission decisions.
+     * @param graphId
+     * @param k number of standard deviations added to the mean, for a conservative estimation
+     * @return predicted duration, or 0 if nothing is known about the graph yet
+     */
+    IterDurationModel::Duration predictedIterationTime(uint64_t graphId, double k = 0.0) const;
+
     /**
      * @brief Make a resource context that first allocate from session's resources
      * @param spec
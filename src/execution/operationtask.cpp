@@ -23,4 +23,9 @@ namespace salus {
 
 OperationTask::~OperationTask() = default;
 
+std::string OperationTask::opType() const
+{
+    return {};
+}
+
 } // namespace salus
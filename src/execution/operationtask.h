@@ -48,6 +48,10 @@ public:
 
     virtual uint64_t graphId() const = 0;
 
+    // Type of the operation, tasks of the same type share a cost model. Empty if unknown,
+    // which is the default and keeps the task out of cost based placement.
+    virtual std::string opType() const;
+
     // Estimate usage and cache the result
     virtual Resources estimatedUsage(const DeviceSpec &dev) = 0;
     virtual bool hasExactEstimation(const DeviceSpec &dev) = 0;
@@ -24,11 +24,17 @@
 #include "execution/engine/resourcecontext.h"
 #include "execution/operationtask.h"
 #include "execution/scheduler/operationitem.h"
+#include "execution/threadpool/threadpool.h"
 #include "platform/logging.h"
 #include "utils/debugging.h"
 #include "utils/envutils.h"
 #include "utils/macros.h"
 #include "utils/threadutils.h"
+#include "config.h"
+
+#include <algorithm>
+#include <atomic>
+#include <vector>
 
 using std::chrono::duration_cast;
 using FpMS = std::chrono::duration<double, std::chrono::milliseconds::period>;
@@ -43,6 +49,13 @@ bool useGPU()
     VLOG(2) << "Scheduling using: " << (use ? "GPU,CPU" : "CPU");
     return use;
 }
+
+#if defined(SALUS_ENABLE_PARALLEL_SCHED)
+// Below this many tasks, estimating on the scheduling thread alone is cheaper than waking up helpers
+constexpr size_t kMinParallelEstimate = 32;
+// Smallest number of consecutive tasks a thread estimates at a time
+constexpr size_t kEstimateChunk = 8;
+#endif
 } // namespace
 
 SchedulerRegistary &SchedulerRegistary::instance()
@@ -97,15 +110,13 @@ void BaseScheduler::notifyPreSchedulingIteration(const SessionList &sessions,
     m_missingRes.clear();
 }
 
-bool BaseScheduler::maybePreAllocateFor(OperationItem &opItem, const DeviceSpec &spec)
+bool BaseScheduler::maybePreAllocateFor(OperationItem &opItem, const DeviceSpec &spec, const DenseResources &usage)
 {
     auto item = opItem.sess.lock();
     if (!item) {
         return false;
     }
 
-    auto usage = opItem.op->estimatedUsage(spec);
-
     Resources missing;
     auto rctx = m_taskExec.makeResourceContext(item, opItem.op->graphId(), spec, usage, &missing);
     if (!rctx) {
@@ -115,13 +126,23 @@ bool BaseScheduler::maybePreAllocateFor(OperationItem &opItem, const DeviceSpec
         return false;
     }
 
+    return prepareTask(opItem, *item, std::move(rctx));
+}
+
+bool BaseScheduler::prepareTask(OperationItem &opItem, SessionItem &item, std::unique_ptr<ResourceContext> &&rctx)
+{
     auto ticket = rctx->ticket();
     if (!opItem.op->prepare(std::move(rctx))) {
         return false;
     }
 
-    auto g = sstl::with_guard(item->tickets_mu);
-    item->tickets.insert(ticket);
+    auto g = sstl::with_guard(item.tickets_mu);
+    item.tickets.insert(ticket);
+    return true;
+}
+
+bool BaseScheduler::continueAfterIdle() const
+{
     return true;
 }
 
@@ -171,14 +192,8 @@ POpItem BaseScheduler::submitTask(POpItem &&opItem)
 
     LogOpTracing() << "OpItem Event " << opItem->op << " event: inspected";
     bool scheduled = false;
-    DeviceSpec spec{};
-    for (auto dt : opItem->op->supportedDeviceTypes()) {
-        if (dt == DeviceType::GPU && !useGPU()) {
-            continue;
-        }
-        spec.type = dt;
-        spec.id = 0;
-        if (maybePreAllocateFor(*opItem, spec)) {
+    for (const auto &[spec, usage] : estimatesFor(*opItem, *item)) {
+        if (maybePreAllocateFor(*opItem, spec, usage)) {
             VLOG(3) << "Task scheduled on " << spec;
             scheduled = true;
             break;
@@ -197,6 +212,204 @@ POpItem BaseScheduler::submitTask(POpItem &&opItem)
     return opItem;
 }
 
+BaseScheduler::Devices BaseScheduler::candidateDevices(OperationItem &opItem, const SessionItem &item) const
+{
+    Devices devs;
+    for (auto dt : opItem.op->supportedDeviceTypes()) {
+        if (dt != DeviceType::GPU) {
+            devs.emplace_back(dt, 0);
+            continue;
+        }
+        if (!useGPU()) {
+            continue;
+        }
+#if defined(SALUS_ENABLE_MULTI_DEVICE)
+        devs.insert(devs.end(), item.gpus.begin(), item.gpus.end());
+#else
+        UNUSED(item);
+        devs.emplace_back(dt, 0);
+#endif
+    }
+
+    struct DisableCostPlacementTag
+    {
+    };
+    if (devs.size() > 1 && !sstl::fromEnvVarCached<DisableCostPlacementTag>("SALUS_DISABLE_COST_PLACEMENT", false)) {
+        // inputs are expected on the default choice, which is what moving elsewhere has to copy
+        auto usage = opItem.op->estimatedUsage(devs.front());
+        auto bytes = sstl::getOrDefault(usage, {ResourceType::MEMORY, devs.front()}, 0);
+        opItem.placement = m_taskExec.m_costModel.place(opItem.op->opType(), devs, bytes);
+    }
+    return devs;
+}
+
+const OperationItem::Estimates &BaseScheduler::estimatesFor(OperationItem &opItem, const SessionItem &item)
+{
+    if (opItem.estimated) {
+        return opItem.estimates;
+    }
+
+    opItem.estimates.clear();
+    for (const auto &spec : candidateDevices(opItem, item)) {
+        opItem.estimates.emplace_back(spec, DenseResources(opItem.op->estimatedUsage(spec)));
+    }
+    opItem.estimated = true;
+    return opItem.estimates;
+}
+
+void BaseScheduler::submitTaskBatch(SessionItem::UnsafeQueue &tasks, SessionItem::UnsafeQueue &leftover,
+                                    bool reserveHead)
+{
+    if (tasks.empty()) {
+        return;
+    }
+
+    struct Request
+    {
+        POpItem opItem;
+        PSessionItem item;
+        const OperationItem::Estimates *choices = nullptr;
+        // memory needed on the preferred device, the lookahead key
+        size_t need = 0;
+        DeviceSpec spec{};
+        std::optional<uint64_t> ticket;
+        Resources missing;
+        // index in the batch sent to thread pool
+        std::optional<size_t> run;
+    };
+    std::vector<Request> requests(tasks.size());
+    std::transform(tasks.begin(), tasks.end(), requests.begin(), [](auto &opItem) {
+        Request req;
+        req.opItem = std::move(opItem);
+        return req;
+    });
+    tasks.clear();
+
+    // Estimate usages outside of the lock. Placing ops on devices is the expensive part of a pass,
+    // and each task only touches its own request.
+    auto estimate = [this, &requests](size_t first, size_t last) {
+        for (auto i = first; i != last; ++i) {
+            auto &req = requests[i];
+            req.item = req.opItem->sess.lock();
+            if (!req.item) {
+                continue;
+            }
+
+            VLOG(3) << "Scheduling opItem in session " << req.item->sessHandle << ": " << req.opItem->op;
+            LogOpTracing() << "OpItem Event " << req.opItem->op << " event: inspected";
+
+            req.choices = &estimatesFor(*req.opItem, *req.item);
+            if (!req.choices->empty()) {
+                const auto &[spec, usage] = req.choices->front();
+                req.need = usage.get({ResourceType::MEMORY, spec});
+            }
+        }
+    };
+#if defined(SALUS_ENABLE_PARALLEL_SCHED)
+    if (requests.size() >= kMinParallelEstimate) {
+        // The scheduling thread takes part too, so a busy pool only means less help
+        m_taskExec.pool().parallelFor(0, requests.size(), kEstimateChunk, estimate);
+    } else {
+        estimate(0, requests.size());
+    }
+#else
+    estimate(0, requests.size());
+#endif
+    // session already deleted, discard its tasks sliently
+    requests.erase(std::remove_if(requests.begin(), requests.end(), [](const auto &req) { return !req.item; }),
+                   requests.end());
+    reserveHead = reserveHead && !requests.empty();
+
+    // Index by estimated need, smaller first. The head keeps its place if it's due.
+    std::vector<Request *> order;
+    order.reserve(requests.size());
+    for (auto &req : requests) {
+        order.emplace_back(&req);
+    }
+    std::stable_sort(order.begin() + (reserveHead ? 1 : 0), order.end(),
+                     [](const auto *lhs, const auto *rhs) { return lhs->need < rhs->need; });
+
+    // Reserve for the admissible ones, all under one lock
+    {
+        auto proxy = m_taskExec.m_resMonitor.lock();
+        // headroom left to others when capacity is set aside for the head
+        std::optional<DenseResources> headroom;
+        for (auto *req : order) {
+            for (const auto &[spec, usage] : *req->choices) {
+                if (headroom && !headroom->contains(usage)) {
+                    if (req->missing.empty()) {
+                        // only what the headroom lacks
+                        auto lacking(usage);
+                        lacking.subtractBounded(*headroom);
+                        req->missing = lacking.removeInvalid().toResources();
+                    }
+                    continue;
+                }
+                Resources missing;
+                req->ticket = proxy.preAllocate(usage, &missing);
+                if (req->ticket) {
+                    req->spec = spec;
+                    if (headroom) {
+                        headroom->subtractBounded(usage);
+                    }
+                    break;
+                }
+                // only keep the first failure, as maybePreAllocateFor does
+                if (req->missing.empty()) {
+                    req->missing = std::move(missing);
+                }
+            }
+
+            if (reserveHead && req == order.front() && !req->ticket && !req->choices->empty()) {
+                VLOG(2) << "In session " << req->item->sessHandle << ": reserving capacity for HOL task "
+                        << req->opItem->op;
+                headroom = proxy.denseAvailable();
+                headroom->subtractBounded(req->choices->front().second);
+            }
+        }
+    }
+
+    // Scheduled tasks are sent to thread pool together, after all of them are prepared
+    std::vector<POpItem> toRun;
+    toRun.reserve(requests.size());
+    for (auto &req : requests) {
+        auto &opItem = req.opItem;
+        if (req.ticket) {
+            auto rctx = m_taskExec.makeResourceContext(req.item, opItem->op->graphId(), req.spec, *req.ticket);
+            if (!prepareTask(*opItem, *req.item, std::move(rctx))) {
+                // the task refused resources on that device, go through other devices one by one
+                opItem = submitTask(std::move(opItem));
+                continue;
+            }
+            VLOG(3) << "Task scheduled on " << req.spec;
+            LogOpTracing() << "OpItem Event " << opItem->op << " event: prealloced";
+            req.run = toRun.size();
+            toRun.emplace_back(std::move(opItem));
+            continue;
+        }
+
+        if (!req.missing.empty()) {
+            // ops with no device to try have nothing missing to wait for
+            auto g = sstl::with_guard(m_muRes);
+            m_missingRes.emplace(opItem.get(), std::move(req.missing));
+        }
+        LogOpTracing() << "OpItem Event " << opItem->op << " event: prealloced";
+        VLOG(2) << "Failed to schedule opItem in session " << req.item->sessHandle << ": "
+                << opItem->op->DebugString();
+    }
+
+    // Send to thread pool, with a single wakeup for all
+    m_taskExec.runTasks(toRun);
+
+    // Those not sent keep their order
+    for (auto &req : requests) {
+        auto &opItem = req.run ? toRun[*req.run] : req.opItem;
+        if (opItem) {
+            leftover.emplace_back(std::move(opItem));
+        }
+    }
+}
+
 size_t BaseScheduler::submitAllTaskFromQueue(const PSessionItem &item)
 {
     auto &queue = item->bgQueue;
@@ -207,51 +420,28 @@ size_t BaseScheduler::submitAllTaskFromQueue(const PSessionItem &item)
     }
 
     // Exam if queue front has been waiting for a long time
-    if (item->holWaiting > m_taskExec.schedulingParam().maxHolWaiting) {
+    bool reserveHead = item->holWaiting > m_taskExec.schedulingParam().maxHolWaiting;
+    if (reserveHead) {
         VLOG(2) << "In session " << item->sessHandle << ": HOL waiting exceeds maximum: " << item->holWaiting
                 << " (max=" << m_taskExec.schedulingParam().maxHolWaiting << ")";
-        // Only try to schedule head in this case
-        auto &head = queue.front();
-        head = submitTask(std::move(head));
-        if (!head) {
-            queue.pop_front();
-            scheduled += 1;
-        }
-    } else {
-        auto size = queue.size();
-        SessionItem::UnsafeQueue stage;
-        stage.swap(queue);
+    }
 
-#if defined(SALUS_ENABLE_PARALLEL_SCHED)
-        // Do all schedule in queue in parallel
-        std::vector<std::future<std::shared_ptr<OperationItem>>> futures;
-        futures.reserve(stage.size());
-        for (auto &opItem : stage) {
-            auto fu = m_taskExec.pool().post([opItem = std::move(opItem), this]() mutable {
-                DCHECK(opItem);
-                return submitTask(std::move(opItem));
-            });
-            futures.emplace_back(std::move(fu));
-        }
+    auto size = queue.size();
+    SessionItem::UnsafeQueue stage;
+    stage.swap(queue);
 
-        for (auto &fu : futures) {
-            auto poi = fu.get();
-            if (poi) {
-                queue.emplace_back(std::move(poi));
-            }
-        }
-#else
+    if (!m_taskExec.schedulingParam().batchSubmit) {
         for (auto &opItem : stage) {
-            auto poi = submitTask(std::move(opItem));
-            if (poi) {
-                queue.emplace_back(std::move(poi));
+            if (auto left = submitTask(std::move(opItem))) {
+                queue.emplace_back(std::move(left));
             }
         }
-#endif
-        VLOG(2) << "All opItem in session " << item->sessHandle << " examined";
-
-        scheduled = size - queue.size();
+        stage.clear();
     }
+    submitTaskBatch(stage, queue, reserveHead);
+    VLOG(2) << "All opItem in session " << item->sessHandle << " examined";
+
+    scheduled = size - queue.size();
 
     // update queue head waiting
     if (queue.empty()) {
@@ -21,6 +21,7 @@
 #define SALUS_EXEC_SCHED_BASESCHEDULER_H
 
 #include "sessionitem.h"
+#include "operationitem.h"
 
 #include "utils/cpp17.h"
 #include "utils/pointerutils.h"
@@ -44,6 +45,7 @@ struct SessionChangeSet
 
 namespace salus {
 class TaskExecutor;
+class ResourceContext;
 } // namespace salus
 
 /**
@@ -76,6 +78,13 @@ public:
      */
     virtual std::pair<size_t, bool> maybeScheduleFrom(PSessionItem item) = 0;
 
+    /**
+     * @brief Whether to continue to next candidate after skipping a session with nothing new to schedule.
+     *
+     * Must agree with what maybeScheduleFrom returns when it schedules nothing.
+     */
+    virtual bool continueAfterIdle() const;
+
     /**
      * @brief Whether we should do paging in this iteration.
      *
@@ -109,9 +118,16 @@ protected:
      *
      * @param opItem the task to preallocate
      * @param spec the device to preallocate on
+     * @param usage estimated usage of the task on `spec`
      * @returns Whether the pre-allocation succeeded.
      */
-    bool maybePreAllocateFor(OperationItem &opItem, const salus::DeviceSpec &spec);
+    bool maybePreAllocateFor(OperationItem &opItem, const salus::DeviceSpec &spec, const DenseResources &usage);
+
+    /**
+     * @brief Hand pre-allocated resources to the task, and remember the ticket in session
+     * @returns Whether the task accepted the resources.
+     */
+    bool prepareTask(OperationItem &opItem, SessionItem &item, std::unique_ptr<salus::ResourceContext> &&rctx);
 
     /**
      * @brief submit task for execution.
@@ -130,6 +146,38 @@ protected:
      */
     size_t submitAllTaskFromQueue(const PSessionItem &item);
 
+    /**
+     * @brief submit a batch of tasks, pre-allocating resources for all of them under a single
+     * resource monitor lock.
+     *
+     * Like submitTask, each task either gets all its estimated resources on one of its devices, or nothing.
+     * Tasks are admitted smaller first, so those fitting in the remaining headroom still go while
+     * a large one is blocked.
+     *
+     * @param tasks tasks to submit
+     * @param leftover tasks failed to submit are appended here, in their original order
+     * @param reserveHead the first task has waited too long. Try it first, and if it still doesn't fit,
+     *                    set aside its estimated usage so other tasks can't take it.
+     */
+    void submitTaskBatch(SessionItem::UnsafeQueue &tasks, SessionItem::UnsafeQueue &leftover,
+                         bool reserveHead = false);
+
+    using Devices = salus::OpCostModel::Devices;
+    /**
+     * @brief Devices the task may run on, in order of preference.
+     *
+     * GPUs are those of the session when multi-device support is enabled, otherwise only GPU 0.
+     * Device types are ordered by the cost model, and its prediction is kept in the task.
+     * Only called through estimatesFor, so an op is placed once until its estimates are invalidated.
+     */
+    Devices candidateDevices(OperationItem &opItem, const SessionItem &item) const;
+
+    /**
+     * @brief Estimated usage of the task on each device it may run on, in order of preference,
+     * cached in the task
+     */
+    const OperationItem::Estimates &estimatesFor(OperationItem &opItem, const SessionItem &item);
+
 
     /**
      * @brief Missing resources per operation in this iteration.
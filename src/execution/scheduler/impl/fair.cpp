@@ -68,41 +68,45 @@ void FairScheduler::notifyPreSchedulingIteration(const SessionList &sessions,
 
     // Remove old sessions
     for (auto &sess : changeset.deletedSessions) {
-        aggResUsages.erase(sess->sessHandle);
+        m_vtimes.erase(sess);
     }
 
-    // Sort sessions if needed. When there is addition, counters are reset thus no need to sort.
-    // Snapshot resource usage counter first, or reset them
+    // Tenant grouping only changes when sessions come and go
+    if (changeset.numAddedSessions != 0 || !changeset.deletedSessions.empty()) {
+        m_shares.clear();
+        for (auto &sess : sessions) {
+            m_shares.add(sess->tenant, sess->weight);
+        }
+    }
+
+    // Advance virtual time counters since last snapshot, or reset them when there is addition.
     if (changeset.numAddedSessions == 0) {
         auto now = system_clock::now();
         auto sSinceLastSnapshot = FpSeconds(now - lastSnapshotTime).count();
         lastSnapshotTime = now;
         for (auto &sess : sessions) {
-            candidates->emplace_back(sess);
             // calculate progress counter increase since last snapshot
-            size_t mem = sess->resourceUsage(resources::GPU0Memory);
-            aggResUsages[sess->sessHandle] += mem * sSinceLastSnapshot;
+            size_t mem = sess->gpuMemoryUsage();
+            auto weight = m_shares.effectiveWeight(sess->tenant, sess->weight);
+            m_vtimes.charge(sess, mem * sSinceLastSnapshot / weight);
         }
-
-        // We assume m_sessions.size() is always no more than a few,
-        // therefore sorting in every iteration is acceptable.
-        using std::sort;
-        sort(candidates->begin(), candidates->end(), [this](const auto &lhs, const auto &rhs) {
-            return aggResUsages.at(lhs->sessHandle) < aggResUsages.at(rhs->sessHandle);
-        });
     } else {
         for (auto it = changeset.addedSessionBegin; it != changeset.addedSessionEnd; ++it) {
             LOG(DEBUG) << "Adding session " << (*it)->sessHandle;
         }
         // clear to reset everything to zero.
-        aggResUsages.clear();
-        aggResUsages.reserve(sessions.size());
+        m_vtimes.clear();
         for (auto &sess : sessions) {
-            candidates->emplace_back(sess);
-            // touch each item once to ensure it's in the map
-            aggResUsages[sess->sessHandle] = 0;
+            // touch each item once to ensure it's in the queue
+            m_vtimes.update(sess, 0);
         }
     }
+
+    // The queue is already ordered by virtual time
+    for (auto &[vtime, sess] : m_vtimes) {
+        UNUSED(vtime);
+        candidates->emplace_back(sess);
+    }
 }
 
 std::pair<size_t, bool> FairScheduler::maybeScheduleFrom(PSessionItem item)
@@ -112,6 +116,11 @@ std::pair<size_t, bool> FairScheduler::maybeScheduleFrom(PSessionItem item)
     return reportScheduleResult(scheduled);
 }
 
+bool FairScheduler::continueAfterIdle() const
+{
+    return reportScheduleResult(0).second;
+}
+
 std::pair<size_t, bool> FairScheduler::reportScheduleResult(size_t scheduled) const
 {
     static auto workConservative = m_taskExec.schedulingParam().workConservative;
@@ -124,6 +133,7 @@ std::pair<size_t, bool> FairScheduler::reportScheduleResult(size_t scheduled) co
 std::string FairScheduler::debugString(const PSessionItem &item) const
 {
     std::ostringstream oss;
-    oss << "counter: " << aggResUsages.at(item->sessHandle);
+    oss << "counter: " << m_vtimes.virtualTime(item).value_or(0.0) << " weight: " << item->weight
+        << " tenant: " << item->tenant;
     return oss.str();
 }
@@ -21,12 +21,16 @@
 #define SALUS_EXEC_SCHED_FAIR_H
 
 #include "execution/scheduler/basescheduler.h"
+#include "execution/scheduler/virtualtimequeue.h"
 
 #include <chrono>
 #include <unordered_map>
 
 /**
- * @todo write docs
+ * @brief Weighted fair sharing of GPU memory x time.
+ *
+ * Each session's virtual time advances by its GPU memory usage times wall time,
+ * divided by its effective weight. Sessions with less virtual time go first.
  */
 class FairScheduler : public BaseScheduler
 {
@@ -40,6 +44,7 @@ public:
                                       const SessionChangeSet &changeset,
                                       sstl::not_null<CandidateList *> candidates) override;
     std::pair<size_t, bool> maybeScheduleFrom(PSessionItem item) override;
+    bool continueAfterIdle() const override;
 
     using BaseScheduler::debugString;
     std::string debugString(const PSessionItem &item) const override;
@@ -47,7 +52,8 @@ public:
 private:
     std::pair<size_t, bool> reportScheduleResult(size_t scheduled) const;
 
-    std::unordered_map<std::string, double> aggResUsages;
+    salus::VirtualTimeQueue<PSessionItem> m_vtimes;
+    salus::TenantShares m_shares;
 };
 
 #endif // SALUS_EXEC_SCHED_FAIR_H
@@ -98,6 +98,11 @@ std::pair<size_t, bool> PreemptScheduler::maybeScheduleFrom(PSessionItem item)
     return reportScheduleResult(scheduled);
 }
 
+bool PreemptScheduler::continueAfterIdle() const
+{
+    return reportScheduleResult(0).second;
+}
+
 std::pair<size_t, bool> PreemptScheduler::reportScheduleResult(size_t scheduled) const
 {
     static auto workConservative = m_taskExec.schedulingParam().workConservative;
@@ -39,6 +39,7 @@ public:
                                       const SessionChangeSet &changeset,
                                       sstl::not_null<CandidateList *> candidates) override;
     std::pair<size_t, bool> maybeScheduleFrom(PSessionItem item) override;
+    bool continueAfterIdle() const override;
 
 private:
     std::pair<size_t, bool> reportScheduleResult(size_t scheduled) const;
@@ -0,0 +1,71 @@
+/*
+ * Copyright 2019 Peifeng Yu <peifeng@umich.edu>
+ * 
+ * This file is part of Salus
+ * (see https://github.com/SymbioticLab/Salus).
+ * 
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * 
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "execution/scheduler/iterdurationmodel.h"
+
+#include <algorithm>
+#include <cmath>
+#include <sstream>
+
+namespace salus {
+
+IterDurationModel::IterDurationModel(double alpha)
+    : m_alpha(alpha)
+{
+}
+
+void IterDurationModel::update(Duration dur)
+{
+    auto x = static_cast<double>(dur.count());
+    if (m_numSamples == 0) {
+        m_mean = x;
+        m_var = 0.0;
+    } else {
+        // Incremental EWMA and EW variance, see Finch, "Incremental calculation of
+        // weighted mean and variance", 2009.
+        auto diff = x - m_mean;
+        auto incr = m_alpha * diff;
+        m_mean += incr;
+        m_var = (1 - m_alpha) * (m_var + diff * incr);
+    }
+    ++m_numSamples;
+}
+
+double IterDurationModel::stddev() const
+{
+    return std::sqrt(m_var);
+}
+
+IterDurationModel::Duration IterDurationModel::predict(double k) const
+{
+    if (!hasEstimation()) {
+        return Duration{0};
+    }
+    auto est = std::max(m_mean + k * stddev(), 0.0);
+    return Duration{static_cast<Duration::rep>(std::round(est))};
+}
+
+std::string IterDurationModel::DebugString() const
+{
+    std::ostringstream oss;
+    oss << "IterDurationModel(mean=" << m_mean << "ms, stddev=" << stddev() << "ms, samples=" << m_numSamples << ")";
+    return oss.str();
+}
+
+} // namespace salus
@@ -0,0 +1,92 @@
+/*
+ * Copyright 2019 Peifeng Yu <peifeng@umich.edu>
+ * 
+ * This file is part of Salus
+ * (see https://github.com/SymbioticLab/Salus).
+ * 
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * 
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef SALUS_EXEC_SCHED_ITERDURATIONMODEL_H
+#define SALUS_EXEC_SCHED_ITERDURATIONMODEL_H
+
+#include <chrono>
+#include <cstdint>
+#include <string>
+
+namespace salus {
+
+/**
+ * @brief Online model of iteration duration for one graph in a session.
+ *
+ * Keeps an exponentially weighted moving average of the duration together with
+ * its exponentially weighted variance, so a policy can ask for both the expected
+ * length of the next iteration and how confident the estimation is.
+ */
+class IterDurationModel
+{
+public:
+    using Duration = std::chrono::milliseconds;
+
+    explicit IterDurationModel(double alpha = 0.25);
+
+    /**
+     * @brief Feed one observed iteration duration into the model
+     */
+    void update(Duration dur);
+
+    /**
+     * @brief Whether any sample has been observed
+     */
+    bool hasEstimation() const
+    {
+        return m_numSamples > 0;
+    }
+
+    uint64_t numSamples() const
+    {
+        return m_numSamples;
+    }
+
+    /**
+     * @brief Mean of observed iteration duration in ms
+     */
+    double mean() const
+    {
+        return m_mean;
+    }
+
+    /**
+     * @brief Standard deviation of observed iteration duration in ms
+     */
+    double stddev() const;
+
+    /**
+     * @brief Predicted duration of the next iteration, i.e. mean + k * stddev.
+     * Use a positive k to get a conservative estimation.
+     * @returns 0 if there is no estimation yet.
+     */
+    Duration predict(double k = 0.0) const;
+
+    std::string DebugString() const;
+
+private:
+    double m_alpha;
+    double m_mean = 0.0;
+    double m_var = 0.0;
+    uint64_t m_numSamples = 0;
+};
+
+} // namespace salus
+
+#endif // SALUS_EXEC_SCHED_ITERDURATIONMODEL_H
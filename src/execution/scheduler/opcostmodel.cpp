@@ -0,0 +1,134 @@
+/*
+ * Copyright 2019 Peifeng Yu <peifeng@umich.edu>
+ * 
+ * This file is part of Salus
+ * (see https://github.com/SymbioticLab/Salus).
+ * 
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * 
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "execution/scheduler/opcostmodel.h"
+#include "utils/threadutils.h"
+
+#include <algorithm>
+#include <cmath>
+#include <optional>
+#include <sstream>
+
+namespace salus {
+
+namespace {
+size_t typeIndex(DeviceType dt)
+{
+    return static_cast<size_t>(dt);
+}
+} // namespace
+
+OpCostModel::OpCostModel(double alpha)
+    : m_alpha(alpha)
+{
+}
+
+OpCostModel::Prediction OpCostModel::place(const std::string &opType, Devices &devices, size_t transferBytes)
+{
+    Prediction pred;
+    if (opType.empty() || devices.empty()) {
+        return pred;
+    }
+
+    const auto home = devices.front().type;
+    const bool movable = transferBytes <= kMaxMovedBytes
+                         && std::any_of(devices.begin(), devices.end(), [home](const auto &d) { return d.type != home; });
+
+    auto g = sstl::with_guard(m_mu);
+    auto &entry = m_entries[opType];
+    ++entry.decisions;
+
+    std::array<double, kNumDeviceTypes> finishUs{};
+    std::optional<DeviceType> unknown;
+    for (const auto &dev : devices) {
+        const auto &pd = entry.devices[typeIndex(dev.type)];
+        if (pd.samples < kMinSamples) {
+            if (!unknown) {
+                unknown = dev.type;
+            }
+            continue;
+        }
+        pred.execUs[typeIndex(dev.type)] = pd.meanUs;
+        finishUs[typeIndex(dev.type)] = pd.meanUs;
+        if (dev.type != home) {
+            finishUs[typeIndex(dev.type)] += kTransferLatencyUs + transferBytes / kTransferBytesPerUs;
+        }
+    }
+
+    if (movable) {
+        if (unknown) {
+            if (*unknown != home && entry.decisions % kExploreInterval == 0) {
+                std::stable_partition(devices.begin(), devices.end(),
+                                      [&unknown](const auto &d) { return d.type == *unknown; });
+                ++entry.explored;
+            }
+        } else {
+            std::stable_sort(devices.begin(), devices.end(), [&finishUs](const auto &lhs, const auto &rhs) {
+                return finishUs[typeIndex(lhs.type)] < finishUs[typeIndex(rhs.type)];
+            });
+        }
+        if (devices.front().type != home) {
+            ++entry.moved;
+        }
+    }
+    ++entry.devices[typeIndex(devices.front().type)].chosen;
+    return pred;
+}
+
+void OpCostModel::record(const std::string &opType, DeviceType dt, Duration dur, const Prediction &pred)
+{
+    if (opType.empty()) {
+        return;
+    }
+
+    auto x = std::chrono::duration<double, std::micro>(dur).count();
+
+    auto g = sstl::with_guard(m_mu);
+    auto &pd = m_entries[opType].devices[typeIndex(dt)];
+    if (auto est = pred.execUs[typeIndex(dt)]; est >= 0) {
+        pd.absErrUs += std::abs(x - est);
+        ++pd.predicted;
+    }
+    if (pd.samples == 0) {
+        pd.meanUs = x;
+    } else {
+        pd.meanUs += m_alpha * (x - pd.meanUs);
+    }
+    ++pd.samples;
+}
+
+std::string OpCostModel::dumpCounters() const
+{
+    std::ostringstream oss;
+    auto g = sstl::with_guard(m_mu);
+    for (const auto &[opType, entry] : m_entries) {
+        oss << opType << ": decisions=" << entry.decisions << " moved=" << entry.moved
+            << " explored=" << entry.explored;
+        for (auto dt : {DeviceType::CPU, DeviceType::GPU}) {
+            const auto &pd = entry.devices[typeIndex(dt)];
+            oss << " " << enumToString(dt) << "(chosen=" << pd.chosen << " ran=" << pd.samples
+                << " mean=" << pd.meanUs << "us mae="
+                << (pd.predicted ? pd.absErrUs / pd.predicted : 0.0) << "us)";
+        }
+        oss << std::endl;
+    }
+    return oss.str();
+}
+
+} // namespace salus
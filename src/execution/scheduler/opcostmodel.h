@@ -0,0 +1,125 @@
+/*
+ * Copyright 2019 Peifeng Yu <peifeng@umich.edu>
+ * 
+ * This file is part of Salus
+ * (see https://github.com/SymbioticLab/Salus).
+ * 
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * 
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef SALUS_EXEC_SCHED_OPCOSTMODEL_H
+#define SALUS_EXEC_SCHED_OPCOSTMODEL_H
+
+#include "execution/devices.h"
+#include "platform/thread_annotations.h"
+
+#include <boost/container/small_vector.hpp>
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+namespace salus {
+
+/**
+ * @brief Online per op type model of execution time on each device type, used to place
+ * small ops where they are predicted to finish first.
+ *
+ * Execution time on a device type is an exponentially weighted moving average of measured
+ * run times. Running an op away from the device its inputs are on adds a transfer cost,
+ * which is a fixed latency plus the op's memory usage over the host-device bandwidth.
+ *
+ * Every decision and measured outcome is counted, see `dumpCounters`.
+ */
+class OpCostModel
+{
+public:
+    using Devices = boost::container::small_vector<DeviceSpec, 4>;
+    using Duration = std::chrono::nanoseconds;
+    static constexpr size_t kNumDeviceTypes = 2;
+
+    // Ops using more memory than this are never moved, the transfer would dominate anyway
+    static constexpr size_t kMaxMovedBytes = 1024 * 1024;
+    // Samples on a device type before its prediction is trusted
+    static constexpr uint64_t kMinSamples = 3;
+    // Every this many ops of a type, one goes to a device type lacking samples
+    static constexpr uint64_t kExploreInterval = 16;
+    // Host-device copy cost
+    static constexpr double kTransferLatencyUs = 10.0;
+    static constexpr double kTransferBytesPerUs = 6.0 * 1024;
+
+    /**
+     * @brief What the model predicted for a task, kept in the task until it finishes
+     */
+    struct Prediction
+    {
+        // predicted execution time in us on each device type, negative if unknown
+        std::array<double, kNumDeviceTypes> execUs{-1.0, -1.0};
+    };
+
+    explicit OpCostModel(double alpha = 0.25);
+
+    /**
+     * @brief Order `devices` by predicted finish time of an op of type `opType`.
+     *
+     * The first entry is taken as where the inputs are. Ops that are large, of unknown type,
+     * or not yet measured on every device type keep the given order, except that every few
+     * ops of a type are sent to a device type lacking samples, so the model gets to learn it.
+     *
+     * @param transferBytes bytes to move if the op runs on another device type than the first one
+     */
+    Prediction place(const std::string &opType, Devices &devices, size_t transferBytes);
+
+    /**
+     * @brief Feed the measured execution time of an op into the model
+     */
+    void record(const std::string &opType, DeviceType dt, Duration dur, const Prediction &pred);
+
+    /**
+     * @brief Placement decisions and outcomes per op type, one line each
+     */
+    std::string dumpCounters() const;
+
+private:
+    struct PerDevice
+    {
+        double meanUs = 0.0;
+        uint64_t samples = 0;
+        // times chosen as the first choice
+        uint64_t chosen = 0;
+        // sum of absolute error of predicted execution time, over runs with a prediction
+        double absErrUs = 0.0;
+        uint64_t predicted = 0;
+    };
+
+    struct Entry
+    {
+        std::array<PerDevice, kNumDeviceTypes> devices;
+        uint64_t decisions = 0;
+        // first choice differs from the given order
+        uint64_t moved = 0;
+        uint64_t explored = 0;
+    };
+
+    const double m_alpha;
+
+    mutable std::mutex m_mu;
+    std::unordered_map<std::string, Entry> m_entries GUARDED_BY(m_mu);
+};
+
+} // namespace salus
+
+#endif // SALUS_EXEC_SCHED_OPCOSTMODEL_H
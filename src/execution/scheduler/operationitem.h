@@ -20,19 +20,43 @@
 #ifndef SALUS_EXEC_OPERATIONITEM_H
 #define SALUS_EXEC_OPERATIONITEM_H
 
+#include "execution/scheduler/opcostmodel.h"
+#include "resources/resources.h"
+#include "utils/mpscqueue.h"
+
+#include <boost/container/small_vector.hpp>
+
+#include <chrono>
 #include <cstddef>
 #include <memory>
+#include <utility>
 
 namespace salus {
 class OperationTask;
 } // namespace salus
 
 struct SessionItem;
-struct OperationItem
+struct OperationItem : public sstl::MpscHook<OperationItem>
 {
     std::weak_ptr<SessionItem> sess;
     std::unique_ptr<salus::OperationTask> op;
 
+    // Estimated usage on each device the task may run on. Filled by the scheduler the first time
+    // it inspects the task, and invalidated when the task is put back after a failure. Kept dense,
+    // as that's what every admission check works on.
+    using Estimates = boost::container::small_vector<std::pair<salus::DeviceSpec, DenseResources>, 2>;
+    Estimates estimates;
+    bool estimated = false;
+
+    // What the cost model predicted when ordering the devices, to audit its accuracy
+    salus::OpCostModel::Prediction placement;
+
+    // When the task was last put in the session's queue
+    std::chrono::steady_clock::time_point queuedAt;
+
+    // When the task last started running, after all scheduling and queuing in the thread pool
+    std::chrono::steady_clock::time_point startedAt;
+
     size_t hash() const
     {
         return reinterpret_cast<size_t>(this);
@@ -0,0 +1,42 @@
+/*
+ * Copyright 2019 Peifeng Yu <peifeng@umich.edu>
+ * 
+ * This file is part of Salus
+ * (see https://github.com/SymbioticLab/Salus).
+ * 
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * 
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "execution/scheduler/schedclock.h"
+
+#include "platform/logging.h"
+
+namespace salus {
+
+void SchedClock::useVirtualTime(time_point start)
+{
+    m_virtualNow.store(start.time_since_epoch().count(), std::memory_order_release);
+    m_virtual.store(true, std::memory_order_relaxed);
+}
+
+void SchedClock::advanceTo(time_point t)
+{
+    CHECK(isVirtual()) << "Can only advance virtual time";
+
+    auto target = t.time_since_epoch().count();
+    auto curr = m_virtualNow.load(std::memory_order_relaxed);
+    CHECK_GE(target, curr) << "Virtual time can not go backwards";
+    m_virtualNow.store(target, std::memory_order_release);
+}
+
+} // namespace salus
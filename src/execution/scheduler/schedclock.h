@@ -0,0 +1,72 @@
+/*
+ * Copyright 2019 Peifeng Yu <peifeng@umich.edu>
+ * 
+ * This file is part of Salus
+ * (see https://github.com/SymbioticLab/Salus).
+ * 
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * 
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef SALUS_EXEC_SCHED_SCHEDCLOCK_H
+#define SALUS_EXEC_SCHED_SCHEDCLOCK_H
+
+#include "utils/macros.h"
+
+#include <atomic>
+#include <chrono>
+
+namespace salus {
+
+/**
+ * @brief Clock used for scheduling decisions and time accounting.
+ *
+ * Follows the system clock by default. When switched to virtual time, it only moves
+ * when explicitly advanced, which lets the offline simulator drive the real policies.
+ */
+class SchedClock
+{
+public:
+    using time_point = std::chrono::system_clock::time_point;
+    using duration = std::chrono::system_clock::duration;
+
+    static time_point now() noexcept
+    {
+        if (SALUS_PREDICT_TRUE(!m_virtual.load(std::memory_order_relaxed))) {
+            return std::chrono::system_clock::now();
+        }
+        return time_point{duration{m_virtualNow.load(std::memory_order_acquire)}};
+    }
+
+    static bool isVirtual() noexcept
+    {
+        return m_virtual.load(std::memory_order_relaxed);
+    }
+
+    /**
+     * @brief Stop following the system clock, and start virtual time at `start`
+     */
+    static void useVirtualTime(time_point start);
+
+    /**
+     * @brief Move virtual time forward to `t`. Time never goes backwards.
+     */
+    static void advanceTo(time_point t);
+
+private:
+    inline static std::atomic_bool m_virtual{false};
+    inline static std::atomic<duration::rep> m_virtualNow{0};
+};
+
+} // namespace salus
+
+#endif // SALUS_EXEC_SCHED_SCHEDCLOCK_H
@@ -35,6 +35,11 @@ struct SchedulingParam
      * Whether to be work conservative. This has no effect when using scheduler 'pack'
      */
     bool workConservative = true;
+    /**
+     * Whether a session's ready tasks are reserved for under one resource monitor lock and sent to the
+     * thread pool together. Off submits them one at a time, for comparison.
+     */
+    bool batchSubmit = true;
     /**
      * The scheduler to use
      */
@@ -19,12 +19,13 @@
 
 #include "sessionitem.h"
 
+#include "execution/scheduler/operationitem.h"
+
 using namespace salus;
 
 SessionItem::~SessionItem()
 {
     bgQueue.clear();
-    queue.clear();
 
     // output stats
     VLOG(2) << "Stats for Session " << sessHandle << ": totalExecutedOp=" << totalExecutedOp;
@@ -54,10 +55,9 @@ void SessionItem::prepareDelete(std::function<void()> cb)
 
 void SessionItem::interrupt()
 {
-    if (forceEvicted) {
+    if (forceEvicted.exchange(true)) {
         return;
     }
-    forceEvicted = true;
 
     std::function<void()> cb;
     {
@@ -67,10 +67,31 @@ void SessionItem::interrupt()
     if (cb) cb();
 }
 
+size_t SessionItem::gpuMemoryUsage()
+{
+    size_t total = 0;
+    for (const auto &gpu : gpus) {
+        total += resourceUsage({ResourceType::MEMORY, gpu});
+    }
+    return total;
+}
+
 void SessionItem::queueTask(POpItem &&opItem)
 {
-    auto g = sstl::with_guard(mu);
-    queue.emplace_back(std::move(opItem));
+    opItem->queuedAt = std::chrono::steady_clock::now();
+    stats.queued.add();
+    queue.push(std::move(opItem));
+}
+
+SessionItem::Stats::Snapshot SessionItem::Stats::snapshot() const
+{
+    Snapshot snap;
+    snap.queued = queued.load();
+    snap.scheduled = scheduled.load(std::memory_order_relaxed);
+    snap.blocked = blocked.load(std::memory_order_relaxed);
+    snap.paged = paged.load(std::memory_order_relaxed);
+    snap.queueTimeUs = queueTimeUs.snapshot();
+    return snap;
 }
 
 void SessionItem::notifyAlloc(const uint64_t graphId, uint64_t ticket, const ResourceTag &tag, size_t num)
@@ -123,3 +144,22 @@ void SessionItem::endIteration(const uint64_t graphId)
     auto g = sstl::with_guard(mu);
     allocTrackers.at(graphId).endIter();
 }
+
+void SessionItem::recordIterationDuration(const uint64_t graphId, salus::IterDurationModel::Duration dur)
+{
+    auto g = sstl::with_guard(durations_mu);
+    auto &model = durationModels[graphId];
+    model.update(dur);
+    VLOG(2) << "SessionItem::recordIterationDuration graphid=" << graphId << ", sess=" << sessHandle
+            << ", dur=" << dur.count() << "ms, " << model.DebugString();
+}
+
+salus::IterDurationModel::Duration SessionItem::predictIterationDuration(const uint64_t graphId, double k) const
+{
+    auto g = sstl::with_guard(durations_mu);
+    auto it = durationModels.find(graphId);
+    if (it == durationModels.end()) {
+        return salus::IterDurationModel::Duration{0};
+    }
+    return it->second.predict(k);
+}
@@ -24,9 +24,14 @@
 #include "resources/resources.h"
 #include "resources/iteralloctracker.h"
 #include "execution/devices.h"
+#include "execution/scheduler/iterdurationmodel.h"
+#include "execution/threadpool/threadpool.h"
 #include "execution/engine/taskexecutor.h"
 #include "execution/engine/allocationlistener.h"
 #include "platform/thread_annotations.h"
+#include "utils/mpscqueue.h"
+#include "utils/objectpool.h"
+#include "utils/statsutils.h"
 
 #include <list>
 #include <string>
@@ -37,6 +42,7 @@
 #include <memory>
 #include <any>
 #include <utility>
+#include <vector>
 
 struct OperationItem;
 using POpItem = std::shared_ptr<OperationItem>;
@@ -49,7 +55,7 @@ class ExecutionEngine;
  */
 struct SessionItem : public salus::AllocationListener
 {
-    using KernelQueue = std::list<POpItem>;
+    using KernelQueue = sstl::MpscQueue<OperationItem>;
     using UnsafeQueue = std::list<POpItem>;
 private:
     // protected by mu (may be accessed both in schedule thread and close session thread)
@@ -59,7 +65,8 @@ private:
     // called if the execution engine requires to interrupt the session
     std::function<void()> interruptCb GUARDED_BY(mu);
 
-    KernelQueue queue GUARDED_BY(mu);
+    // pushed by executor threads, drained by main scheduling thread
+    KernelQueue queue;
     // total number of executed op in this session
     uint64_t totalExecutedOp = 0 GUARDED_BY(mu);
 
@@ -73,12 +80,22 @@ private:
 
     size_t lastScheduled = 0;
 
+    // Set while the session sits in TaskExecutor's ready set, so it's queued there at most once
+    std::atomic_bool inReadySet{false};
+    // Only accessed by main scheduling thread
+    bool accepted = false;
+    bool activeInPass = false;
+
     uint64_t holWaiting = 0;
     size_t queueHeadHash = 0;
 
     std::unordered_set<uint64_t> tickets;
     std::mutex tickets_mu;
 
+    // iteration duration model per graph, updated when an iteration finishes
+    std::unordered_map<uint64_t, salus::IterDurationModel> durationModels GUARDED_BY(durations_mu);
+    mutable std::mutex durations_mu;
+
     // Accessed by multiple scheduling thread
     std::atomic_bool protectOOM{true};
 
@@ -94,22 +111,72 @@ public:
 
     // Only accessed by main scheduling thread
     UnsafeQueue bgQueue;
-    bool forceEvicted{false};
+    // set by interrupt, which may also be called from the paging thread
+    std::atomic_bool forceEvicted{false};
 
     // target runnimg time
     uint64_t totalRunningTime {0};
     std::atomic_uint_fast64_t usedRunningTime {0};
     std::atomic_uint_fast64_t numFinishedIters {0};
 
+    // weighted fair sharing. Sessions with the same non-zero tenant share the weight.
+    double weight {1.0};
+    uint64_t tenant {0};
+    // used running time in us divided by effective weight at the time the iteration was scheduled
+    std::atomic_uint_fast64_t virtualRunningTime {0};
+
+    // best-effort session that only uses idle GPU time
+    bool scavenger {false};
+
+    // thread pool priority of the session's ops, higher for latency sensitive sessions
+    ThreadPool::Priority opPriority {ThreadPool::Priority::Normal};
+
+    // GPUs the session has lanes on, the first one is the primary.
+    // Set before the session is inserted into the engine, read only afterwards.
+    std::vector<salus::DeviceSpec> gpus {salus::devices::GPU0};
+
+    /**
+     * @brief Performance counters. Bumped without locking on the hot path, and read
+     * periodically by the stats aggregator in TaskExecutor.
+     */
+    struct Stats
+    {
+        // tasks queued, bumped by executor threads
+        sstl::StripedCounter<> queued;
+        // tasks sent to run
+        std::atomic_uint_fast64_t scheduled{0};
+        // scheduling passes that left tasks pending
+        std::atomic_uint_fast64_t blocked{0};
+        // paging requests that released memory
+        std::atomic_uint_fast64_t paged{0};
+        // time from queued to sent to run, in us
+        sstl::LogHistogram<> queueTimeUs;
+
+        struct Snapshot
+        {
+            uint64_t queued = 0;
+            uint64_t scheduled = 0;
+            uint64_t blocked = 0;
+            uint64_t paged = 0;
+            sstl::LogHistogram<>::Snapshot queueTimeUs;
+        };
+        Snapshot snapshot() const;
+    };
+    Stats stats;
+
+    // recycles the memory of OperationItems created for this session
+    const std::shared_ptr<sstl::BlockPool> opItemPool {std::make_shared<sstl::BlockPool>()};
+
     explicit SessionItem(std::string handle)
         : sessHandle(std::move(handle))
     {
         // NOTE: add other devices
-        resUsage[resources::GPU0Memory].get() = 0;
-        resUsage[resources::GPU1Memory].get() = 0;
         resUsage[resources::CPU0Memory].get() = 0;
-        resUsage[{ResourceType::GPU_STREAM, salus::devices::GPU0}].get() = 0;
-        resUsage[{ResourceType::GPU_STREAM, salus::devices::GPU1}].get() = 0;
+        for (int i = 0; i != salus::devices::kMaxGPUs; ++i) {
+            const salus::DeviceSpec gpu{salus::DeviceType::GPU, i};
+            resUsage[{ResourceType::MEMORY, gpu}].get() = 0;
+            resUsage[{ResourceType::GPU_STREAM, gpu}].get() = 0;
+        }
     }
 
     ~SessionItem() override;
@@ -119,6 +186,11 @@ public:
         return resUsage.at(tag).get();
     }
 
+    /**
+     * @brief Total memory in use on all GPUs of the session
+     */
+    size_t gpuMemoryUsage();
+
     void setPagingCallbacks(salus::PagingCallbacks pcb);
     void setInterruptCallback(std::function<void()> cb);
     void setExclusiveMode(bool mode)
@@ -132,6 +204,18 @@ public:
 
     void endIteration(uint64_t graphId);
 
+    /**
+     * @brief Record the duration of a finished iteration of graph `graphId`
+     */
+    void recordIterationDuration(uint64_t graphId, salus::IterDurationModel::Duration dur);
+
+    /**
+     * @brief Predicted duration of the next iteration of graph `graphId`.
+     * @param k number of standard deviations to add to the mean
+     * @returns 0 if no iteration of this graph has finished yet
+     */
+    salus::IterDurationModel::Duration predictIterationDuration(uint64_t graphId, double k = 0.0) const;
+
     /**
      * @brief prepare to remove session from execution engine.
      * 
@@ -155,6 +239,9 @@ private:
     using AtomicResUsages = std::unordered_map<ResourceTag, sstl::MutableAtom>;
     // must be initialized in constructor
     AtomicResUsages resUsage;
+
+    // last stats reported, only accessed by main scheduling thread
+    Stats::Snapshot reportedStats;
 };
 using PSessionItem = std::shared_ptr<SessionItem>;
 using SessionList = std::list<PSessionItem>;
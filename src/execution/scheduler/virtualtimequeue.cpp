@@ -0,0 +1,59 @@
+/*
+ * Copyright 2019 Peifeng Yu <peifeng@umich.edu>
+ * 
+ * This file is part of Salus
+ * (see https://github.com/SymbioticLab/Salus).
+ * 
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * 
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "execution/scheduler/virtualtimequeue.h"
+
+#include "platform/logging.h"
+
+#include <algorithm>
+
+namespace salus {
+
+void TenantShares::clear()
+{
+    m_tenants.clear();
+}
+
+void TenantShares::add(uint64_t tenant, double weight)
+{
+    if (tenant == NoTenant) {
+        return;
+    }
+    auto &ts = m_tenants[tenant];
+    if (ts.numSessions != 0 && ts.weight != weight) {
+        VLOG(2) << "Sessions of tenant " << tenant << " specify different weights: " << ts.weight << " vs "
+                << weight << ", using the larger one";
+    }
+    ts.weight = std::max(ts.weight, weight);
+    ts.numSessions += 1;
+}
+
+double TenantShares::effectiveWeight(uint64_t tenant, double weight) const
+{
+    if (tenant == NoTenant) {
+        return weight;
+    }
+    auto it = m_tenants.find(tenant);
+    if (it == m_tenants.end() || it->second.numSessions == 0) {
+        return weight;
+    }
+    return it->second.weight / it->second.numSessions;
+}
+
+} // namespace salus
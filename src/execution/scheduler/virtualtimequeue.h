@@ -0,0 +1,157 @@
+/*
+ * Copyright 2019 Peifeng Yu <peifeng@umich.edu>
+ * 
+ * This file is part of Salus
+ * (see https://github.com/SymbioticLab/Salus).
+ * 
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * 
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef SALUS_EXEC_SCHED_VIRTUALTIMEQUEUE_H
+#define SALUS_EXEC_SCHED_VIRTUALTIMEQUEUE_H
+
+#include <cstdint>
+#include <functional>
+#include <optional>
+#include <set>
+#include <unordered_map>
+#include <utility>
+
+namespace salus {
+
+/**
+ * @brief An ordered queue of keys by their virtual time.
+ *
+ * Updating, inserting and removing a key are all O(log n). Iterating the queue
+ * visits keys in ascending virtual time, ties broken by key.
+ */
+template<typename Key, typename Hash = std::hash<Key>>
+class VirtualTimeQueue
+{
+public:
+    using value_type = std::pair<double, Key>;
+    using const_iterator = typename std::set<value_type>::const_iterator;
+
+    /**
+     * @brief Insert key with virtual time vtime, or update existing key
+     */
+    void update(const Key &key, double vtime)
+    {
+        auto [it, inserted] = m_vtimes.try_emplace(key, vtime);
+        if (!inserted) {
+            if (it->second == vtime) {
+                return;
+            }
+            m_order.erase({it->second, key});
+            it->second = vtime;
+        }
+        m_order.emplace(vtime, key);
+    }
+
+    /**
+     * @brief Add delta to key's virtual time. Missing key starts from 0.
+     */
+    void charge(const Key &key, double delta)
+    {
+        update(key, virtualTime(key).value_or(0.0) + delta);
+    }
+
+    bool erase(const Key &key)
+    {
+        auto it = m_vtimes.find(key);
+        if (it == m_vtimes.end()) {
+            return false;
+        }
+        m_order.erase({it->second, key});
+        m_vtimes.erase(it);
+        return true;
+    }
+
+    std::optional<double> virtualTime(const Key &key) const
+    {
+        auto it = m_vtimes.find(key);
+        if (it == m_vtimes.end()) {
+            return std::nullopt;
+        }
+        return it->second;
+    }
+
+    /**
+     * @returns minimum virtual time in queue, or 0 if the queue is empty
+     */
+    double minVirtualTime() const
+    {
+        return m_order.empty() ? 0.0 : m_order.begin()->first;
+    }
+
+    void clear()
+    {
+        m_order.clear();
+        m_vtimes.clear();
+    }
+
+    bool empty() const
+    {
+        return m_order.empty();
+    }
+
+    size_t size() const
+    {
+        return m_order.size();
+    }
+
+    const_iterator begin() const
+    {
+        return m_order.begin();
+    }
+
+    const_iterator end() const
+    {
+        return m_order.end();
+    }
+
+private:
+    std::set<value_type> m_order;
+    std::unordered_map<Key, double, Hash> m_vtimes;
+};
+
+/**
+ * @brief Computes effective scheduling weight of sessions grouped by tenant.
+ *
+ * All active sessions of one tenant share the tenant's weight equally, so a
+ * tenant opening more sessions doesn't get a bigger share. Tenant 0 means the
+ * session is not grouped, and it uses its own weight as is.
+ */
+class TenantShares
+{
+public:
+    static constexpr uint64_t NoTenant = 0;
+
+    void clear();
+
+    void add(uint64_t tenant, double weight);
+
+    double effectiveWeight(uint64_t tenant, double weight) const;
+
+private:
+    struct TenantState
+    {
+        double weight = 0.0;
+        size_t numSessions = 0;
+    };
+    std::unordered_map<uint64_t, TenantState> m_tenants;
+};
+
+} // namespace salus
+
+#endif // SALUS_EXEC_SCHED_VIRTUALTIMEQUEUE_H
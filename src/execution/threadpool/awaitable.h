@@ -0,0 +1,78 @@
+/*
+ * Copyright 2019 Peifeng Yu <peifeng@umich.edu>
+ * 
+ * This file is part of Salus
+ * (see https://github.com/SymbioticLab/Salus).
+ * 
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * 
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef EXECUTION_THREADPOOL_AWAITABLE_H
+#define EXECUTION_THREADPOOL_AWAITABLE_H
+
+/**
+ * @file
+ * Awaiting a ThreadPool from coroutines. Needs C++20, see utils/coroutineutils.h.
+ */
+
+#include "execution/threadpool/threadpool.h"
+#include "utils/coroutineutils.h"
+
+#include <coroutine>
+
+/**
+ * @brief Awaitable that resumes the awaiting coroutine as a closure in the pool.
+ *
+ * The closure only holds the coroutine handle, so it fits in the inline storage and
+ * scheduling allocates nothing. If the pool is full, the coroutine resumes as `policy` says,
+ * which by default is right away on the awaiting thread.
+ */
+class ThreadPoolAwaiter
+{
+    ThreadPool &m_pool;
+    ThreadPool::Priority m_priority;
+    ThreadPool::OverflowPolicy m_policy;
+
+public:
+    ThreadPoolAwaiter(ThreadPool &pool, ThreadPool::Priority priority, ThreadPool::OverflowPolicy policy) noexcept
+        : m_pool(pool)
+        , m_priority(priority)
+        , m_policy(policy)
+    {
+    }
+
+    bool await_ready() const noexcept
+    {
+        return false;
+    }
+
+    void await_suspend(std::coroutine_handle<> h)
+    {
+        m_pool.run([h]() { h.resume(); }, m_priority, m_policy);
+    }
+
+    void await_resume() const noexcept
+    {
+    }
+};
+
+/**
+ * @brief `co_await scheduleOn(pool)` continues the coroutine on a worker of pool
+ */
+inline ThreadPoolAwaiter scheduleOn(ThreadPool &pool, ThreadPool::Priority priority = ThreadPool::Priority::Normal,
+                                    ThreadPool::OverflowPolicy policy = ThreadPool::OverflowPolicy::Inline)
+{
+    return {pool, priority, policy};
+}
+
+#endif // EXECUTION_THREADPOOL_AWAITABLE_H
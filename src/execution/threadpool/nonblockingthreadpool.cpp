@@ -27,15 +27,114 @@
 #include "utils/fixed_function.hpp"
 #include "RunQueue.h"
 #include "platform/thread_annotations.h"
+#include "utils/threadutils.h"
+#include "config.h"
 
+#include <algorithm>
 #include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
 #include <memory>
+#include <mutex>
 #include <thread>
 #include <vector>
 
 using std::unique_ptr;
 using std::vector;
 
+namespace {
+// Every this many picks, a worker looks at lower priority levels first
+constexpr unsigned kAgingPeriod = 16;
+
+// Waiting for work shorter than this means spinning a bit longer would have found the work
+constexpr auto kShortWait = std::chrono::microseconds(100);
+// Smallest spin count to grow to from zero
+constexpr int kMinSpinGrowth = 8;
+// Weight of the latest spin in the moving average of spin hit rate, about the last 16 spins count
+constexpr double kHitRateWeight = 1.0 / 16;
+// Spinning is only lengthened after a miss if at least this share of recent spins found work
+constexpr double kMinHitRate = 0.5;
+// An elastic pool adds a worker when all workers stay busy for this long while work is submitted
+constexpr auto kGrowAfter = std::chrono::milliseconds(1);
+
+int64_t nowNs()
+{
+    using namespace std::chrono;
+    return duration_cast<nanoseconds>(steady_clock::now().time_since_epoch()).count();
+}
+
+/**
+ * Spin count of one worker, adapted to the outcome of recent spins.
+ * A spin that found work moves the count toward twice what it used. After a spin that found
+ * nothing, the count only grows if most recent spins found work and the work came soon after;
+ * otherwise it halves, so a mostly idle worker stops burning its core.
+ */
+class SpinBudget
+{
+public:
+    SpinBudget(int initial, int min, int max, bool adaptive)
+        : m_min(std::max(min, 0))
+        , m_max(std::max(max, m_min))
+        , m_adaptive(adaptive)
+        , m_count(adaptive ? std::clamp(initial, m_min, m_max) : initial)
+    {
+    }
+
+    int count() const
+    {
+        return m_count;
+    }
+
+    bool adaptive() const
+    {
+        return m_adaptive;
+    }
+
+    /**
+     * Spinning found work after `used` iterations
+     */
+    void hit(int used)
+    {
+        if (!m_adaptive) {
+            return;
+        }
+        m_hitRate += (1 - m_hitRate) * kHitRateWeight;
+        const auto target = std::clamp(used * 2, m_min, m_max);
+        m_count += (target - m_count) / 2;
+    }
+
+    /**
+     * Spinning found nothing, and the worker then waited `waited` for work
+     */
+    void miss(std::chrono::steady_clock::duration waited)
+    {
+        if (!m_adaptive) {
+            return;
+        }
+        m_hitRate -= m_hitRate * kHitRateWeight;
+        if (waited < kShortWait && m_hitRate >= kMinHitRate) {
+            m_count = std::clamp(m_count * 2, std::min(kMinSpinGrowth, m_max), m_max);
+        } else {
+            m_count = std::max(m_min, m_count / 2);
+        }
+    }
+
+private:
+    const int m_min;
+    const int m_max;
+    const bool m_adaptive;
+    int m_count;
+    double m_hitRate = kMinHitRate;
+};
+
+#if defined(SALUS_ENABLE_THREADPOOL_STATS)
+constexpr bool kCollectStats = true;
+#else
+constexpr bool kCollectStats = false;
+#endif
+} // namespace
+
 struct Task
 {
     ThreadPool::Closure c;
@@ -78,6 +177,17 @@ class ThreadPoolPrivate
     ThreadPool *const q; // NOLINT
 
     using Queue = RunQueue<Task, 1024>;
+    using Priority = ThreadPool::Priority;
+    using OverflowPolicy = ThreadPool::OverflowPolicy;
+    static constexpr size_t kNumLevels = ThreadPool::kNumPriorities;
+
+    /**
+     * @brief One queue per priority level for each worker
+     */
+    struct WorkerQueues
+    {
+        Queue levels[kNumLevels];
+    };
 
     ThreadPoolPrivate(const ThreadPoolPrivate &) = delete;
     ThreadPoolPrivate &operator =(const ThreadPoolPrivate &) = delete;
@@ -88,10 +198,15 @@ public:
     ThreadPoolPrivate(ThreadPool *q, const ThreadPoolOptions &options);
     ~ThreadPoolPrivate();
 
-    Task tryRun(Task c);
+    Task tryRun(Task c, Priority priority, OverflowPolicy policy);
+    size_t runBatch(ThreadPool::Closure *first, ThreadPool::Closure *last, Priority priority,
+                    OverflowPolicy policy);
+    ThreadPool::OverflowStats overflowStats() const;
+    std::vector<ThreadPool::WorkerStats> workerStats() const;
     void stop();
     void join();
     size_t numThreads() const;
+    size_t numActiveThreads() const;
     int currentThreadId() const;
 
 private:
@@ -101,31 +216,174 @@ private:
             : pool(nullptr)
             , rand(0)
             , thread_id(-1)
+            , picks(0)
         {
         }
         ThreadPoolPrivate *pool; // Parent pool, or null for normal threads.
         uint64_t rand;           // Random generator state.
         int thread_id;           // Worker thread index in pool.
+        unsigned picks;          // Tasks looked for, drives the aging of priority levels.
+    };
+
+    /**
+     * Counters of one worker. Only the worker itself writes them, and each one has
+     * its own cache lines, so bumping is a plain load and store.
+     */
+    struct alignas(64) WorkerCounters
+    {
+        std::atomic<uint64_t> tasks{0};
+        std::atomic<uint64_t> localTasks{0};
+        std::atomic<uint64_t> stolenTasks{0};
+        std::atomic<uint64_t> overflowTasks{0};
+        std::atomic<uint64_t> stealAttempts{0};
+        std::atomic<uint64_t> spins{0};
+        std::atomic<uint64_t> parks{0};
+        std::atomic<uint64_t> unparks{0};
+        std::atomic<size_t> maxQueueDepth{0};
     };
 
+    static void bump(std::atomic<uint64_t> &c, uint64_t n = 1)
+    {
+        c.store(c.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+    }
+
+    /**
+     * Call f with the counters of the calling worker. Compiled out when stats are disabled.
+     */
+    template<typename F>
+    void count(PerThread *pt, F &&f)
+    {
+        if constexpr (kCollectStats) {
+            if (pt->pool == this) {
+                f(m_counters[pt->thread_id]);
+            }
+        }
+    }
+
+    /**
+     * Pick CPUs for each worker as options.affinity says, and group workers by NUMA node.
+     */
+    void planPlacement();
+
+    bool elastic() const
+    {
+        return m_options.minThreads != 0;
+    }
+
+    /**
+     * Start a worker in slot i, joining the one that retired from it before.
+     */
+    void startWorker(size_t i) EXCLUSIVE_LOCKS_REQUIRED(m_growMu);
+
+    /**
+     * Called on submission. Start one more worker if the pool is elastic and all
+     * workers have been busy for a while.
+     */
+    void maybeGrow();
+
+    /**
+     * Called by an idle worker about to block. Whether it should exit instead,
+     * because the pool has been idle long enough and has more than minThreads workers.
+     */
+    bool tryRetire(int thread_id);
+
+    /**
+     * A slot with a running worker, starting from a random one. Any slot if the pool is not elastic.
+     */
+    size_t liveSlot(unsigned r) const;
+
     /**
      * Main worker thread loop.
      */
     void workerLoop(int thread_id);
 
+    /**
+     * Pop from the worker's own queues, higher levels first unless `lowFirst`.
+     */
+    Task popLocal(WorkerQueues &queues, PerThread *pt, bool lowFirst);
+
     /**
      * Steal tries to steal work from other worker threads in best-effort manner.
+     * Higher levels are tried first on all victims unless `lowFirst`.
+     */
+    Task steal(bool lowFirst);
+
+    /**
+     * Steal from the given level of other worker threads, the ones on the same NUMA node first.
+     */
+    Task stealLevel(size_t level, PerThread *pt);
+
+    /**
+     * Whether it's this pick's turn to look at lower levels first. Called once per pick.
+     */
+    static bool aging(PerThread *pt)
+    {
+        return ++pt->picks % kAgingPeriod == 0;
+    }
+
+    /**
+     * Call `fn` on each level in `used`, higher levels first unless `lowFirst`, until it returns a task.
      */
-    Task steal();
+    template<typename Fn>
+    static Task forEachLevel(unsigned used, bool lowFirst, Fn &&fn)
+    {
+        // Only the default level in use is the common case, no need to walk the mask.
+        // used is never empty, Normal is always in it.
+        if ((used & (used - 1)) == 0) {
+            return fn(static_cast<size_t>(__builtin_ctz(used)));
+        }
+        for (size_t i = 0; i != kNumLevels; ++i) {
+            const auto level = lowFirst ? kNumLevels - 1 - i : i;
+            if (!(used & (1u << level))) {
+                continue;
+            }
+            if (auto t = fn(level)) {
+                return t;
+            }
+        }
+        return {};
+    }
 
     /**
      * waitForWork blocks until new work is available (returns true), or if it is
-     * time to exit (returns false). Can optionally return a task to execute in t
+     * time to exit or to retire from an elastic pool (returns false). Can optionally return a task to execute in t
      * (in such case t.f != nullptr on return).
      */
     bool waitForWork(EventCount::Waiter *waiter, Task *t);
 
-    int nonEmptyQueueIndex();
+    Queue *nonEmptyQueue();
+
+    /**
+     * Put t in the overflow queue, unless it's full.
+     * @returns t itself if the overflow queue is full
+     */
+    Task pushOverflow(Task t, size_t level);
+
+    /**
+     * Pop from the overflow queue, higher levels first. Cheap if it is empty.
+     */
+    Task popOverflow();
+
+    /**
+     * Make sure workers look at the level from now on.
+     */
+    void useLevel(unsigned level)
+    {
+        const auto bit = 1u << level;
+        if (!(m_usedLevels.load(std::memory_order_relaxed) & bit)) {
+            m_usedLevels.fetch_or(bit);
+        }
+    }
+
+    /**
+     * Wake up to n workers with one call if n covers all of them.
+     */
+    void notifyN(size_t n);
+
+    bool hasOverflow() const
+    {
+        return m_overflowDepth.load() != 0;
+    }
 
     static inline PerThread *getPerThread()
     {
@@ -143,8 +401,11 @@ private:
     }
 
     ThreadPoolOptions m_options;
-    vector<std::thread> m_threads;
-    vector<Queue> m_queues;
+    // One slot per possible worker, with its thread, queues and waiter
+    vector<std::thread> m_threads GUARDED_BY(m_growMu);
+    vector<WorkerQueues> m_queues;
+    // Bit set of levels ever pushed to, so unused levels cost nothing when looking for work
+    std::atomic<unsigned> m_usedLevels;
     vector<unsigned> m_coprimes;
     vector<EventCount::Waiter> m_waiters;
     std::atomic<unsigned> m_blocked;
@@ -152,6 +413,32 @@ private:
     std::atomic<bool> m_done;
     std::atomic<bool> m_cancelled;
     EventCount m_ec;
+    // Empty unless stats are collected
+    vector<WorkerCounters> m_counters;
+
+    // CPUs each worker is pinned to, empty if not pinned
+    vector<vector<int>> m_workerCpus;
+    // NUMA node of each worker and workers on each node, empty unless pinned over several nodes
+    vector<unsigned> m_workerNode;
+    vector<vector<unsigned>> m_nodeWorkers;
+
+    // Elastic mode. Slots not live have no worker, but may still hold closures pushed
+    // while their worker retired, which others pick up as all slots are stolen from.
+    std::mutex m_growMu;
+    vector<std::atomic<bool>> m_slotLive;
+    std::atomic<size_t> m_numLive{0};
+    // Last time a worker went idle, and last time a submission found no worker parked
+    std::atomic<int64_t> m_lastIdle{0};
+    std::atomic<int64_t> m_lastBusy{0};
+
+    // Shared by all workers, only touched when some worker queue is full
+    std::deque<Task> m_overflow[kNumLevels] GUARDED_BY(m_overflowMu);
+    mutable std::mutex m_overflowMu;
+    std::atomic<size_t> m_overflowDepth{0};
+    size_t m_overflowMaxDepth GUARDED_BY(m_overflowMu) = 0;
+    std::atomic<uint64_t> m_overflowed{0};
+    std::atomic<uint64_t> m_inlined{0};
+    std::atomic<uint64_t> m_rejected{0};
 };
 
 ThreadPool::ThreadPool(const ThreadPoolOptions &options)
@@ -161,12 +448,24 @@ ThreadPool::ThreadPool(const ThreadPoolOptions &options)
 
 ThreadPool::~ThreadPool() = default;
 
-ThreadPool::Closure ThreadPool::tryRun(Closure c)
+ThreadPool::Closure ThreadPool::tryRun(Closure c, Priority priority, OverflowPolicy policy)
 {
     Task t(std::move(c));
-    t = d->tryRun(std::move(t));
+    t = d->tryRun(std::move(t), priority, policy);
     return std::move(t.c);
 }
+size_t ThreadPool::runBatch(Closure *first, Closure *last, Priority priority, OverflowPolicy policy)
+{
+    return d->runBatch(first, last, priority, policy);
+}
+ThreadPool::OverflowStats ThreadPool::overflowStats() const
+{
+    return d->overflowStats();
+}
+std::vector<ThreadPool::WorkerStats> ThreadPool::workerStats() const
+{
+    return d->workerStats();
+}
 void ThreadPool::stop()
 {
     d->stop();
@@ -179,6 +478,10 @@ size_t ThreadPool::numThreads() const
 {
     return d->numThreads();
 }
+size_t ThreadPool::numActiveThreads() const
+{
+    return d->numActiveThreads();
+}
 int ThreadPool::currentThreadId() const
 {
     return d->currentThreadId();
@@ -189,6 +492,7 @@ ThreadPoolPrivate::ThreadPoolPrivate(ThreadPool *q, const ThreadPoolOptions &opt
     , m_options(options)
     // Queue is not movable or copyable, thus can only be constructed this way
     , m_queues(options.numThreads)
+    , m_usedLevels(1u << static_cast<unsigned>(Priority::Normal))
     // Waiter is not movable or copyable, thus can only be constructed this way
     , m_waiters(options.numThreads)
     , m_blocked(0)
@@ -196,10 +500,15 @@ ThreadPoolPrivate::ThreadPoolPrivate(ThreadPool *q, const ThreadPoolOptions &opt
     , m_done(false)
     , m_cancelled(false)
     , m_ec(m_waiters)
+    , m_counters(kCollectStats ? options.numThreads : 0)
+    , m_slotLive(options.numThreads)
 {
     auto numThreads = m_options.numThreads;
+    if (m_options.minThreads >= numThreads) {
+        // Nothing to grow into
+        m_options.minThreads = 0;
+    }
 
-    m_threads.reserve(numThreads);
     m_coprimes.reserve(numThreads);
 
     // Calculate coprimes of numThreads.
@@ -223,21 +532,180 @@ ThreadPoolPrivate::ThreadPoolPrivate(ThreadPool *q, const ThreadPoolOptions &opt
         }
     }
 
-    for (size_t i = 0; i < numThreads; i++) {
-        m_threads.emplace_back([this, i]() { workerLoop(i); });
+    planPlacement();
+
+    auto g = sstl::with_guard(m_growMu);
+    m_threads.resize(numThreads);
+    const auto initial = elastic() ? m_options.minThreads : numThreads;
+    m_lastIdle = nowNs();
+    m_lastBusy = nowNs();
+    for (size_t i = 0; i < initial; i++) {
+        startWorker(i);
+    }
+}
+
+void ThreadPoolPrivate::startWorker(size_t i)
+{
+    if (m_threads[i].joinable()) {
+        // The retired worker is done with the slot, or about to be
+        m_threads[i].join();
+    }
+    m_slotLive[i] = true;
+    ++m_numLive;
+    m_threads[i] = std::thread([this, i]() { workerLoop(i); });
+}
+
+void ThreadPoolPrivate::maybeGrow()
+{
+    if (!elastic() || m_blocked.load(std::memory_order_relaxed) != 0) {
+        // A parked worker is spare capacity, and will be woken for the work
+        return;
+    }
+    // No worker parked. A spinning one is only between closures, so the pool still counts as busy.
+    const auto now = nowNs();
+    const auto growAfter = std::chrono::nanoseconds(kGrowAfter).count();
+    if (now - m_lastBusy.load(std::memory_order_relaxed) > growAfter / 10) {
+        // Don't bounce the cache line on every submission
+        m_lastBusy.store(now, std::memory_order_relaxed);
+    }
+    if (m_spinning.load(std::memory_order_relaxed)) {
+        // It will pick up the work, no need to grow
+        return;
+    }
+    if (m_numLive.load(std::memory_order_relaxed) >= m_options.numThreads
+        || now - m_lastIdle.load(std::memory_order_relaxed) < growAfter) {
+        return;
+    }
+
+    auto g = sstl::with_guard(m_growMu);
+    if (m_done || m_numLive >= m_options.numThreads) {
+        return;
+    }
+    for (size_t i = 0; i != m_slotLive.size(); ++i) {
+        if (!m_slotLive[i]) {
+            // Count as idle, so the next one is added only if the pool stays busy
+            m_lastIdle = now;
+            startWorker(i);
+            return;
+        }
+    }
+}
+
+bool ThreadPoolPrivate::tryRetire(int thread_id)
+{
+    if (!elastic() || m_done) {
+        return false;
+    }
+    const auto idleFor = std::chrono::nanoseconds(nowNs() - m_lastBusy.load(std::memory_order_relaxed));
+    if (idleFor < m_options.idleTimeout) {
+        return false;
+    }
+    auto live = m_numLive.load();
+    do {
+        if (live <= m_options.minThreads) {
+            return false;
+        }
+    } while (!m_numLive.compare_exchange_weak(live, live - 1));
+    m_slotLive[thread_id] = false;
+    if (m_done) {
+        // Others may have compared blocked workers against the old live count for termination
+        m_ec.Notify(true);
+    }
+    return true;
+}
+
+size_t ThreadPoolPrivate::liveSlot(unsigned r) const
+{
+    const size_t size = m_queues.size();
+    size_t slot = r % size;
+    if (!elastic()) {
+        return slot;
+    }
+    for (size_t i = 0; i != size; ++i) {
+        if (m_slotLive[slot].load(std::memory_order_relaxed)) {
+            return slot;
+        }
+        if (++slot == size) {
+            slot = 0;
+        }
+    }
+    // Everything retired in between, any slot works as all are stolen from
+    return slot;
+}
+
+void ThreadPoolPrivate::planPlacement()
+{
+    using Affinity = ThreadPoolOptions::Affinity;
+    const auto numThreads = m_options.numThreads;
+    if (m_options.affinity == Affinity::None || numThreads == 0) {
+        return;
+    }
+
+    auto nodes = salus::threading::numa_nodes();
+    m_workerCpus.reserve(numThreads);
+    if (m_options.affinity == Affinity::Explicit) {
+        const auto &sets = m_options.cpuSets;
+        if (sets.empty()) {
+            return;
+        }
+        for (size_t i = 0; i != numThreads; ++i) {
+            m_workerCpus.push_back(sets[i % sets.size()]);
+        }
+    } else {
+        if (nodes.empty()) {
+            return;
+        }
+        size_t totalCpus = 0;
+        for (const auto &cpus : nodes) {
+            totalCpus += cpus.size();
+        }
+        for (size_t i = 0; i != numThreads; ++i) {
+            size_t node = 0;
+            if (m_options.affinity == Affinity::Compact) {
+                // As many workers on a node as it has CPUs, wrapping around if there are more workers
+                auto slot = i % totalCpus;
+                while (slot >= nodes[node].size()) {
+                    slot -= nodes[node].size();
+                    ++node;
+                }
+            } else {
+                node = i % nodes.size();
+            }
+            m_workerCpus.push_back(nodes[node]);
+        }
+    }
+
+    if (nodes.size() <= 1) {
+        return;
+    }
+    // A worker belongs to the node of the first CPU it is pinned to
+    m_workerNode.resize(numThreads, 0);
+    m_nodeWorkers.resize(nodes.size());
+    for (size_t i = 0; i != numThreads; ++i) {
+        const auto &cpus = m_workerCpus[i];
+        for (size_t node = 0; node != nodes.size() && !cpus.empty(); ++node) {
+            if (std::find(nodes[node].begin(), nodes[node].end(), cpus.front()) != nodes[node].end()) {
+                m_workerNode[i] = node;
+                break;
+            }
+        }
+        m_nodeWorkers[m_workerNode[i]].push_back(i);
     }
 }
 
-Task ThreadPoolPrivate::tryRun(Task t)
+Task ThreadPoolPrivate::tryRun(Task t, Priority priority, OverflowPolicy policy)
 {
+    const auto level = static_cast<unsigned>(priority);
+    useLevel(level);
+
     auto pt = getPerThread();
     if (pt->pool == this) {
         // Worker thread of this pool, push onto the thread's queue.
-        t = m_queues[pt->thread_id].PushFront(std::move(t));
+        t = m_queues[pt->thread_id].levels[level].PushFront(std::move(t));
     } else {
         // A free-standing thread (or worker of another pool), push onto a random
         // queue.
-        t = m_queues[rand(&pt->rand) % m_queues.size()].PushBack(std::move(t));
+        t = m_queues[liveSlot(rand(&pt->rand))].levels[level].PushBack(std::move(t));
     }
     // Note: below we touch this after making w available to worker threads.
     // Strictly speaking, this can lead to a racy-use-after-free. Consider that
@@ -246,10 +714,183 @@ Task ThreadPoolPrivate::tryRun(Task t)
     // completes overall computations, which in turn leads to destruction of
     // this. We expect that such scenario is prevented by program, that is,
     // this is kept alive while any threads can potentially be in Schedule.
-    if (!t) {
+    if (t) {
+        switch (policy) {
+        case OverflowPolicy::Overflow:
+            t = pushOverflow(std::move(t), level);
+            if (t) {
+                m_rejected.fetch_add(1, std::memory_order_relaxed);
+                return t;
+            }
+            break;
+        case OverflowPolicy::Inline:
+            m_inlined.fetch_add(1, std::memory_order_relaxed);
+            t();
+            return {};
+        case OverflowPolicy::Reject:
+            m_rejected.fetch_add(1, std::memory_order_relaxed);
+            return t;
+        }
+    }
+    m_ec.Notify(false);
+    maybeGrow();
+    return {};
+}
+
+size_t ThreadPoolPrivate::runBatch(ThreadPool::Closure *first, ThreadPool::Closure *last, Priority priority,
+                                   OverflowPolicy policy)
+{
+    if (first == last) {
+        return 0;
+    }
+
+    const auto level = static_cast<unsigned>(priority);
+    useLevel(level);
+
+    // Walk worker queues in a pseudo-random permutation, same as steal(), and move on
+    // to the next queue after each push so the batch is spread evenly. A full queue is
+    // skipped, and a closure is left over only after all queues have been tried.
+    auto pt = getPerThread();
+    const size_t size = m_queues.size();
+    unsigned r = rand(&pt->rand);
+    unsigned inc = m_coprimes[r % m_coprimes.size()];
+    unsigned victim = r % size;
+
+    size_t queued = 0;
+    size_t leftover = 0;
+    for (auto it = first; it != last; ++it) {
+        if (!*it) {
+            continue;
+        }
+        Task t(std::move(*it));
+        for (size_t i = 0; i != size && t; ++i) {
+            if (elastic() && !m_slotLive[victim].load(std::memory_order_relaxed)) {
+                // no worker to pick it up soon
+            } else if (pt->pool == this && victim == static_cast<unsigned>(pt->thread_id)) {
+                t = m_queues[victim].levels[level].PushFront(std::move(t));
+            } else {
+                t = m_queues[victim].levels[level].PushBack(std::move(t));
+            }
+            victim += inc;
+            if (victim >= size) {
+                victim -= size;
+            }
+        }
+        if (t && policy == OverflowPolicy::Overflow) {
+            t = pushOverflow(std::move(t), level);
+        }
+        if (t) {
+            // put it back, queued closures leave empty ones behind
+            *it = std::move(t.c);
+            ++leftover;
+        } else {
+            ++queued;
+        }
+    }
+
+    notifyN(queued);
+    if (queued) {
+        maybeGrow();
+    }
+
+    if (leftover == 0) {
+        return 0;
+    }
+    if (policy != OverflowPolicy::Inline) {
+        m_rejected.fetch_add(leftover, std::memory_order_relaxed);
+        return leftover;
+    }
+    // Run after the wakeup, so workers are already on the queued ones
+    m_inlined.fetch_add(leftover, std::memory_order_relaxed);
+    for (auto it = first; it != last; ++it) {
+        if (*it) {
+            auto c = std::move(*it);
+            c();
+        }
+    }
+    return 0;
+}
+
+void ThreadPoolPrivate::notifyN(size_t n)
+{
+    if (n == 0) {
+        return;
+    }
+    if (n >= m_numLive.load(std::memory_order_relaxed)) {
+        m_ec.Notify(true);
+        return;
+    }
+    for (size_t i = 0; i != n; ++i) {
         m_ec.Notify(false);
     }
-    return t;
+}
+
+Task ThreadPoolPrivate::pushOverflow(Task t, size_t level)
+{
+    {
+        auto g = sstl::with_guard(m_overflowMu);
+        auto depth = m_overflowDepth.load(std::memory_order_relaxed);
+        if (depth >= m_options.maxOverflow) {
+            return t;
+        }
+        m_overflow[level].emplace_back(std::move(t));
+        m_overflowDepth.store(depth + 1);
+        m_overflowMaxDepth = std::max(m_overflowMaxDepth, depth + 1);
+    }
+    m_overflowed.fetch_add(1, std::memory_order_relaxed);
+    return {};
+}
+
+Task ThreadPoolPrivate::popOverflow()
+{
+    if (!hasOverflow()) {
+        return {};
+    }
+    auto g = sstl::with_guard(m_overflowMu);
+    for (auto &q : m_overflow) {
+        if (!q.empty()) {
+            auto t = std::move(q.front());
+            q.pop_front();
+            m_overflowDepth.store(m_overflowDepth.load(std::memory_order_relaxed) - 1);
+            count(getPerThread(), [](auto &c) { bump(c.overflowTasks); });
+            return t;
+        }
+    }
+    return {};
+}
+
+ThreadPool::OverflowStats ThreadPoolPrivate::overflowStats() const
+{
+    ThreadPool::OverflowStats stats;
+    stats.overflowed = m_overflowed.load(std::memory_order_relaxed);
+    stats.inlined = m_inlined.load(std::memory_order_relaxed);
+    stats.rejected = m_rejected.load(std::memory_order_relaxed);
+    stats.depth = m_overflowDepth.load(std::memory_order_relaxed);
+    {
+        auto g = sstl::with_guard(m_overflowMu);
+        stats.maxDepth = m_overflowMaxDepth;
+    }
+    return stats;
+}
+
+std::vector<ThreadPool::WorkerStats> ThreadPoolPrivate::workerStats() const
+{
+    std::vector<ThreadPool::WorkerStats> stats;
+    stats.reserve(m_counters.size());
+    for (const auto &c : m_counters) {
+        ThreadPool::WorkerStats ws;
+        ws.tasks = c.tasks.load(std::memory_order_relaxed);
+        ws.localTasks = c.localTasks.load(std::memory_order_relaxed);
+        ws.stolenTasks = c.stolenTasks.load(std::memory_order_relaxed);
+        ws.overflowTasks = c.overflowTasks.load(std::memory_order_relaxed);
+        ws.stealAttempts = c.stealAttempts.load(std::memory_order_relaxed);
+        ws.spins = c.spins.load(std::memory_order_relaxed);
+        ws.parks = c.parks.load(std::memory_order_relaxed);
+        ws.unparks = c.unparks.load(std::memory_order_relaxed);
+        ws.maxQueueDepth = c.maxQueueDepth.load(std::memory_order_relaxed);
+        stats.emplace_back(ws);
+    }
+    return stats;
 }
 
 void ThreadPoolPrivate::stop()
@@ -263,7 +904,14 @@ void ThreadPoolPrivate::stop()
 
 void ThreadPoolPrivate::join()
 {
-    for (auto &thr : m_threads) {
+    // Not joining under the lock, as a worker may be submitting and trying to grow
+    vector<std::thread> threads;
+    {
+        auto g = sstl::with_guard(m_growMu);
+        threads.swap(m_threads);
+        m_threads.resize(threads.size());
+    }
+    for (auto &thr : threads) {
         if (thr.joinable()) {
             thr.join();
         }
@@ -275,6 +923,11 @@ size_t ThreadPoolPrivate::numThreads() const
     return m_options.numThreads;
 }
 
+size_t ThreadPoolPrivate::numActiveThreads() const
+{
+    return m_numLive.load(std::memory_order_relaxed);
+}
+
 int ThreadPoolPrivate::currentThreadId() const
 {
     auto pt = getPerThread();
@@ -297,35 +950,52 @@ ThreadPoolPrivate::~ThreadPoolPrivate()
     } else {
         // Since we were cancelled, there might be entries in the queues.
         // Empty them to prevent their destructor from asserting.
-        for (auto &q : m_queues) {
-            q.Flush();
+        for (auto &wq : m_queues) {
+            for (auto &q : wq.levels) {
+                q.Flush();
+            }
+        }
+        auto g = sstl::with_guard(m_overflowMu);
+        for (auto &q : m_overflow) {
+            q.clear();
         }
+        m_overflowDepth = 0;
     }
 
     // Join threads explicitly to avoid destruction order issues.
     join();
 
-    m_threads.clear();
+    {
+        auto g = sstl::with_guard(m_growMu);
+        m_threads.clear();
+    }
     m_queues.clear();
 }
 
-int ThreadPoolPrivate::nonEmptyQueueIndex()
+ThreadPoolPrivate::Queue *ThreadPoolPrivate::nonEmptyQueue()
 {
     auto pt = getPerThread();
     const size_t size = m_queues.size();
-    unsigned r = rand(&pt->rand);
-    unsigned inc = m_coprimes[r % m_coprimes.size()];
-    unsigned victim = r % size;
-    for (unsigned i = 0; i < size; i++) {
-        if (!m_queues[victim].Empty()) {
-            return victim;
+    const auto used = m_usedLevels.load(std::memory_order_relaxed);
+    for (size_t level = 0; level != kNumLevels; ++level) {
+        if (!(used & (1u << level))) {
+            continue;
         }
-        victim += inc;
-        if (victim >= size) {
-            victim -= size;
+        unsigned r = rand(&pt->rand);
+        unsigned inc = m_coprimes[r % m_coprimes.size()];
+        unsigned victim = r % size;
+        for (unsigned i = 0; i < size; i++) {
+            auto &q = m_queues[victim].levels[level];
+            if (!q.Empty()) {
+                return &q;
+            }
+            victim += inc;
+            if (victim >= size) {
+                victim -= size;
+            }
         }
     }
-    return -1;
+    return nullptr;
 }
 
 void ThreadPoolPrivate::workerLoop(int thread_id)
@@ -335,10 +1005,17 @@ void ThreadPoolPrivate::workerLoop(int thread_id)
     } else {
         salus::threading::set_thread_name(m_options.workerName);
     }
+    if (!m_workerCpus.empty()) {
+        // Best effort, the worker still runs if pinning fails
+        salus::threading::set_thread_affinity(m_workerCpus[thread_id]);
+    }
 
     const auto numThreads = m_options.numThreads;
     const auto spinCount = m_options.spinCount;
     const auto allowSpinning = m_options.allowSpinning;
+    SpinBudget spin(spinCount, m_options.minSpinCount < 0 ? spinCount / 10 : m_options.minSpinCount,
+                    m_options.maxSpinCount < 0 ? spinCount * 4 : m_options.maxSpinCount,
+                    allowSpinning && m_options.adaptiveSpinning);
 
     auto pt = getPerThread();
     pt->pool = this;
@@ -355,62 +1032,142 @@ void ThreadPoolPrivate::workerLoop(int thread_id)
         // counter-productive for the types of I/O workloads the single thread
         // pools tend to be used for.
         while (!m_cancelled) {
-            auto t = q.PopFront();
-            for (int i = 0; i < spinCount && !t; i++) {
+            const bool lowFirst = aging(pt);
+            auto t = popLocal(q, pt, lowFirst);
+            int spins = 0;
+            for (const auto budget = spin.count(); spins < budget && !t; spins++) {
                 if (!m_cancelled.load(std::memory_order_relaxed)) {
-                    t = q.PopFront();
+                    t = popLocal(q, pt, lowFirst);
                 }
             }
+            count(pt, [spins](auto &c) { bump(c.spins, spins); });
+            if (t) {
+                spin.hit(spins);
+            } else {
+                t = popOverflow();
+            }
             if (!t) {
+                const auto start = spin.adaptive() ? std::chrono::steady_clock::now()
+                                                   : std::chrono::steady_clock::time_point{};
                 if (!waitForWork(waiter, &t)) {
                     return;
                 }
+                if (spin.adaptive()) {
+                    spin.miss(std::chrono::steady_clock::now() - start);
+                }
             }
             if (t) {
+                count(pt, [](auto &c) { bump(c.tasks); });
                 t();
             }
         }
     } else {
         while (!m_cancelled) {
-            auto t = q.PopFront();
+            const bool lowFirst = aging(pt);
+            auto t = popLocal(q, pt, lowFirst);
             if (!t) {
-                t = steal();
+                t = steal(lowFirst);
                 if (!t) {
                     // Leave one thread spinning. This reduces latency.
+                    bool spun = false;
                     if (allowSpinning && !m_spinning && !m_spinning.exchange(true)) {
-                        for (int i = 0; i < spinCount && !t; i++) {
+                        spun = true;
+                        int spins = 0;
+                        for (const auto budget = spin.count(); spins < budget && !t; spins++) {
                             if (!m_cancelled.load(std::memory_order_relaxed)) {
-                                t = steal();
+                                t = steal(lowFirst);
                             } else {
                                 return;
                             }
                         }
+                        count(pt, [spins](auto &c) { bump(c.spins, spins); });
                         m_spinning = false;
+                        if (t) {
+                            spin.hit(spins);
+                        }
                     }
                     if (!t) {
+                        // Only the spinning thread learns from how long it waits
+                        const bool learn = spun && spin.adaptive();
+                        const auto start = learn ? std::chrono::steady_clock::now()
+                                                 : std::chrono::steady_clock::time_point{};
                         if (!waitForWork(waiter, &t)) {
                             return;
                         }
+                        if (learn) {
+                            spin.miss(std::chrono::steady_clock::now() - start);
+                        }
                     }
                 }
             }
             if (t) {
+                count(pt, [](auto &c) { bump(c.tasks); });
                 t();
             }
         }
     }
 }
 
-Task ThreadPoolPrivate::steal()
+Task ThreadPoolPrivate::popLocal(WorkerQueues &queues, PerThread *pt, bool lowFirst)
+{
+    const auto used = m_usedLevels.load(std::memory_order_relaxed);
+    count(pt, [&queues, used](auto &c) {
+        size_t depth = 0;
+        for (size_t level = 0; level != kNumLevels; ++level) {
+            if (used & (1u << level)) {
+                depth += queues.levels[level].Size();
+            }
+        }
+        if (depth > c.maxQueueDepth.load(std::memory_order_relaxed)) {
+            c.maxQueueDepth.store(depth, std::memory_order_relaxed);
+        }
+    });
+    auto t = forEachLevel(used, lowFirst, [&queues](size_t level) { return queues.levels[level].PopFront(); });
+    if (t) {
+        count(pt, [](auto &c) { bump(c.localTasks); });
+    }
+    return t;
+}
+
+Task ThreadPoolPrivate::steal(bool lowFirst)
 {
     auto pt = getPerThread();
+    count(pt, [](auto &c) { bump(c.stealAttempts); });
+    const auto used = m_usedLevels.load(std::memory_order_relaxed);
+    if (auto t = forEachLevel(used, lowFirst, [this, pt](size_t level) { return stealLevel(level, pt); })) {
+        return t;
+    }
+    // closures that didn't fit in any worker queue
+    return popOverflow();
+}
+
+Task ThreadPoolPrivate::stealLevel(size_t level, PerThread *pt)
+{
+    if (!m_nodeWorkers.empty() && pt->pool == this) {
+        // Same node first, their closures likely touch memory local to us
+        const auto &peers = m_nodeWorkers[m_workerNode[pt->thread_id]];
+        const size_t n = peers.size();
+        unsigned start = rand(&pt->rand) % n;
+        for (size_t i = 0; i != n; ++i) {
+            auto victim = peers[(start + i) % n];
+            if (static_cast<int>(victim) == pt->thread_id) {
+                continue;
+            }
+            if (auto t = m_queues[victim].levels[level].PopBack()) {
+                count(pt, [](auto &c) { bump(c.stolenTasks); });
+                return t;
+            }
+        }
+    }
+
     const size_t size = m_queues.size();
     unsigned r = rand(&pt->rand);
     unsigned inc = m_coprimes[r % m_coprimes.size()];
     unsigned victim = r % size;
     for (unsigned i = 0; i < size; i++) {
-        auto t = m_queues[victim].PopBack();
+        auto t = m_queues[victim].levels[level].PopBack();
         if (t) {
+            count(pt, [](auto &c) { bump(c.stolenTasks); });
             return t;
         }
         victim += inc;
@@ -423,31 +1180,51 @@ Task ThreadPoolPrivate::steal()
 
 bool ThreadPoolPrivate::waitForWork(EventCount::Waiter *waiter, Task *t)
 {
+    if (elastic()) {
+        m_lastIdle.store(nowNs(), std::memory_order_relaxed);
+    }
     // We already did best-effort emptiness check in Steal, so prepare for blocking.
     m_ec.Prewait(waiter);
     // Now do a reliable emptiness check.
-    int victim = nonEmptyQueueIndex();
-    if (victim != -1) {
+    auto victim = nonEmptyQueue();
+    if (victim || hasOverflow()) {
       m_ec.CancelWait(waiter);
       if (m_cancelled) {
         return false;
       } else {
-        *t = m_queues[victim].PopBack();
+        if (victim) {
+          *t = victim->PopBack();
+          if (*t) {
+            count(getPerThread(), [](auto &c) { bump(c.stolenTasks); });
+          }
+        } else {
+          *t = popOverflow();
+        }
         return true;
       }
     }
+    // Nothing to do, exit instead of blocking if there are more workers than needed
+    if (tryRetire(getPerThread()->thread_id)) {
+        m_ec.CancelWait(waiter);
+        // A closure pushed after the check above may have had its wakeup spent on this
+        // worker, which is leaving. Pass the wakeup on, other workers steal from this slot too.
+        if (nonEmptyQueue() || hasOverflow()) {
+            m_ec.Notify(false);
+        }
+        return false;
+    }
     // Number of blocked threads is used as termination condition.
     // If we are shutting down and all worker threads blocked without work,
     // that's we are done.
     m_blocked++;
-    if (m_done && m_blocked == m_options.numThreads) {
+    if (m_done && m_blocked == m_numLive) {
       m_ec.CancelWait(waiter);
       // Almost done, but need to re-check queues.
       // Consider that all queues are empty and all worker threads are preempted
       // right after incrementing blocked_ above. Now a free-standing thread
       // submits work and calls destructor (which sets done_). If we don't
       // re-check queues, we will exit leaving the work unexecuted.
-      if (nonEmptyQueueIndex() != -1) {
+      if (nonEmptyQueue() || hasOverflow()) {
         // Note: we must not pop from queues before we decrement blocked_,
         // otherwise the following scenario is possible. Consider that instead
         // of checking for emptiness we popped the only element from queues.
@@ -461,7 +1238,87 @@ bool ThreadPoolPrivate::waitForWork(EventCount::Waiter *waiter, Task *t)
       m_ec.Notify(true);
       return false;
     }
+    auto pt = getPerThread();
+    count(pt, [](auto &c) { bump(c.parks); });
     m_ec.CommitWait(waiter);
+    count(pt, [](auto &c) { bump(c.unparks); });
     m_blocked--;
     return true;
 }
+
+struct TaskGroup::State
+{
+    std::mutex mu;
+    std::condition_variable cv;
+    // not started yet
+    std::deque<ThreadPool::Closure> pending GUARDED_BY(mu);
+    // pending plus running
+    size_t unfinished GUARDED_BY(mu) = 0;
+    // threads blocked in wait()
+    size_t waiting GUARDED_BY(mu) = 0;
+};
+
+TaskGroup::TaskGroup(ThreadPool &pool, ThreadPool::Priority priority)
+    : m_pool(pool)
+    , m_priority(priority)
+    , m_state(std::make_shared<State>())
+{
+}
+
+TaskGroup::~TaskGroup()
+{
+    wait();
+}
+
+void TaskGroup::run(ThreadPool::Closure c)
+{
+    bool wake;
+    {
+        auto g = sstl::with_guard(m_state->mu);
+        m_state->pending.emplace_back(std::move(c));
+        ++m_state->unfinished;
+        wake = m_state->waiting != 0;
+    }
+    if (wake) {
+        // A waiter may be the only thread free to run it, e.g. all workers wait in nested groups
+        m_state->cv.notify_all();
+    }
+    // The pool closure may find nothing left if wait() took it already
+    m_pool.run([state = m_state]() { runNext(*state); }, m_priority);
+}
+
+bool TaskGroup::runNext(State &state)
+{
+    ThreadPool::Closure c;
+    {
+        auto g = sstl::with_guard(state.mu);
+        if (state.pending.empty()) {
+            return false;
+        }
+        c = std::move(state.pending.front());
+        state.pending.pop_front();
+    }
+    c();
+    auto g = sstl::with_guard(state.mu);
+    if (--state.unfinished == 0) {
+        state.cv.notify_all();
+    }
+    return true;
+}
+
+void TaskGroup::wait()
+{
+    auto &state = *m_state;
+    while (true) {
+        while (runNext(state)) {
+        }
+        // Closures still running may fork more into the group, run those as well
+        auto lk = sstl::with_uguard(state.mu);
+        ++state.waiting;
+        state.cv.wait(lk, [&state]() { return !state.pending.empty() || state.unfinished == 0; });
+        --state.waiting;
+        if (state.unfinished == 0) {
+            return;
+        }
+    }
+}
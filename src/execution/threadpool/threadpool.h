@@ -21,9 +21,14 @@
 #define EXECUTION_THREADPOOL_H
 
 #include "utils/fixed_function.hpp"
+#include "config.h"
 
+#include <algorithm>
+#include <chrono>
 #include <future>
 #include <memory>
+#include <string>
+#include <vector>
 
 struct ThreadPoolOptions
 {
@@ -62,6 +67,34 @@ struct ThreadPoolOptions
         return *this;
     }
 
+    /**
+     * Whether each worker adapts its spin count to how often spinning found work,
+     * between minSpinCount and maxSpinCount, starting from spinCount.
+     * Workers that mostly find nothing spin less than the fixed count, busy ones as much as
+     * they recently needed.
+     */
+    bool adaptiveSpinning = true;
+
+    ThreadPoolOptions &setAdaptiveSpinning(bool adaptive)
+    {
+        adaptiveSpinning = adaptive;
+        return *this;
+    }
+
+    /**
+     * Bounds of adaptive spin count.
+     * Use -1 for default values, which are spinCount / 10 and spinCount * 4
+     */
+    int minSpinCount = -1;
+    int maxSpinCount = -1;
+
+    ThreadPoolOptions &setSpinCountRange(int min, int max)
+    {
+        minSpinCount = min;
+        maxSpinCount = max;
+        return *this;
+    }
+
     /**
      * @brief Optional worker thread name, truncated at 16 characters.
      */
@@ -73,6 +106,72 @@ struct ThreadPoolOptions
         return *this;
     }
 
+    /**
+     * Maximum number of closures held in the shared overflow queue, used when
+     * a worker queue is full and the submission asks for overflow.
+     */
+    size_t maxOverflow = 4096;
+
+    ThreadPoolOptions &setMaxOverflow(size_t num)
+    {
+        maxOverflow = num;
+        return *this;
+    }
+
+    /**
+     * @brief How worker threads are pinned to CPUs
+     */
+    enum class Affinity
+    {
+        // Not pinned, the OS places workers
+        None,
+        // Fill NUMA nodes one after another, worker i pinned to its node's CPUs
+        Compact,
+        // Spread workers round robin over NUMA nodes
+        Scatter,
+        // Worker i pinned to cpuSets[i % cpuSets.size()]
+        Explicit,
+    };
+    Affinity affinity = Affinity::None;
+
+    ThreadPoolOptions &setAffinity(Affinity a)
+    {
+        affinity = a;
+        return *this;
+    }
+
+    /**
+     * CPU sets used by Affinity::Explicit
+     */
+    std::vector<std::vector<int>> cpuSets;
+
+    ThreadPoolOptions &setCpuSets(std::vector<std::vector<int>> sets)
+    {
+        affinity = Affinity::Explicit;
+        cpuSets = std::move(sets);
+        return *this;
+    }
+
+    /**
+     * Minimum number of threads in elastic mode. The pool starts with this many
+     * workers, and grows up to numThreads when all workers stay busy.
+     * Use 0 for a fixed pool of numThreads workers.
+     */
+    size_t minThreads = 0;
+
+    /**
+     * Workers above minThreads retire once the pool has not been busy for this long,
+     * i.e. every submission in that time found some worker parked.
+     */
+    std::chrono::milliseconds idleTimeout{5000};
+
+    ThreadPoolOptions &setElastic(size_t min, std::chrono::milliseconds timeout = std::chrono::milliseconds{5000})
+    {
+        minThreads = min;
+        idleTimeout = timeout;
+        return *this;
+    }
+
     ThreadPoolOptions();
     ThreadPoolOptions(const ThreadPoolOptions &) = default;
     ThreadPoolOptions(ThreadPoolOptions &&) = default;
@@ -95,23 +194,73 @@ public:
     ThreadPool(ThreadPool &&other) = default;
     ThreadPool &operator=(ThreadPool &&other) = default;
 
-    using Closure = sstl::FixedFunction<void()>;
+    /**
+     * @brief Bytes of captures a Closure stores inline, larger ones spill to a pooled block.
+     * Every RunQueue slot holds a Closure, so this trades queue footprint for fewer spills.
+     */
+    static constexpr size_t kClosureInlineSize = SALUS_THREADPOOL_CLOSURE_SIZE;
+
+    using Closure = sstl::FixedFunction<void(), kClosureInlineSize>;
+
+    /**
+     * @brief Priority levels of closures. Workers run and steal higher levels first,
+     * but every few picks they look at lower levels first, so those are never starved.
+     */
+    enum class Priority
+    {
+        High,
+        Normal,
+        Low,
+    };
+    static constexpr size_t kNumPriorities = 3;
+
+    /**
+     * @brief What to do with a closure when the worker queue it goes to is full.
+     */
+    enum class OverflowPolicy
+    {
+        // Hand the closure back to the caller
+        Reject,
+        // Put it in the shared overflow queue, which workers check after their own and stolen work.
+        // Rejected if the overflow queue is full as well.
+        Overflow,
+        // Run it on the calling thread
+        Inline,
+    };
 
     /**
      * @brief Try run a closure c in thread pool.
-     * @returns c itself if queue is full. Otherwise a default constructed Closure.
+     * @returns c itself if it is rejected. Otherwise a default constructed Closure.
      */
-    Closure tryRun(Closure c);
+    Closure tryRun(Closure c, Priority priority = Priority::Normal,
+                   OverflowPolicy policy = OverflowPolicy::Reject);
+
+    /**
+     * @brief Submit closures in [first, last) in one pass, followed by a single wakeup
+     * sized to the number of closures queued.
+     * Closures are spread round robin over worker queues, starting from a random one.
+     * Those that don't fit anywhere are handled as `policy` says. Rejected closures are
+     * left in place, all others are moved from.
+     * @returns number of closures rejected
+     */
+    size_t runBatch(Closure *first, Closure *last, Priority priority = Priority::Normal,
+                    OverflowPolicy policy = OverflowPolicy::Inline);
+
+    size_t runBatch(std::vector<Closure> &cs, Priority priority = Priority::Normal,
+                    OverflowPolicy policy = OverflowPolicy::Inline)
+    {
+        return runBatch(cs.data(), cs.data() + cs.size(), priority, policy);
+    }
 
     /**
      * @brief Run the Func f in thread pool, don't care about its completion.
      * This may be more efficient, because no wrapper task for future/promise is created.
-     * If the queue is full, then f is run on calling thread.
+     * If the queue is full, f is handled as `policy` says, and run on calling thread if rejected.
      */
     template<typename Func>
-    void run(Func f)
+    void run(Func f, Priority priority = Priority::Normal, OverflowPolicy policy = OverflowPolicy::Inline)
     {
-        auto c = tryRun(std::move(f));
+        auto c = tryRun(std::move(f), priority, policy);
         if (c) {
             // enqueue failed, run on current thread
             c();
@@ -120,21 +269,76 @@ public:
 
     /**
      * @brief Post the function f to thread pool, returns with a future holding the result.
-     * If the queue is full, then closure is executed on caller thread before return.
+     * If the queue is full, f is handled as `policy` says, and run on calling thread if rejected.
      * @returns future holding the return value of function f.
      */
     template<typename Func>
-    auto post(Func f)
+    auto post(Func f, Priority priority = Priority::Normal, OverflowPolicy policy = OverflowPolicy::Inline)
     {
         using R = std::invoke_result_t<Func>;
         using Task = std::packaged_task<R()>;
 
         Task tk(std::move(f));
         auto fu = tk.get_future();
-        run(std::move(tk));
+        run(std::move(tk), priority, policy);
         return fu;
     }
 
+    /**
+     * @brief Call fn(first, last) over subranges covering [begin, end) in parallel, and
+     * return when all are done. The calling thread runs subranges too while waiting.
+     *
+     * The range is split in halves recursively, so idle workers steal large pieces first.
+     * Splitting stops at `grain` items, or earlier if there would be more than a few
+     * subranges per running worker. Use 0 as grain to only split by worker count.
+     */
+    template<typename Func>
+    void parallelFor(size_t begin, size_t end, size_t grain, Func &&fn);
+
+    /**
+     * @brief Counters of closures that didn't fit in worker queues
+     */
+    struct OverflowStats
+    {
+        // put in overflow queue
+        uint64_t overflowed = 0;
+        // run on the calling thread
+        uint64_t inlined = 0;
+        // handed back to the caller
+        uint64_t rejected = 0;
+        // closures in overflow queue now, and the most ever
+        size_t depth = 0;
+        size_t maxDepth = 0;
+    };
+    OverflowStats overflowStats() const;
+
+    /**
+     * @brief Counters of one worker thread
+     */
+    struct WorkerStats
+    {
+        // closures run, and where they were found
+        uint64_t tasks = 0;
+        uint64_t localTasks = 0;
+        uint64_t stolenTasks = 0;
+        uint64_t overflowTasks = 0;
+        // looks into other workers' queues, including while spinning
+        uint64_t stealAttempts = 0;
+        uint64_t spins = 0;
+        // times the worker blocked waiting for work, and woke up again
+        uint64_t parks = 0;
+        uint64_t unparks = 0;
+        // most closures ever seen in the worker's own queues
+        size_t maxQueueDepth = 0;
+    };
+
+    /**
+     * @brief Snapshot of counters of each worker, indexed by logical thread index.
+     * Counters are only collected when built with SALUS_ENABLE_THREADPOOL_STATS,
+     * otherwise this is empty.
+     */
+    std::vector<WorkerStats> workerStats() const;
+
     /**
      * @brief Signal to stop the thread pool, currently running tasks will continue to run.
      */
@@ -146,13 +350,19 @@ public:
     void join();
 
     /**
-     * @returns the number of threads in the pool
+     * @returns the number of threads in the pool. For an elastic pool, the most it may have.
      */
     size_t numThreads() const;
 
+    /**
+     * @returns the number of threads running now, which only differs from numThreads() in an elastic pool
+     */
+    size_t numActiveThreads() const;
+
     /**
      * @returns a logical thread index between 0 and numThreads() - 1 if called
      * from one of the threads in the pool. Returns -1 otherwise.
+     * A retired worker's index is reused by a later worker.
      */
     int currentThreadId() const;
 
@@ -160,4 +370,85 @@ private:
     std::unique_ptr<ThreadPoolPrivate> d;
 };
 
+/**
+ * @brief A group of closures forked to a ThreadPool that can be joined.
+ *
+ * Closures are kept in the group and the pool only gets a small closure that runs
+ * the next one of them. wait() takes closures not started by any worker and runs them
+ * on the calling thread, so a worker waiting on its subtasks helps instead of blocking,
+ * and only waits for those already running elsewhere.
+ */
+class TaskGroup
+{
+    TaskGroup(const TaskGroup &) = delete;
+    TaskGroup &operator=(const TaskGroup &) = delete;
+
+public:
+    explicit TaskGroup(ThreadPool &pool, ThreadPool::Priority priority = ThreadPool::Priority::Normal);
+
+    /**
+     * @brief Waits for all closures in the group
+     */
+    ~TaskGroup();
+
+    /**
+     * @brief Fork c to the pool
+     */
+    void run(ThreadPool::Closure c);
+
+    /**
+     * @brief Run closures of the group until none is left, then wait for those
+     * running on other threads.
+     */
+    void wait();
+
+private:
+    friend class ThreadPool;
+
+    struct State;
+
+    /**
+     * @brief Run the next closure not started yet.
+     * @returns false if there is none
+     */
+    static bool runNext(State &state);
+
+    template<typename Func>
+    void forkRange(size_t begin, size_t end, size_t grain, Func &fn)
+    {
+        while (end - begin > grain) {
+            auto mid = begin + (end - begin) / 2;
+            run([this, &fn, mid, end, grain]() { forkRange(mid, end, grain, fn); });
+            end = mid;
+        }
+        fn(begin, end);
+    }
+
+    ThreadPool &m_pool;
+    ThreadPool::Priority m_priority;
+    std::shared_ptr<State> m_state;
+};
+
+template<typename Func>
+void ThreadPool::parallelFor(size_t begin, size_t end, size_t grain, Func &&fn)
+{
+    // Subranges per running worker, enough for stealing to even out uneven ones
+    constexpr size_t kRangesPerThread = 4;
+
+    if (begin >= end) {
+        return;
+    }
+    const auto size = end - begin;
+    const auto ranges = kRangesPerThread * std::max<size_t>(1, numActiveThreads());
+    grain = std::max({grain, (size + ranges - 1) / ranges, size_t{1}});
+    if (size <= grain) {
+        fn(begin, end);
+        return;
+    }
+
+    TaskGroup group(*this);
+    group.forkRange(begin, end, grain, fn);
+    group.wait();
+}
+
 #endif // EXECUTION_THREADPOOL_H
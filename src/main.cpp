@@ -20,6 +20,8 @@
 #include "utils/macros.h"
 
 #ifdef SALUS_ENABLE_TENSORFLOW
+#include "oplibraries/tensorflow/tensorflow_headers.h"
+#include "oplibraries/tensorflow/tfinstance.h"
 #include "oplibraries/tensorflow/v3/smblocker.h"
 #endif
 
@@ -39,6 +41,7 @@
 #include <regex>
 #include <string>
 #include <unordered_map>
+#include <vector>
 
 using namespace std;
 using namespace std::string_literals;
@@ -232,6 +235,16 @@ void configureSMBlocker(std::map<std::string, docopt::value> &args)
 #endif
 }
 
+std::vector<size_t> discoverGPUs()
+{
+#ifdef SALUS_ENABLE_TENSORFLOW
+    // Creating the instance initializes every usable GPU
+    return salus::oplib::tensorflow::TFInstance::instance().gpuMemoryLimits();
+#else
+    return {};
+#endif
+}
+
 void printConfiguration(std::map<std::string, docopt::value> &)
 {
     LOG(INFO) << "Running build type: " << SALUS_BUILD_TYPE;
@@ -280,7 +293,7 @@ int main(int argc, char **argv)
     ScopedProfiling sp(value_or<bool>(args[flags::gperf], false));
 
     // Start scheduling taskExec
-    salus::ExecutionEngine::instance().startScheduler();
+    salus::ExecutionEngine::instance().startScheduler(discoverGPUs());
 
     // Then start server to accept request
     ZmqServer server;
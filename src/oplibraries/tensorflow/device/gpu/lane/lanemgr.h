@@ -170,6 +170,14 @@ public:
         return m_baseStreamIndex;
     }
 
+    /**
+     * @brief Index of the GPU this lane is on
+     */
+    int gpuIndex() const
+    {
+        return m_gcb.index;
+    }
+
     void removeHold(size_t size, size_t peak)
     {
         auto g = sstl::with_guard(m_mu);
@@ -254,6 +262,11 @@ public:
     {
         return m_lane->baseStreamIndex();
     }
+
+    int gpuIndex() const
+    {
+        return m_lane->gpuIndex();
+    }
 };
 
 } // namespace salus::oplib::tensorflow
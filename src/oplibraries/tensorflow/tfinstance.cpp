@@ -29,8 +29,11 @@
 #include "oplibraries/tensorflow/handlercallback.h"
 #include "oplibraries/tensorflow/tfexception.h"
 #include "oplibraries/tensorflow/tfsession.h"
+#include "oplibraries/tensorflow/v3/smblocker.h"
 #include "utils/macros.h"
 
+#include <algorithm>
+
 namespace salus::oplib::tensorflow {
 
 inline tf::StringPiece svToStringPiece(std::string_view sv)
@@ -74,6 +77,15 @@ TFInstance::DeviceContainer::DeviceContainer()
 
 TFInstance::~TFInstance() = default;
 
+std::vector<size_t> TFInstance::gpuMemoryLimits() const
+{
+    std::vector<size_t> limits;
+    for (auto iGpu = 0_sz; iGpu != m_laneMgr->numGPUs(); ++iGpu) {
+        limits.push_back(m_laneMgr->totalMemoryForGPU(iGpu));
+    }
+    return limits;
+}
+
 void TFInstance::handleCreateSession(std::unique_ptr<tf::CreateSessionRequest> &&req, tf::CreateSessionResponse &resp,
                                      HandlerCallback &&cb)
 {
@@ -141,9 +153,27 @@ void TFInstance::handleCreateSession(std::unique_ptr<tf::CreateSessionRequest> &
     ectx->setExpectedRunningTime(totalRunningTime);
 
     // smaller is higher priority
-    auto priority = static_cast<int>(sstl::getOrDefault(m.persistant(), "SCHED:PRIORITY", 20));
+    constexpr int defaultPriority = 20;
+    auto priority = static_cast<int>(sstl::getOrDefault(m.persistant(), "SCHED:PRIORITY", defaultPriority));
+
+    // scavenger sessions only use idle time, and take SMs last
+    auto scavenger = sstl::getOrDefault(m.persistant(), "SCHED:SCAVENGER", 0.0) > 0;
+    ectx->setScavenger(scavenger);
+    if (scavenger) {
+        priority = SMBlocker::MaxPriority - 1;
+        ectx->setOpPriority(ThreadPool::Priority::Low);
+    } else if (priority < defaultPriority) {
+        // sessions asking for more than default priority are latency sensitive
+        ectx->setOpPriority(ThreadPool::Priority::High);
+    }
+
+    // relative share in fair scheduling, sessions in the same tenant split the weight
+    auto weight = sstl::getOrDefault(m.persistant(), "SCHED:WEIGHT", 1.0);
+    auto tenant = static_cast<uint64_t>(std::round(sstl::getOrDefault(m.persistant(), "SCHED:TENANT", 0.0)));
+    ectx->setSchedulingWeight(weight, tenant);
 
-    LOG(INFO) << "Accept session with priority " << priority;
+    LOG(INFO) << "Accept session with priority " << priority << ", weight " << weight << ", tenant " << tenant
+              << (scavenger ? ", as scavenger" : "");
 
     m_laneMgr->requestLanes(std::move(layout), [&resp, priority,
                                                 cb = std::move(cb), req = std::move(req), ectx = std::move(ectx),
@@ -159,6 +189,18 @@ void TFInstance::handleCreateSession(std::unique_ptr<tf::CreateSessionRequest> &
             devices.emplace_back(lane->as_tfdevice());
         }
 
+#if defined(SALUS_ENABLE_MULTI_DEVICE)
+        // schedule ops against the budget of every GPU the session got lanes on
+        std::vector<DeviceSpec> gpus;
+        for (auto &lane : lanes) {
+            DeviceSpec gpu{DeviceType::GPU, lane->gpuIndex()};
+            if (std::find(gpus.begin(), gpus.end(), gpu) == gpus.end()) {
+                gpus.emplace_back(gpu);
+            }
+        }
+        ectx->setGPUs(std::move(gpus));
+#endif
+
         // NOTE: laneId on ectx is separated from actual lane implementation.
         // It is only used to have separate scheduling domain. So use first lane's id as the id
         // Revisit if later multi-lane for a job is implemented.
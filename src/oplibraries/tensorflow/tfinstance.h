@@ -111,6 +111,11 @@ public:
         return *m_env;
     }
 
+    /**
+     * @brief Usable memory of each GPU the lane manager found, in the order of GPU indices
+     */
+    std::vector<size_t> gpuMemoryLimits() const;
+
     /**
      * @brief find session
      */
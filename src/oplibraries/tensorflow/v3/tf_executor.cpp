@@ -2100,7 +2100,8 @@ void ExecutorState::Finish()
                });
     if (impl_->is_main_iter) {
         impl_->params_.ins->dropExlusiveMode();
-        ictx_->finish();
+        const bool canceled = cancellation_manager_ && cancellation_manager_->IsCancelled();
+        ictx_->finish(status.ok() && !canceled);
     }
 
     delete this;
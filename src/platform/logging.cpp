@@ -128,6 +128,11 @@ void initialize(const Params &params)
     }
 }
 
+bool perfLogEnabled()
+{
+    return el::Loggers::getLogger(logging::kPerfTag)->typedConfigurations()->enabled(el::Level::Info);
+}
+
 } // namespace logging
 
 MAKE_LOGGABLE(std::exception_ptr, ep, os)
@@ -129,6 +129,11 @@ struct Params
 };
 void initialize(const Params &params);
 
+/**
+ * @brief Whether the performance logger writes anything, i.e. `--perflog` is given
+ */
+bool perfLogEnabled();
+
 } // namespace logging
 
 #define LogPerf() CLOG(TRACE, logging::kPerfTag)
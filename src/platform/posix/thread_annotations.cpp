@@ -18,12 +18,44 @@
  */
 #include "platform/thread_annotations.h"
 
+#include <dirent.h>
 #include <pthread.h>
+#include <sched.h>
 
+#include <algorithm>
+#include <cstdlib>
+#include <fstream>
 #include <string>
 
 namespace salus::threading {
 
+std::vector<int> parse_cpu_list(const std::string &list)
+{
+    std::vector<int> cpus;
+    size_t pos = 0;
+    while (pos < list.size()) {
+        auto end = list.find(',', pos);
+        if (end == std::string::npos) {
+            end = list.size();
+        }
+        auto range = list.substr(pos, end - pos);
+        auto dash = range.find('-');
+        char *rest = nullptr;
+        auto first = std::strtol(range.c_str(), &rest, 10);
+        auto last = first;
+        if (rest != range.c_str()) {
+            if (dash != std::string::npos) {
+                last = std::strtol(range.c_str() + dash + 1, nullptr, 10);
+            }
+            for (auto cpu = first; cpu <= last; ++cpu) {
+                cpus.push_back(static_cast<int>(cpu));
+            }
+        }
+        pos = end + 1;
+    }
+    return cpus;
+}
+
 void set_thread_name(std::string_view name)
 {
 #if defined(__GLIBC__)
@@ -37,4 +69,59 @@ void set_thread_name(std::string_view name)
 #endif
 }
 
+bool set_thread_affinity(const std::vector<int> &cpus)
+{
+#if defined(__GLIBC__)
+    if (cpus.empty()) {
+        return false;
+    }
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    for (auto cpu : cpus) {
+        if (cpu >= 0 && cpu < CPU_SETSIZE) {
+            CPU_SET(cpu, &set);
+        }
+    }
+    return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+#else
+    // Not supported, e.g. macOS only has affinity hints
+    (void) cpus;
+    return false;
+#endif
+}
+
+std::vector<std::vector<int>> numa_nodes(const std::string &nodeDir)
+{
+    std::vector<std::pair<int, std::vector<int>>> found;
+    auto dir = opendir(nodeDir.c_str());
+    if (!dir) {
+        return {};
+    }
+    while (auto entry = readdir(dir)) {
+        std::string name(entry->d_name);
+        if (name.compare(0, 4, "node") != 0 || name.size() == 4
+            || !std::all_of(name.begin() + 4, name.end(), [](char c) { return c >= '0' && c <= '9'; })) {
+            continue;
+        }
+        std::ifstream file(nodeDir + "/" + name + "/cpulist");
+        std::string list;
+        if (!std::getline(file, list)) {
+            continue;
+        }
+        auto cpus = parse_cpu_list(list);
+        if (!cpus.empty()) {
+            found.emplace_back(std::stoi(name.substr(4)), std::move(cpus));
+        }
+    }
+    closedir(dir);
+
+    std::sort(found.begin(), found.end());
+    std::vector<std::vector<int>> nodes;
+    nodes.reserve(found.size());
+    for (auto &[id, cpus] : found) {
+        nodes.emplace_back(std::move(cpus));
+    }
+    return nodes;
+}
+
 } // namespace salus::threading
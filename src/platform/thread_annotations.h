@@ -155,11 +155,30 @@ inline T &ts_unchecked_read(T &v) NO_THREAD_SAFETY_ANALYSIS
 }
 } // namespace salus::thread_safety_analysis
 
+#include <string>
 #include <string_view>
+#include <vector>
 namespace salus::threading {
 
 void set_thread_name(std::string_view name);
 
+/**
+ * @brief Pin the calling thread to the given CPUs.
+ * @returns false if pinning is not supported or failed
+ */
+bool set_thread_affinity(const std::vector<int> &cpus);
+
+/**
+ * @brief Parse a cpulist like "0-3,8-11", as found in sysfs. Malformed ranges are skipped.
+ */
+std::vector<int> parse_cpu_list(const std::string &list);
+
+/**
+ * @brief CPUs of each NUMA node, ordered by node id, read from the nodeN/cpulist files in nodeDir.
+ * Nodes without CPUs are skipped. Empty if the topology is not available.
+ */
+std::vector<std::vector<int>> numa_nodes(const std::string &nodeDir = "/sys/devices/system/node");
+
 } // namespace salus::threading
 
 #endif // SALUS_PLATFORM_THREAD_ANNOTATIONS_H_
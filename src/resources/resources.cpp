@@ -105,24 +105,24 @@ std::string ResourceMonitor::DebugString() const
     std::ostringstream oss;
     oss << "ResourceMonitor: dumping available resources" << std::endl;
 
-    auto g = sstl::with_guard(m_mu);
+    auto g = guard();
 
     oss << "    Available:" << std::endl;
-    oss << resources::DebugString(m_limits, "        ");
+    oss << resources::DebugString(m_limits.toResources(), "        ");
 
     oss << "    Staging " << m_staging.size() << " tickets, in total:" << std::endl;
-    Resources total;
-    for (auto p : m_staging) {
+    DenseResources total;
+    for (auto &p : m_staging) {
         resources::merge(total, p.second);
     }
-    oss << resources::DebugString(total, "       ");
+    oss << resources::DebugString(total.toResources(), "       ");
 
     oss << "    In use " << m_using.size() << " tickets, in total:" << std::endl;
-    total.clear();
-    for (auto p : m_using) {
+    total = {};
+    for (auto &p : m_using) {
         resources::merge(total, p.second);
     }
-    oss << resources::DebugString(total, "       ");
+    oss << resources::DebugString(total.toResources(), "       ");
 
     return oss.str();
 }
@@ -229,24 +229,257 @@ std::string DebugString(const Resources &res, const std::string &indent)
     return oss.str();
 }
 
-Resources platformLimits()
+Resources platformLimits(const std::vector<size_t> &gpuMemory)
 {
     Resources res;
     res[{ResourceType::MEMORY, devices::CPU0}] = 100_sz * 1024 * 1024 * 1024;
 
-    // 14 G for GPU 0
-    res[{ResourceType::MEMORY, devices::GPU0}] = 14_sz * 1024 * 1024 * 1024;
+    // GPUs past what the scheduler tracks are never placed on
+    if (gpuMemory.size() > static_cast<size_t>(devices::kNumScheduledGPUs)) {
+        LOG(WARNING) << "Found " << gpuMemory.size() << " GPUs, only scheduling on the first "
+                     << devices::kNumScheduledGPUs;
+    }
+    const auto numGPUs = std::min(gpuMemory.size(), static_cast<size_t>(devices::kNumScheduledGPUs));
+
+    for (size_t i = 0; i != numGPUs; ++i) {
+        const DeviceSpec gpu{DeviceType::GPU, static_cast<int>(i)};
+
+        res[{ResourceType::MEMORY, gpu}] = gpuMemory[i];
 
-    // 128 streams for GPU 0
-    res[{ResourceType::GPU_STREAM, devices::GPU0}] = 128;
+        // 128 streams for each GPU
+        res[{ResourceType::GPU_STREAM, gpu}] = 128;
 
-    res[{ResourceType::EXCLUSIVE, devices::GPU0}] = 1;
+        res[{ResourceType::EXCLUSIVE, gpu}] = 1;
+    }
 
     return res;
 }
 
+// Memory assumed for GPUs whose size is not discovered
+const size_t kDefaultGPUMemory = 14_sz * 1024 * 1024 * 1024;
+
+Resources platformLimits()
+{
+    // Without discovered devices, assume a single GPU
+    return platformLimits({kDefaultGPUMemory});
+}
+
 } // namespace resources
 
+namespace {
+// Fixed slots: every known type on CPU0 and on GPU 0 .. kMaxGPUs-1
+constexpr size_t kNumFixedTypes = 4;
+constexpr size_t kDevicesPerType = 1 + devices::kMaxGPUs;
+constexpr size_t kNumFixedSlots = kNumFixedTypes * kDevicesPerType;
+static_assert(kNumFixedSlots <= DenseResources::kMaxSlots, "Too many fixed resource slots");
+
+std::optional<size_t> fixedSlotOf(const ResourceTag &tag)
+{
+    auto type = static_cast<size_t>(tag.type);
+    if (type >= kNumFixedTypes) {
+        return {};
+    }
+    if (tag.device.type == DeviceType::CPU && tag.device.id == 0) {
+        return type * kDevicesPerType;
+    }
+    if (tag.device.type == DeviceType::GPU && tag.device.id >= 0 && tag.device.id < devices::kMaxGPUs) {
+        return type * kDevicesPerType + 1 + static_cast<size_t>(tag.device.id);
+    }
+    return {};
+}
+
+/**
+ * @brief Tags interned beyond the fixed slots. Entries are never removed, and are published
+ * through `count` so lookups of already interned tags don't need the lock.
+ */
+struct SlotTable
+{
+    std::mutex mu;
+    std::array<ResourceTag, DenseResources::kMaxSlots - kNumFixedSlots> tags;
+    std::atomic<size_t> count{0};
+
+    std::optional<size_t> find(const ResourceTag &tag, size_t begin, size_t end) const
+    {
+        for (auto i = begin; i != end; ++i) {
+            if (tags[i] == tag) {
+                return kNumFixedSlots + i;
+            }
+        }
+        return {};
+    }
+};
+
+SlotTable &slotTable()
+{
+    static SlotTable table;
+    return table;
+}
+
+template<typename Fn>
+void forEachSlot(DenseResources::Mask mask, Fn &&fn)
+{
+    while (mask) {
+        auto slot = static_cast<size_t>(__builtin_ctz(mask));
+        fn(slot);
+        mask &= mask - 1;
+    }
+}
+
+} // namespace
+
+/*static*/ std::optional<size_t> DenseResources::findSlot(const ResourceTag &tag)
+{
+    if (auto slot = fixedSlotOf(tag)) {
+        return slot;
+    }
+    auto &table = slotTable();
+    return table.find(tag, 0, table.count.load(std::memory_order_acquire));
+}
+
+/*static*/ size_t DenseResources::slotOf(const ResourceTag &tag)
+{
+    if (auto slot = fixedSlotOf(tag)) {
+        return *slot;
+    }
+
+    auto &table = slotTable();
+    auto published = table.count.load(std::memory_order_acquire);
+    if (auto slot = table.find(tag, 0, published)) {
+        return *slot;
+    }
+
+    auto g = sstl::with_guard(table.mu);
+    auto count = table.count.load(std::memory_order_relaxed);
+    if (auto slot = table.find(tag, published, count)) {
+        return *slot;
+    }
+    CHECK_LT(count, table.tags.size()) << "Out of dense resource slots interning " << tag.DebugString();
+    table.tags[count] = tag;
+    table.count.store(count + 1, std::memory_order_release);
+    return kNumFixedSlots + count;
+}
+
+/*static*/ ResourceTag DenseResources::tagOf(size_t slot)
+{
+    if (slot < kNumFixedSlots) {
+        auto type = static_cast<ResourceType>(slot / kDevicesPerType);
+        auto dev = slot % kDevicesPerType;
+        if (dev == 0) {
+            return {type, devices::CPU0};
+        }
+        return {type, DeviceSpec{DeviceType::GPU, static_cast<int>(dev - 1)}};
+    }
+    DCHECK_LT(slot - kNumFixedSlots, slotTable().count.load(std::memory_order_acquire));
+    return slotTable().tags[slot - kNumFixedSlots];
+}
+
+DenseResources::DenseResources(const Resources &res)
+{
+    for (auto [tag, val] : res) {
+        auto slot = slotOf(tag);
+        m_present |= Mask{1} << slot;
+        m_values[slot] = val;
+    }
+}
+
+Resources DenseResources::toResources() const
+{
+    Resources res;
+    res.reserve(static_cast<size_t>(__builtin_popcount(m_present)));
+    forEachSlot(m_present, [&](auto slot) {
+        res.emplace(tagOf(slot), m_values[slot]);
+    });
+    return res;
+}
+
+bool DenseResources::has(const ResourceTag &tag) const
+{
+    // A tag never interned can't be present, so don't intern it just to look
+    auto slot = findSlot(tag);
+    return slot && (m_present & (Mask{1} << *slot));
+}
+
+size_t DenseResources::get(const ResourceTag &tag) const
+{
+    auto slot = findSlot(tag);
+    return slot ? m_values[*slot] : 0;
+}
+
+void DenseResources::set(const ResourceTag &tag, size_t val)
+{
+    auto slot = slotOf(tag);
+    m_present |= Mask{1} << slot;
+    m_values[slot] = val;
+}
+
+// Absent slots hold 0, so the loops below only need to visit slots present on the side that
+// contributes anything. Ops touch a handful of tags, which makes that much cheaper than running
+// over all slots: there is no 64-bit unsigned min or compare to vectorize with below AVX-512.
+
+bool DenseResources::contains(const DenseResources &req) const noexcept
+{
+    bool ok = true;
+    forEachSlot(req.m_present, [&](auto slot) {
+        ok &= req.m_values[slot] <= m_values[slot];
+    });
+    return ok;
+}
+
+bool DenseResources::compatible(const DenseResources &rhs) const noexcept
+{
+    return (rhs.m_present & ~m_present) == 0;
+}
+
+DenseResources &DenseResources::removeInvalid() noexcept
+{
+    forEachSlot(m_present, [&](auto slot) {
+        if (m_values[slot] == 0) {
+            m_present &= ~(Mask{1} << slot);
+        }
+    });
+    return *this;
+}
+
+DenseResources &DenseResources::merge(const DenseResources &rhs, bool skipNonExist) noexcept
+{
+    const Mask mask = rhs.m_present & (skipNonExist ? m_present : ~Mask{0});
+    forEachSlot(mask, [&](auto slot) {
+        m_values[slot] += rhs.m_values[slot];
+    });
+    m_present |= mask;
+    return *this;
+}
+
+DenseResources &DenseResources::subtract(const DenseResources &rhs, bool skipNonExist) noexcept
+{
+    const Mask mask = rhs.m_present & (skipNonExist ? m_present : ~Mask{0});
+    forEachSlot(mask, [&](auto slot) {
+        m_values[slot] -= rhs.m_values[slot];
+    });
+    m_present |= mask;
+    return *this;
+}
+
+DenseResources DenseResources::subtractBounded(const DenseResources &rhs) noexcept
+{
+    DenseResources res;
+    res.m_present = m_present & rhs.m_present;
+    forEachSlot(res.m_present, [&](auto slot) {
+        auto v = std::min(rhs.m_values[slot], m_values[slot]);
+        m_values[slot] -= v;
+        res.m_values[slot] = v;
+    });
+    return res;
+}
+
+DenseResources &DenseResources::scale(double scale) noexcept
+{
+    forEachSlot(m_present, [&](auto slot) {
+        m_values[slot] *= scale;
+    });
+    return *this;
+}
+
 using namespace resources;
 
 // Read limits from hardware, and capped by cap
@@ -344,40 +577,74 @@ std::string AllocationRegulator::DebugString() const
 
 void ResourceMonitor::initializeLimits()
 {
-    auto g = sstl::with_guard(m_mu);
+    auto g = guard();
 
-    m_limits = resources::platformLimits();
+    m_limits = DenseResources(resources::platformLimits());
 }
 
-void ResourceMonitor::initializeLimits(const Resources &cap)
+void ResourceMonitor::initializeLimitsForGPUs(const std::vector<size_t> &gpuMemory)
 {
-    initializeLimits();
+    auto g = guard();
 
-    auto g = sstl::with_guard(m_mu);
+    m_limits = DenseResources(resources::platformLimits(gpuMemory));
+}
 
-    auto lend = m_limits.end();
+void ResourceMonitor::initializeLimits(const Resources &cap)
+{
+    // GPUs the cap has memory for are taken as present, besides the default one
+    std::vector<size_t> gpuMemory{resources::kDefaultGPUMemory};
+    for (const auto &[tag, val] : cap) {
+        UNUSED(val);
+        if (tag.type != ResourceType::MEMORY || tag.device.type != DeviceType::GPU || tag.device.id < 0) {
+            continue;
+        }
+        if (static_cast<size_t>(tag.device.id) >= gpuMemory.size()) {
+            gpuMemory.resize(tag.device.id + 1, resources::kDefaultGPUMemory);
+        }
+    }
+    initializeLimitsForGPUs(gpuMemory);
 
-    ResourceTag tag{};
-    size_t val;
-    for (auto p : cap) {
-        std::tie(tag, val) = p;
-        auto it = m_limits.find(tag);
-        if (it != lend) {
-            it->second = std::min(it->second, val);
+    auto g = guard();
+
+    for (auto [tag, val] : cap) {
+        if (m_limits.has(tag)) {
+            m_limits.set(tag, std::min(m_limits.get(tag), val));
         }
     }
 }
 
 std::optional<uint64_t> ResourceMonitor::preAllocate(const Resources &req, Resources *missing)
+{
+    return preAllocate(DenseResources(req), missing);
+}
+
+std::optional<uint64_t> ResourceMonitor::preAllocate(const DenseResources &req, Resources *missing)
+{
+    auto g = guard();
+    return preAllocateUnsafe(req, missing);
+}
+
+std::optional<uint64_t> ResourceMonitor::LockedProxy::preAllocate(const Resources &req, Resources *missing)
+{
+    return preAllocate(DenseResources(req), missing);
+}
+
+std::optional<uint64_t> ResourceMonitor::LockedProxy::preAllocate(const DenseResources &req, Resources *missing)
+{
+    assert(m_resMonitor);
+    return m_resMonitor->preAllocateUnsafe(req, missing);
+}
+
+std::optional<uint64_t> ResourceMonitor::preAllocateUnsafe(const DenseResources &req, Resources *missing)
 {
     // TODO: check ticket
 
-    auto g = sstl::with_guard(m_mu);
     if (!contains(m_limits, req)) {
         if (missing) {
-            *missing = req;
-            subtract(*missing, m_limits, true /* skipNonExist */);
-            removeInvalid(*missing);
+            auto lacking(req);
+            subtract(lacking, m_limits, true /* skipNonExist */);
+            removeInvalid(lacking);
+            *missing = lacking.toResources();
         }
         return {};
     }
@@ -392,17 +659,27 @@ std::optional<uint64_t> ResourceMonitor::preAllocate(const Resources &req, Resou
 }
 
 bool ResourceMonitor::allocate(uint64_t ticket, const Resources &res)
+{
+    return allocate(ticket, DenseResources(res));
+}
+
+bool ResourceMonitor::allocate(uint64_t ticket, const DenseResources &res)
 {
     if (ticket == 0) {
         LOG(ERROR) << "Invalid ticket 0";
         return false;
     }
 
-    auto g = sstl::with_uguard(m_mu);
+    auto g = guard();
     return allocateUnsafe(ticket, res);
 }
 
 bool ResourceMonitor::LockedProxy::allocate(uint64_t ticket, const Resources &res)
+{
+    return allocate(ticket, DenseResources(res));
+}
+
+bool ResourceMonitor::LockedProxy::allocate(uint64_t ticket, const DenseResources &res)
 {
     assert(m_resMonitor);
     if (ticket == 0) {
@@ -413,7 +690,7 @@ bool ResourceMonitor::LockedProxy::allocate(uint64_t ticket, const Resources &re
     return m_resMonitor->allocateUnsafe(ticket, res);
 }
 
-bool ResourceMonitor::allocateUnsafe(uint64_t ticket, const Resources &res)
+bool ResourceMonitor::allocateUnsafe(uint64_t ticket, const DenseResources &res)
 {
     auto remaining(res);
     auto it = m_staging.find(ticket);
@@ -422,6 +699,7 @@ bool ResourceMonitor::allocateUnsafe(uint64_t ticket, const Resources &res)
         if (contains(it->second, remaining)) {
             subtract(it->second, remaining);
             merge(m_using[ticket], remaining);
+            touchUnsafe(ticket);
             return true;
         }
 
@@ -451,10 +729,16 @@ bool ResourceMonitor::allocateUnsafe(uint64_t ticket, const Resources &res)
 
     // add to used
     merge(m_using[ticket], res);
+    touchUnsafe(ticket);
 
     return true;
 }
 
+void ResourceMonitor::touchUnsafe(uint64_t ticket)
+{
+    m_lastUsed[ticket] = std::chrono::steady_clock::now();
+}
+
 // Release remaining pre-allocated resources
 void ResourceMonitor::freeStaging(uint64_t ticket)
 {
@@ -463,7 +747,7 @@ void ResourceMonitor::freeStaging(uint64_t ticket)
         return;
     }
 
-    auto g = sstl::with_uguard(m_mu);
+    auto g = guard();
 
     auto it = m_staging.find(ticket);
     if (it == m_staging.end()) {
@@ -474,33 +758,45 @@ void ResourceMonitor::freeStaging(uint64_t ticket)
 
     merge(m_limits, it->second);
     m_staging.erase(it);
+    m_releaseEpoch.fetch_add(1, std::memory_order_release);
 }
 
 bool ResourceMonitor::free(uint64_t ticket, const Resources &res)
 {
-    auto g = sstl::with_guard(m_mu);
+    return free(ticket, DenseResources(res));
+}
+
+bool ResourceMonitor::free(uint64_t ticket, const DenseResources &res)
+{
+    auto g = guard();
     return freeUnsafe(ticket, res);
 }
 
 bool ResourceMonitor::LockedProxy::free(uint64_t ticket, const Resources &res)
+{
+    return free(ticket, DenseResources(res));
+}
+
+bool ResourceMonitor::LockedProxy::free(uint64_t ticket, const DenseResources &res)
 {
     assert(m_resMonitor);
     return m_resMonitor->freeUnsafe(ticket, res);
 }
 
-std::optional<Resources> ResourceMonitor::LockedProxy::queryStaging(uint64_t ticket) const
+std::optional<DenseResources> ResourceMonitor::LockedProxy::queryStaging(uint64_t ticket) const
 {
     DCHECK(m_resMonitor);
     return m_resMonitor->queryStagingUnsafe(ticket);
 }
 
-bool ResourceMonitor::freeUnsafe(uint64_t ticket, const Resources &res)
+bool ResourceMonitor::freeUnsafe(uint64_t ticket, const DenseResources &res)
 {
     // Ticket can not be 0 when free actual resource to prevent
     // monitor go out of sync of physical usage.
     DCHECK_NE(ticket, 0);
 
     merge(m_limits, res);
+    m_releaseEpoch.fetch_add(1, std::memory_order_release);
 
     auto it = m_using.find(ticket);
     DCHECK_NE(it, m_using.end());
@@ -511,66 +807,93 @@ bool ResourceMonitor::freeUnsafe(uint64_t ticket, const Resources &res)
     removeInvalid(it->second);
     if (it->second.empty()) {
         m_using.erase(it);
+        m_lastUsed.erase(ticket);
         return true;
     }
+    touchUnsafe(ticket);
     return false;
 }
 
-std::optional<Resources> ResourceMonitor::queryStagingUnsafe(uint64_t ticket) const
+std::optional<DenseResources> ResourceMonitor::queryStagingUnsafe(uint64_t ticket) const
 {
     DCHECK_NE(ticket, 0);
-    return sstl::optionalGet(m_staging, ticket);
+    auto it = m_staging.find(ticket);
+    if (it == m_staging.end()) {
+        return {};
+    }
+    return it->second;
 }
 
 std::vector<std::pair<size_t, uint64_t>> ResourceMonitor::sortVictim(
-    const std::unordered_set<uint64_t> &candidates) const
+    const std::unordered_set<uint64_t> &candidates, const DeviceSpec &dev) const
 {
     assert(!candidates.empty());
 
-    std::vector<std::pair<size_t, uint64_t>> usages;
-    usages.reserve(candidates.size());
+    // cold bytes: usage weighted by seconds since last use, with a small floor so size still
+    // breaks ties among tickets just used.
+    constexpr double minAge = 1e-3;
+    std::vector<std::tuple<double, size_t, uint64_t>> scored;
+    scored.reserve(candidates.size());
 
-    // TODO: currently only select based on GPU memory usage, generalize to all resources
-    ResourceTag tag{ResourceType::MEMORY, devices::GPU0};
+    // TODO: currently only select based on memory usage, generalize to all resources
+    const ResourceTag tag{ResourceType::MEMORY, dev};
     {
-        auto g = sstl::with_guard(m_mu);
+        auto now = std::chrono::steady_clock::now();
+        auto g = guard();
         for (auto &ticket : candidates) {
-            auto usagemap = sstl::optionalGet(m_using, ticket);
-            if (!usagemap) {
+            auto it = m_using.find(ticket);
+            if (it == m_using.end()) {
                 continue;
             }
-            auto gpuusage = sstl::optionalGet(usagemap, tag);
-            if (!gpuusage || *gpuusage == 0) {
+            auto gpuusage = it->second.get(tag);
+            if (gpuusage == 0) {
                 continue;
             }
-            usages.emplace_back(*gpuusage, ticket);
+            auto age = minAge;
+            if (auto last = sstl::optionalGet(m_lastUsed, ticket)) {
+                age += std::chrono::duration<double>(now - *last).count();
+            }
+            scored.emplace_back(gpuusage * age, gpuusage, ticket);
         }
     }
 
-    std::sort(usages.begin(), usages.end(), [](const auto &lhs, const auto &rhs) {
+    std::sort(scored.begin(), scored.end(), [](const auto &lhs, const auto &rhs) {
         return lhs > rhs;
     });
+
+    std::vector<std::pair<size_t, uint64_t>> usages;
+    usages.reserve(scored.size());
+    for (auto &[score, usage, ticket] : scored) {
+        UNUSED(score);
+        usages.emplace_back(usage, ticket);
+    }
     return usages;
 }
 
 Resources ResourceMonitor::queryUsages(const std::unordered_set<uint64_t> &tickets) const
 {
-    auto g = sstl::with_guard(m_mu);
-    Resources res;
+    auto g = guard();
+    DenseResources res;
     for (auto t : tickets) {
-        merge(res, sstl::getOrDefault(m_using, t, {}));
+        if (auto it = m_using.find(t); it != m_using.end()) {
+            merge(res, it->second);
+        }
     }
-    return res;
+    return res.toResources();
 }
 
 optional<Resources> ResourceMonitor::queryUsage(uint64_t ticket) const
 {
-    auto g = sstl::with_guard(m_mu);
-    return sstl::optionalGet(m_using, ticket);
+    auto g = guard();
+    auto it = m_using.find(ticket);
+    if (it == m_using.end()) {
+        return {};
+    }
+    return it->second.toResources();
 }
 
 bool ResourceMonitor::hasUsage(uint64_t ticket) const
 {
-    auto g = sstl::with_guard(m_mu);
+    auto g = guard();
     return m_using.count(ticket) > 0;
 }
@@ -26,6 +26,9 @@
 #include "utils/threadutils.h"
 #include "platform/thread_annotations.h"
 
+#include <array>
+#include <atomic>
+#include <chrono>
 #include <list>
 #include <mutex>
 #include <unordered_map>
@@ -169,6 +172,117 @@ inline std::ostream& operator<<(std::ostream& out, const Resources& res)
     return out << resources::DebugString(res);
 }
 
+/**
+ * @brief Fixed-slot form of Resources for hot-path bookkeeping.
+ *
+ * Every ResourceTag is interned into a small slot index, so arithmetic and comparison visit only
+ * the present slots of a contiguous array instead of doing hash lookups. A presence mask keeps the map
+ * semantics of an absent tag versus a zero amount; absent slots always hold 0. Convert to and
+ * from Resources only at API boundaries.
+ */
+class DenseResources
+{
+public:
+    static constexpr size_t kMaxSlots = 32;
+    using Mask = uint32_t;
+
+    DenseResources() noexcept = default;
+    explicit DenseResources(const Resources &res);
+
+    Resources toResources() const;
+
+    bool empty() const noexcept
+    {
+        return m_present == 0;
+    }
+
+    /**
+     * @brief Whether 'tag' is present. Lookups never intern 'tag'.
+     */
+    bool has(const ResourceTag &tag) const;
+
+    /**
+     * @brief Amount of 'tag', or 0 if absent. Lookups never intern 'tag'.
+     */
+    size_t get(const ResourceTag &tag) const;
+
+    void set(const ResourceTag &tag, size_t val);
+
+    bool contains(const DenseResources &req) const noexcept;
+    bool compatible(const DenseResources &rhs) const noexcept;
+    DenseResources &removeInvalid() noexcept;
+    DenseResources &merge(const DenseResources &rhs, bool skipNonExist = false) noexcept;
+    DenseResources &subtract(const DenseResources &rhs, bool skipNonExist = false) noexcept;
+    DenseResources subtractBounded(const DenseResources &rhs) noexcept;
+    DenseResources &scale(double scale) noexcept;
+
+    /**
+     * @brief Calls fn(tag, value) for each present tag
+     */
+    template<typename Fn>
+    void forEach(Fn &&fn) const
+    {
+        for (auto mask = m_present; mask; mask &= mask - 1) {
+            auto slot = static_cast<size_t>(__builtin_ctz(mask));
+            fn(tagOf(slot), m_values[slot]);
+        }
+    }
+
+    /**
+     * @brief Slot index of 'tag', interning it on first use.
+     *
+     * Known resource types on CPU0 and GPUs below kMaxGPUs map to fixed slots without locking,
+     * anything else is appended to a small global table.
+     */
+    static size_t slotOf(const ResourceTag &tag);
+    /**
+     * @brief Slot index of 'tag' if it already has one, never interning it
+     */
+    static std::optional<size_t> findSlot(const ResourceTag &tag);
+    static ResourceTag tagOf(size_t slot);
+
+private:
+    Mask m_present = 0;
+    std::array<size_t, kMaxSlots> m_values{};
+};
+
+namespace resources {
+inline bool contains(const DenseResources &avail, const DenseResources &req)
+{
+    return avail.contains(req);
+}
+
+inline bool compatible(const DenseResources &lhs, const DenseResources &rhs)
+{
+    return lhs.compatible(rhs);
+}
+
+inline DenseResources &removeInvalid(DenseResources &lhs)
+{
+    return lhs.removeInvalid();
+}
+
+inline DenseResources &merge(DenseResources &lhs, const DenseResources &rhs, bool skipNonExist = false)
+{
+    return lhs.merge(rhs, skipNonExist);
+}
+
+inline DenseResources &subtract(DenseResources &lhs, const DenseResources &rhs, bool skipNonExist = false)
+{
+    return lhs.subtract(rhs, skipNonExist);
+}
+
+inline DenseResources subtractBounded(DenseResources &lhs, const DenseResources &rhs)
+{
+    return lhs.subtractBounded(rhs);
+}
+
+inline DenseResources &scale(DenseResources &lhs, double scale)
+{
+    return lhs.scale(scale);
+}
+} // namespace resources
+
 struct ResStats
 {
     /**
@@ -295,7 +409,12 @@ public:
      */
     void initializeLimits();
     /**
-     * @brief Read limits from hardware, and capped by cap
+     * @brief Set limits for CPU0 and the discovered GPUs, one entry of usable memory per GPU.
+     * GPUs beyond kNumScheduledGPUs are left out.
+     */
+    void initializeLimitsForGPUs(const std::vector<size_t> &gpuMemory);
+    /**
+     * @brief Read limits from hardware, and capped by cap. GPUs `cap` has memory for are taken as present.
      */
     void initializeLimits(const Resources &cap);
 
@@ -308,10 +427,12 @@ public:
      * @return An ticket when the pre-allocation succeed, otherwise empty.
      */
     std::optional<uint64_t> preAllocate(const Resources &req, Resources *missing);
+    std::optional<uint64_t> preAllocate(const DenseResources &req, Resources *missing);
 
     // Allocate resources from pre-allocated resources, if res < reserved, gauranteed to succeed
     // otherwise may return false
     bool allocate(uint64_t ticket, const Resources &res);
+    bool allocate(uint64_t ticket, const DenseResources &res);
 
     /**
      * @brief Releases remaining pre-allocated resources from ticket `ticket`.
@@ -323,21 +444,51 @@ public:
      * @returns true if the ticket holds no more resources.
      */
     bool free(uint64_t ticket, const Resources &res);
+    bool free(uint64_t ticket, const DenseResources &res);
 
-    std::vector<std::pair<size_t, uint64_t>> sortVictim(const std::unordered_set<uint64_t> &candidates) const;
+    /**
+     * @brief Order tickets for paging, the best victim first.
+     *
+     * A ticket is a better victim if it holds more memory on `dev` and was last allocated from
+     * or freed to longer ago, thus less likely to be reused soon. Tickets holding no memory on `dev` are skipped.
+     * Candidates all belong to one session, whose iteration duration model can't tell its tickets apart,
+     * so recency stands in for predicted reuse here.
+     *
+     * @returns pairs of memory usage on `dev` and ticket
+     */
+    std::vector<std::pair<size_t, uint64_t>> sortVictim(const std::unordered_set<uint64_t> &candidates,
+                                                        const salus::DeviceSpec &dev) const;
 
     Resources queryUsages(const std::unordered_set<uint64_t> &tickets) const;
 
     std::optional<Resources> queryUsage(uint64_t ticket) const;
     bool hasUsage(uint64_t ticket) const;
 
+    /**
+     * @brief Counter bumped every time resources are returned to the monitor.
+     *
+     * Comparing two readings tells whether anything was freed in between.
+     */
+    uint64_t releaseEpoch() const
+    {
+        return m_releaseEpoch.load(std::memory_order_acquire);
+    }
+
+    /**
+     * @brief Number of times the monitor's lock has been taken, including by LockedProxy
+     */
+    uint64_t lockAcquisitions() const
+    {
+        return m_lockAcquisitions.load(std::memory_order_relaxed);
+    }
+
     struct LockedProxy
     {
         SALUS_DISALLOW_COPY_AND_ASSIGN(LockedProxy);
 
         explicit LockedProxy(sstl::not_null<ResourceMonitor*> resMon)
             : m_resMonitor(resMon)
-            , m_ug(sstl::with_uguard(m_resMonitor->m_mu))
+            , m_ug(m_resMonitor->guard())
         {
         }
 
@@ -361,9 +512,22 @@ public:
             release();
         }
 
+        std::optional<uint64_t> preAllocate(const Resources &req, Resources *missing);
+        std::optional<uint64_t> preAllocate(const DenseResources &req, Resources *missing);
         bool allocate(uint64_t ticket, const Resources &res);
+        bool allocate(uint64_t ticket, const DenseResources &res);
+        Resources available() const
+        {
+            return denseAvailable().toResources();
+        }
+        const DenseResources &denseAvailable() const
+        {
+            assert(m_resMonitor);
+            return m_resMonitor->m_limits;
+        }
         bool free(uint64_t ticket, const Resources &res);
-        std::optional<Resources> queryStaging(uint64_t ticket) const;
+        bool free(uint64_t ticket, const DenseResources &res);
+        std::optional<DenseResources> queryStaging(uint64_t ticket) const;
 
     private:
         void release()
@@ -388,9 +552,18 @@ public:
     std::string DebugString() const;
 
 private:
-    bool allocateUnsafe(uint64_t ticket, const Resources &res);
-    bool freeUnsafe(uint64_t ticket, const Resources &res);
-    std::optional<Resources> queryStagingUnsafe(uint64_t ticket) const;
+    sstl::detail::UGuard guard() const
+    {
+        auto g = sstl::with_uguard(m_mu);
+        m_lockAcquisitions.fetch_add(1, std::memory_order_relaxed);
+        return g;
+    }
+
+    std::optional<uint64_t> preAllocateUnsafe(const DenseResources &req, Resources *missing);
+    void touchUnsafe(uint64_t ticket);
+    bool allocateUnsafe(uint64_t ticket, const DenseResources &res);
+    bool freeUnsafe(uint64_t ticket, const DenseResources &res);
+    std::optional<DenseResources> queryStagingUnsafe(uint64_t ticket) const;
 
     mutable std::mutex m_mu;
 
@@ -400,17 +573,26 @@ private:
     /**
      * @brief Available resources
      */
-    Resources m_limits;
+    DenseResources m_limits;
 
     /**
      * @brief Staging resources
      */
-    std::unordered_map<uint64_t, Resources> m_staging;
+    std::unordered_map<uint64_t, DenseResources> m_staging;
 
     /**
      * @brief In-use resources
      */
-    std::unordered_map<uint64_t, Resources> m_using;
+    std::unordered_map<uint64_t, DenseResources> m_using;
+
+    /**
+     * @brief Last time each in-use ticket allocated or freed anything
+     */
+    std::unordered_map<uint64_t, std::chrono::steady_clock::time_point> m_lastUsed GUARDED_BY(m_mu);
+
+    std::atomic_uint_fast64_t m_releaseEpoch{0};
+
+    mutable std::atomic_uint_fast64_t m_lockAcquisitions{0};
 };
 
 #endif // SALUS_EXEC_RESOURCES_H
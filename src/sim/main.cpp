@@ -0,0 +1,152 @@
+/*
+ * Copyright 2019 Peifeng Yu <peifeng@umich.edu>
+ * 
+ * This file is part of Salus
+ * (see https://github.com/SymbioticLab/Salus).
+ * 
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * 
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "execution/executionengine.h"
+#include "platform/logging.h"
+#include "sim/simulator.h"
+#include "utils/macros.h"
+
+#include <docopt.h>
+
+#include <algorithm>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <regex>
+#include <string>
+
+using namespace std;
+using namespace std::string_literals;
+
+namespace {
+
+namespace flags {
+const static auto workloads = "<workloads>";
+const static auto trace = "<trace>";
+const static auto scheduler = "--sched";
+const static auto disableWorkConservative = "--disable-wc";
+const static auto numGPUs = "--gpus";
+const static auto gpuMemory = "--gpu-memory";
+const static auto persistentFraction = "--persistent-fraction";
+const static auto disableSharedLane = "--disable-shared-lane";
+const static auto output = "--output";
+const static auto verbose = "--verbose";
+} // namespace flags
+
+static auto kUsage =
+    R"(Usage:
+    <program-name> [options] <workloads> [<trace>]
+    <program-name> --help
+
+Salus offline scheduler simulator. Replays jobs through the iteration scheduling
+policies under virtual time, using recorded workload profiles.
+
+<workloads> is a csv file with columns `name,duration_s,mem_MB,iters,command`,
+e.g. tests/workloads.csv. <trace> is a csv file with columns
+`arrival_s,workload[,weight[,tenant[,scavenger]]]`. Without a trace, every
+workload is submitted once at time 0.
+
+Options:
+    -h, --help                  Print this help message and exit.
+    -s <policy>, --sched=<policy>
+                                Use <policy> for scheduling . Choices: fair, preempt, pack, rr, fifo.
+                                [default: fair]
+    --disable-wc                Disable work conservation.
+    --gpus=<num>                Number of GPUs. [default: 1]
+    --gpu-memory=<MB>           Memory of each GPU in MB. [default: 14336]
+    --persistent-fraction=<f>   Fraction of workload memory that is persistent, the rest
+                                can be shared with other jobs in the same lane.
+                                [default: 1.0]
+    --disable-shared-lane       Never put more than one job in a lane.
+    -o <file>, --output=<file>  Also write the report as json to <file>.
+    -v <level>, --verbose=<level>
+                                Enable verbose logging level <level>.
+                                Valid range: 0-9. (0 means disable)
+                                [default: 0]
+)"s;
+
+auto parseArguments(int argc, char **argv)
+{
+    string executable(argv[0]);
+    auto idx = executable.find_last_of('/');
+    if (idx != string::npos) {
+        executable = executable.substr(idx + 1);
+    }
+
+    regex pattern(R"(<program-name>)");
+    kUsage = regex_replace(kUsage, pattern, executable);
+
+    return docopt::docopt(kUsage, {argv + 1, argv + argc},
+                          /* help = */ true);
+}
+
+} // namespace
+
+int main(int argc, char **argv)
+{
+    auto args = parseArguments(argc, argv);
+
+    logging::initialize({
+        std::nullopt,
+        static_cast<int>(args[flags::verbose].asLong()),
+        std::nullopt,
+        std::nullopt,
+        std::nullopt,
+    });
+
+    salus::SchedulingParam param;
+    param.workConservative = !args[flags::disableWorkConservative].asBool();
+    param.scheduler = args[flags::scheduler].asString();
+    salus::ExecutionEngine::instance().setSchedulingParam(param);
+
+    // docopt doesn't handle double number
+    // so we get as string and do conversion ourselves
+    salus::sim::SimConfig config;
+    config.numGPUs = static_cast<size_t>(args[flags::numGPUs].asLong());
+    config.gpuMemory = static_cast<size_t>(args[flags::gpuMemory].asLong()) * 1024 * 1024;
+    config.persistentFraction = std::atof(args[flags::persistentFraction].asString().c_str());
+    config.sharedLane = !args[flags::disableSharedLane].asBool();
+
+    auto workloads = salus::sim::loadWorkloads(args[flags::workloads].asString());
+
+    std::vector<salus::sim::JobSpec> jobs;
+    if (args[flags::trace]) {
+        jobs = salus::sim::loadTrace(args[flags::trace].asString());
+    } else {
+        for (const auto &[name, w] : workloads) {
+            UNUSED(w);
+            jobs.push_back({name});
+        }
+        std::sort(jobs.begin(), jobs.end(), [](const auto &a, const auto &b) { return a.workload < b.workload; });
+    }
+
+    LOG(INFO) << "Simulating " << jobs.size() << " jobs with policy "
+              << salus::ExecutionEngine::instance().schedulingParam().scheduler;
+
+    auto report = salus::sim::simulate(config, workloads, jobs);
+
+    std::cout << report.DebugString() << std::endl;
+
+    if (args[flags::output]) {
+        std::ofstream out(args[flags::output].asString());
+        out << report.toJson() << std::endl;
+    }
+
+    return 0;
+}
@@ -0,0 +1,737 @@
+/*
+ * Copyright 2019 Peifeng Yu <peifeng@umich.edu>
+ * 
+ * This file is part of Salus
+ * (see https://github.com/SymbioticLab/Salus).
+ * 
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * 
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "sim/simulator.h"
+
+#include "execution/engine/iterationcontext.h"
+#include "execution/executionengine.h"
+#include "execution/iterationtask.h"
+#include "execution/scheduler/schedclock.h"
+#include "platform/logging.h"
+#include "utils/macros.h"
+
+#include <nlohmann/json.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <ctime>
+#include <fstream>
+#include <functional>
+#include <list>
+#include <map>
+#include <memory>
+#include <optional>
+#include <set>
+#include <sstream>
+
+using std::chrono::duration_cast;
+using std::chrono::nanoseconds;
+using std::chrono::seconds;
+using FpSeconds = std::chrono::duration<double, seconds::period>;
+
+namespace salus::sim {
+
+namespace {
+
+using TimePoint = SchedClock::time_point;
+
+double toSeconds(TimePoint t)
+{
+    return FpSeconds(t.time_since_epoch()).count();
+}
+
+TimePoint fromSeconds(double sec)
+{
+    return TimePoint{duration_cast<SchedClock::duration>(FpSeconds(sec))};
+}
+
+std::vector<std::string> splitCsvLine(const std::string &line, size_t maxFields)
+{
+    std::vector<std::string> fields;
+    size_t start = 0;
+    while (fields.size() + 1 < maxFields) {
+        auto pos = line.find(',', start);
+        if (pos == std::string::npos) {
+            break;
+        }
+        fields.emplace_back(line.substr(start, pos - start));
+        start = pos + 1;
+    }
+    // the last field takes the rest of the line, which may contain commas itself
+    fields.emplace_back(line.substr(start));
+    return fields;
+}
+
+/**
+ * @brief Events ordered by virtual time, then by insertion order
+ */
+class EventQueue
+{
+    std::map<std::pair<TimePoint, uint64_t>, std::function<void()>> m_events;
+    uint64_t m_nextSeq = 0;
+
+public:
+    void at(TimePoint t, std::function<void()> fn)
+    {
+        m_events.emplace(std::make_pair(t, m_nextSeq++), std::move(fn));
+    }
+
+    bool empty() const
+    {
+        return m_events.empty();
+    }
+
+    TimePoint nextTime() const
+    {
+        return m_events.begin()->first.first;
+    }
+
+    std::pair<TimePoint, std::function<void()>> pop()
+    {
+        auto node = m_events.extract(m_events.begin());
+        return {node.key().first, std::move(node.mapped())};
+    }
+};
+
+/**
+ * @brief Lane placement following the same greedy best fit as LaneMgr, without any TF device
+ */
+class SimLaneMgr
+{
+public:
+    struct Lane
+    {
+        uint64_t id;
+        size_t gpu;
+        size_t totalMemory;
+        size_t availableMemory;
+        std::multiset<size_t, std::greater<>> maxPeak;
+    };
+
+    struct Holder
+    {
+        Lane *lane;
+        size_t hold;
+        size_t peak;
+    };
+
+    using Callback = std::function<void(Holder)>;
+
+    SimLaneMgr(size_t numGPUs, size_t memory, bool sharedLane)
+        : m_sharedLane(sharedLane)
+        , m_gpus(numGPUs)
+    {
+        for (auto &gcb : m_gpus) {
+            gcb.totalMemory = memory;
+            gcb.availableMemory = memory;
+        }
+    }
+
+    void requestLane(size_t memory, size_t persistent, Callback &&cb)
+    {
+        m_pending.push_back({memory, persistent, std::move(cb)});
+        processRequests();
+    }
+
+    void releaseLane(Holder holder)
+    {
+        auto &lane = *holder.lane;
+        lane.availableMemory += holder.hold;
+        auto it = lane.maxPeak.find(holder.peak);
+        CHECK(it != lane.maxPeak.end());
+        lane.maxPeak.erase(it);
+
+        if (lane.maxPeak.empty()) {
+            // last holder gone, give memory back to GPU
+            auto &gcb = m_gpus.at(lane.gpu);
+            accountMemory(gcb);
+            gcb.availableMemory += lane.availableMemory;
+            CHECK_LE(gcb.availableMemory, gcb.totalMemory);
+            gcb.lanes.remove_if([&lane](const auto &l) { return l.get() == &lane; });
+        }
+
+        processRequests();
+    }
+
+    size_t numGPUs() const
+    {
+        return m_gpus.size();
+    }
+
+    /**
+     * @brief Integral of memory assigned to lanes over time, in byte seconds
+     */
+    double memoryIntegral(size_t gpu)
+    {
+        auto &gcb = m_gpus.at(gpu);
+        accountMemory(gcb);
+        return gcb.memoryIntegral;
+    }
+
+private:
+    struct Request
+    {
+        size_t memory;
+        size_t persistent;
+        Callback cb;
+    };
+
+    struct GpuControlBlock
+    {
+        size_t totalMemory = 0;
+        size_t availableMemory = 0;
+        // lanes are sorted in asc order
+        std::list<std::unique_ptr<Lane>> lanes;
+
+        double memoryIntegral = 0;
+        TimePoint lastAccounted{};
+    };
+
+    void accountMemory(GpuControlBlock &gcb)
+    {
+        auto now = SchedClock::now();
+        auto used = gcb.totalMemory - gcb.availableMemory;
+        gcb.memoryIntegral += used * FpSeconds(now - gcb.lastAccounted).count();
+        gcb.lastAccounted = now;
+    }
+
+    void processRequests()
+    {
+        auto it = m_pending.begin();
+        while (it != m_pending.end()) {
+            std::optional<Holder> holder;
+            for (size_t i = 0; i != m_gpus.size() && !holder; ++i) {
+                holder = bestFitFor(i, it->memory, it->persistent);
+            }
+            if (!holder) {
+                ++it;
+                continue;
+            }
+            auto cb = std::move(it->cb);
+            it = m_pending.erase(it);
+            cb(*holder);
+        }
+    }
+
+    std::optional<Holder> bestFitFor(size_t gpu, size_t memory, size_t persistent)
+    {
+        CHECK_GE(memory, persistent);
+        auto &gcb = m_gpus.at(gpu);
+        size_t temporaryPeak = memory - persistent;
+
+        // first see if open a new lane is possible
+        if (gcb.availableMemory >= memory) {
+            accountMemory(gcb);
+            gcb.availableMemory -= memory;
+
+            auto lane = std::make_unique<Lane>(Lane{++m_nextLaneId, gpu, memory, memory, {}});
+            auto pos = std::find_if(gcb.lanes.begin(), gcb.lanes.end(), [&lane](const auto &l) {
+                return l->availableMemory > lane->availableMemory;
+            });
+            auto &inserted = *gcb.lanes.insert(pos, std::move(lane));
+            auto holder = tryFit(*inserted, persistent, temporaryPeak);
+            CHECK(holder);
+            return holder;
+        }
+
+        if (m_sharedLane) {
+            for (auto &lane : gcb.lanes) {
+                if (auto holder = tryFit(*lane, persistent, temporaryPeak)) {
+                    return holder;
+                }
+            }
+        }
+        return {};
+    }
+
+    std::optional<Holder> tryFit(Lane &lane, size_t persistent, size_t peak)
+    {
+        auto maxPeak = peak;
+        if (!lane.maxPeak.empty()) {
+            maxPeak = std::max(maxPeak, *lane.maxPeak.cbegin());
+        }
+        if ((persistent + maxPeak) <= lane.availableMemory) {
+            lane.availableMemory -= persistent;
+            lane.maxPeak.insert(peak);
+            return Holder{&lane, persistent, peak};
+        }
+        return {};
+    }
+
+    bool m_sharedLane;
+    std::vector<GpuControlBlock> m_gpus;
+    std::list<Request> m_pending;
+    uint64_t m_nextLaneId = 0;
+};
+
+class Simulation;
+
+struct Job
+{
+    JobSpec spec;
+    const WorkloadProfile *profile = nullptr;
+    std::string sess;
+
+    std::shared_ptr<ExecutionContext> ectx;
+    std::optional<SimLaneMgr::Holder> lane;
+    SchedClock::duration iterDuration{};
+
+    uint64_t numIters = 0;
+    uint64_t numCanceledIters = 0;
+    TimePoint arrival{};
+    TimePoint start{};
+    TimePoint finish{};
+    bool finished = false;
+};
+
+/**
+ * @brief State of an iteration once started, outlives the IterationTask, which the engine
+ * may destroy as soon as runAsync returns.
+ */
+struct RunningIter
+{
+    Simulation &sim;
+    Job &job;
+    std::shared_ptr<IterationContext> ictx;
+    bool done = false;
+};
+
+class Simulation
+{
+public:
+    Simulation(const SimConfig &config, const Workloads &workloads, const std::vector<JobSpec> &specs);
+
+    SimReport run();
+
+    void at(TimePoint t, std::function<void()> fn)
+    {
+        m_events.at(t, std::move(fn));
+    }
+
+    void iterationStarted(Job &job);
+    void iterationDone(Job &job, bool canceled);
+
+private:
+    void submit(Job &job);
+    void laneAssigned(Job &job, SimLaneMgr::Holder holder);
+    void scheduleNextIteration(Job &job);
+
+    ExecutionEngine &m_engine;
+    SimConfig m_config;
+    EventQueue m_events;
+    SimLaneMgr m_lanes;
+    std::vector<std::unique_ptr<Job>> m_jobs;
+
+    // per GPU number of iterations running, and accumulated busy time
+    std::vector<size_t> m_running;
+    std::vector<TimePoint> m_busySince;
+    std::vector<SchedClock::duration> m_busy;
+};
+
+class SimIterationTask : public IterationTask
+{
+    Simulation &m_sim;
+    Job &m_job;
+    bool m_canceled = false;
+    std::shared_ptr<RunningIter> m_run;
+
+    static void complete(const std::shared_ptr<RunningIter> &run, bool canceled)
+    {
+        if (run->done) {
+            return;
+        }
+        run->done = true;
+        auto ictx = std::move(run->ictx);
+        ictx->finish(!canceled);
+        run->sim.iterationDone(run->job, canceled);
+    }
+
+public:
+    SimIterationTask(Simulation &sim, Job &job)
+        : m_sim(sim)
+        , m_job(job)
+    {
+    }
+
+    uint64_t graphId() const override
+    {
+        // one training graph per job
+        return 1;
+    }
+
+    bool prepare() override
+    {
+        auto &ectx = m_job.ectx;
+        return ectx->m_item->beginIteration(ectx->m_ticket, {}, graphId());
+    }
+
+    ResStats estimatedPeakAllocation(const DeviceSpec &) const override
+    {
+        return {};
+    }
+
+    void runAsync(std::shared_ptr<IterationContext> &&ictx) noexcept override
+    {
+        m_run = std::make_shared<RunningIter>(RunningIter{m_sim, m_job, std::move(ictx)});
+        m_sim.iterationStarted(m_job);
+        m_sim.at(SchedClock::now() + m_job.iterDuration, [run = m_run]() { complete(run, false); });
+    }
+
+    void cancel() override
+    {
+        if (m_canceled) {
+            return;
+        }
+        m_canceled = true;
+        if (m_run) {
+            // this may be destroyed during completion
+            auto run = m_run;
+            complete(run, true);
+        }
+    }
+
+    bool isCanceled() const override
+    {
+        return m_canceled;
+    }
+
+    bool isExpensive() const override
+    {
+        return true;
+    }
+};
+
+Simulation::Simulation(const SimConfig &config, const Workloads &workloads, const std::vector<JobSpec> &specs)
+    : m_engine(ExecutionEngine::instance())
+    , m_config(config)
+    , m_lanes(config.numGPUs, config.gpuMemory, config.sharedLane)
+    , m_running(config.numGPUs, 0)
+    , m_busySince(config.numGPUs)
+    , m_busy(config.numGPUs, SchedClock::duration::zero())
+{
+    for (const auto &spec : specs) {
+        auto it = workloads.find(spec.workload);
+        if (it == workloads.end()) {
+            LOG(ERROR) << "Skipping job with unknown workload: " << spec.workload;
+            continue;
+        }
+        if (it->second.numIters == 0) {
+            LOG(ERROR) << "Skipping job with no iteration: " << spec.workload;
+            continue;
+        }
+
+        auto job = std::make_unique<Job>();
+        job->spec = spec;
+        job->profile = &it->second;
+        job->sess = spec.workload + "#" + std::to_string(m_jobs.size());
+        job->iterDuration = duration_cast<SchedClock::duration>(FpSeconds(it->second.jctSec / it->second.numIters));
+        job->arrival = fromSeconds(spec.arrivalSec);
+        m_jobs.emplace_back(std::move(job));
+    }
+}
+
+void Simulation::submit(Job &job)
+{
+    job.ectx = m_engine.makeContext();
+    CHECK(job.ectx) << "ExecutionEngine is stopping";
+
+    job.ectx->setSessionHandle(job.sess);
+    job.ectx->dropExlusiveMode();
+    job.ectx->setExpectedRunningTime(static_cast<uint64_t>(std::round(job.profile->jctSec)) * 1000);
+    job.ectx->setScavenger(job.spec.scavenger);
+    job.ectx->setSchedulingWeight(job.spec.weight, job.spec.tenant);
+
+    // Same as the lane request in TFInstance, from the workload's peak memory
+    auto total = job.profile->memoryMB * 1024 * 1024;
+    auto persistentFraction = std::clamp(m_config.persistentFraction, 0.0, 1.0);
+    auto persistent = static_cast<size_t>(total * persistentFraction * 1.1);
+    auto memory = static_cast<size_t>((persistent + total * (1 - persistentFraction)) * 1.05);
+    memory = std::min(memory, m_config.gpuMemory);
+    persistent = std::min(persistent, memory);
+
+    m_lanes.requestLane(memory, persistent, [this, &job](auto holder) { laneAssigned(job, holder); });
+}
+
+void Simulation::laneAssigned(Job &job, SimLaneMgr::Holder holder)
+{
+    job.lane = holder;
+    job.start = SchedClock::now();
+    job.ectx->setLaneId(holder.lane->id);
+
+    VLOG(1) << "event: lane_assigned "
+            << nlohmann::json({
+                   {"sess", job.sess},
+                   {"laneId", holder.lane->id},
+                   {"laneSize", holder.lane->totalMemory},
+                   {"laneAvail", holder.lane->availableMemory},
+                   {"time", toSeconds(job.start)},
+               });
+
+    scheduleNextIteration(job);
+}
+
+void Simulation::scheduleNextIteration(Job &job)
+{
+    job.ectx->scheduleIteartion(std::make_unique<SimIterationTask>(*this, job));
+}
+
+void Simulation::iterationStarted(Job &job)
+{
+    auto gpu = job.lane->lane->gpu;
+    if (m_running[gpu]++ == 0) {
+        m_busySince[gpu] = SchedClock::now();
+    }
+}
+
+void Simulation::iterationDone(Job &job, bool canceled)
+{
+    auto gpu = job.lane->lane->gpu;
+    if (--m_running[gpu] == 0) {
+        m_busy[gpu] += SchedClock::now() - m_busySince[gpu];
+    }
+
+    if (canceled) {
+        // the work is lost, and the iteration has to be run again
+        ++job.numCanceledIters;
+    } else {
+        ++job.numIters;
+    }
+
+    if (job.numIters < job.profile->numIters) {
+        scheduleNextIteration(job);
+        return;
+    }
+
+    job.finish = SchedClock::now();
+    job.finished = true;
+    VLOG(1) << "event: job_finished "
+            << nlohmann::json({
+                   {"sess", job.sess},
+                   {"jct", FpSeconds(job.finish - job.arrival).count()},
+               });
+
+    // give up the session, which also removes it from the engine
+    job.ectx.reset();
+    auto holder = *job.lane;
+    job.lane.reset();
+    m_lanes.releaseLane(holder);
+}
+
+SimReport Simulation::run()
+{
+    for (auto &job : m_jobs) {
+        at(job->arrival, [this, &job = *job]() { submit(job); });
+    }
+
+    auto cpuStart = std::clock();
+
+    size_t pending = 0;
+    while (!m_events.empty()) {
+        auto [t, fn] = m_events.pop();
+        SchedClock::advanceTo(t);
+        fn();
+
+        // let all events at the same time happen before scheduling
+        if (!m_events.empty() && m_events.nextTime() == t) {
+            continue;
+        }
+        pending = m_engine.runSchedulingPass();
+    }
+
+    SimReport report;
+    report.simulationCpuSec = static_cast<double>(std::clock() - cpuStart) / CLOCKS_PER_SEC;
+
+    if (pending > 0) {
+        LOG(ERROR) << "Simulation stalled with " << pending << " iterations pending";
+    }
+
+    auto end = SchedClock::now();
+    auto begin = end;
+    double totalJct = 0;
+    size_t numFinished = 0;
+    for (auto &job : m_jobs) {
+        begin = std::min(begin, job->arrival);
+
+        JobResult res;
+        res.sess = job->sess;
+        res.workload = job->spec.workload;
+        res.arrivalSec = toSeconds(job->arrival);
+        res.startSec = toSeconds(job->start);
+        res.finishSec = toSeconds(job->finish);
+        res.numIters = job->numIters;
+        res.numCanceledIters = job->numCanceledIters;
+        res.finished = job->finished;
+        if (res.finished) {
+            totalJct += res.jctSec();
+            ++numFinished;
+        } else {
+            LOG(ERROR) << "Job " << job->sess << " did not finish, " << job->numIters << " of "
+                       << job->profile->numIters << " iterations done";
+        }
+        report.jobs.emplace_back(std::move(res));
+    }
+
+    auto makespan = FpSeconds(end - begin).count();
+    report.makespanSec = makespan;
+    report.avgJctSec = numFinished > 0 ? totalJct / numFinished : 0;
+    for (size_t i = 0; i != m_lanes.numGPUs(); ++i) {
+        if (makespan <= 0) {
+            report.gpuUtilization.push_back(0);
+            report.memoryUtilization.push_back(0);
+            continue;
+        }
+        report.gpuUtilization.push_back(FpSeconds(m_busy[i]).count() / makespan);
+        report.memoryUtilization.push_back(m_lanes.memoryIntegral(i) / m_config.gpuMemory / makespan);
+    }
+    return report;
+}
+
+} // namespace
+
+Workloads loadWorkloads(const std::string &path)
+{
+    std::ifstream in(path);
+    CHECK(in) << "Can not open workload file " << path;
+
+    Workloads workloads;
+    std::string line;
+    while (std::getline(in, line)) {
+        if (line.empty() || line[0] == '#') {
+            continue;
+        }
+        auto fields = splitCsvLine(line, 5);
+        if (fields.size() < 4) {
+            LOG(WARNING) << "Ignoring malformed workload line: " << line;
+            continue;
+        }
+        try {
+            WorkloadProfile w;
+            w.name = fields[0];
+            w.jctSec = std::stod(fields[1]);
+            w.memoryMB = std::stod(fields[2]);
+            w.numIters = std::stoull(fields[3]);
+            workloads[w.name] = std::move(w);
+        } catch (const std::logic_error &ex) {
+            LOG(WARNING) << "Ignoring malformed workload line: " << line << ": " << ex.what();
+        }
+    }
+    return workloads;
+}
+
+std::vector<JobSpec> loadTrace(const std::string &path)
+{
+    std::ifstream in(path);
+    CHECK(in) << "Can not open trace file " << path;
+
+    std::vector<JobSpec> jobs;
+    std::string line;
+    while (std::getline(in, line)) {
+        if (line.empty() || line[0] == '#') {
+            continue;
+        }
+        auto fields = splitCsvLine(line, 5);
+        if (fields.size() < 2) {
+            LOG(WARNING) << "Ignoring malformed trace line: " << line;
+            continue;
+        }
+        try {
+            JobSpec spec;
+            spec.arrivalSec = std::stod(fields[0]);
+            spec.workload = fields[1];
+            if (fields.size() > 2) {
+                spec.weight = std::stod(fields[2]);
+            }
+            if (fields.size() > 3) {
+                spec.tenant = std::stoull(fields[3]);
+            }
+            if (fields.size() > 4) {
+                spec.scavenger = std::stoi(fields[4]) > 0;
+            }
+            jobs.emplace_back(std::move(spec));
+        } catch (const std::logic_error &ex) {
+            LOG(WARNING) << "Ignoring malformed trace line: " << line << ": " << ex.what();
+        }
+    }
+    std::stable_sort(jobs.begin(), jobs.end(),
+                     [](const auto &a, const auto &b) { return a.arrivalSec < b.arrivalSec; });
+    return jobs;
+}
+
+SimReport simulate(const SimConfig &config, const Workloads &workloads, const std::vector<JobSpec> &jobs)
+{
+    SchedClock::useVirtualTime(TimePoint{});
+    Simulation sim(config, workloads, jobs);
+    return sim.run();
+}
+
+std::string SimReport::DebugString() const
+{
+    std::ostringstream oss;
+    oss << "Jobs:" << std::endl;
+    for (const auto &job : jobs) {
+        oss << "    " << job.sess << ": ";
+        if (job.finished) {
+            oss << "JCT " << job.jctSec() << "s, queued " << (job.startSec - job.arrivalSec) << "s";
+        } else {
+            oss << "unfinished";
+        }
+        oss << ", " << job.numIters << " iterations";
+        if (job.numCanceledIters > 0) {
+            oss << " (" << job.numCanceledIters << " canceled)";
+        }
+        oss << std::endl;
+    }
+    oss << "Makespan: " << makespanSec << "s" << std::endl;
+    oss << "Average JCT: " << avgJctSec << "s" << std::endl;
+    for (size_t i = 0; i != gpuUtilization.size(); ++i) {
+        oss << "GPU" << i << " utilization: " << gpuUtilization[i] << ", memory utilization: " << memoryUtilization[i]
+            << std::endl;
+    }
+    oss << "Simulation CPU time: " << simulationCpuSec << "s";
+    return oss.str();
+}
+
+std::string SimReport::toJson() const
+{
+    auto jobsJson = nlohmann::json::array();
+    for (const auto &job : jobs) {
+        jobsJson.push_back({
+            {"sess", job.sess},
+            {"workload", job.workload},
+            {"arrival", job.arrivalSec},
+            {"start", job.startSec},
+            {"finish", job.finishSec},
+            {"jct", job.jctSec()},
+            {"iters", job.numIters},
+            {"canceledIters", job.numCanceledIters},
+            {"finished", job.finished},
+        });
+    }
+    return nlohmann::json({
+                              {"jobs", jobsJson},
+                              {"makespan", makespanSec},
+                              {"avgJct", avgJctSec},
+                              {"gpuUtilization", gpuUtilization},
+                              {"memoryUtilization", memoryUtilization},
+                              {"simulationCpuTime", simulationCpuSec},
+                          })
+        .dump(4);
+}
+
+} // namespace salus::sim
@@ -0,0 +1,124 @@
+/*
+ * Copyright 2019 Peifeng Yu <peifeng@umich.edu>
+ * 
+ * This file is part of Salus
+ * (see https://github.com/SymbioticLab/Salus).
+ * 
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * 
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef SALUS_SIM_SIMULATOR_H
+#define SALUS_SIM_SIMULATOR_H
+
+#include "utils/macros.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace salus::sim {
+
+/**
+ * @brief Recorded profile of a workload running alone, as in tests/workloads.csv
+ */
+struct WorkloadProfile
+{
+    std::string name;
+    // JCT when running alone
+    double jctSec = 0;
+    // Peak GPU memory
+    double memoryMB = 0;
+    uint64_t numIters = 0;
+};
+
+using Workloads = std::unordered_map<std::string, WorkloadProfile>;
+
+/**
+ * @brief A job submitted during simulation
+ */
+struct JobSpec
+{
+    std::string workload;
+    double arrivalSec = 0;
+    double weight = 1.0;
+    uint64_t tenant = 0;
+    bool scavenger = false;
+};
+
+struct SimConfig
+{
+    size_t numGPUs = 1;
+    size_t gpuMemory = 14_sz * 1024 * 1024 * 1024;
+    // Fraction of the workload memory that is persistent, the rest can be shared in a lane
+    double persistentFraction = 1.0;
+    bool sharedLane = true;
+};
+
+struct JobResult
+{
+    std::string sess;
+    std::string workload;
+    double arrivalSec = 0;
+    double startSec = 0;
+    double finishSec = 0;
+    uint64_t numIters = 0;
+    uint64_t numCanceledIters = 0;
+    bool finished = false;
+
+    double jctSec() const
+    {
+        return finishSec - arrivalSec;
+    }
+};
+
+struct SimReport
+{
+    std::vector<JobResult> jobs;
+    double makespanSec = 0;
+    double avgJctSec = 0;
+    // Fraction of makespan each GPU has at least one iteration running
+    std::vector<double> gpuUtilization;
+    // Time averaged fraction of each GPU's memory assigned to lanes
+    std::vector<double> memoryUtilization;
+    // CPU time spent by the simulation itself
+    double simulationCpuSec = 0;
+
+    std::string DebugString() const;
+    std::string toJson() const;
+};
+
+/**
+ * @brief Load workload profiles from a csv file with columns `name,duration_s,mem_MB,iters,command`
+ */
+Workloads loadWorkloads(const std::string &path);
+
+/**
+ * @brief Load job arrivals from a csv file with columns `arrival_s,workload[,weight[,tenant[,scavenger]]]`.
+ * Empty lines and lines starting with '#' are ignored.
+ */
+std::vector<JobSpec> loadTrace(const std::string &path);
+
+/**
+ * @brief Replay jobs through the real ExecutionEngine iteration scheduling policies under virtual time.
+ *
+ * Iterations take the recorded per iteration duration, and lanes are assigned with the same
+ * greedy best fit as LaneMgr. Switches SchedClock to virtual time, and drives the ExecutionEngine
+ * singleton, so can be called only once per process, without the scheduler started.
+ */
+SimReport simulate(const SimConfig &config, const Workloads &workloads, const std::vector<JobSpec> &jobs);
+
+} // namespace salus::sim
+
+#endif // SALUS_SIM_SIMULATOR_H
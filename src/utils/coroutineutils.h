@@ -0,0 +1,520 @@
+/*
+ * Copyright 2019 Peifeng Yu <peifeng@umich.edu>
+ * 
+ * This file is part of Salus
+ * (see https://github.com/SymbioticLab/Salus).
+ * 
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * 
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef SALUS_SSTL_COROUTINEUTILS_H
+#define SALUS_SSTL_COROUTINEUTILS_H
+
+/**
+ * @file
+ * Coroutine tasks and awaitable synchronization primitives.
+ *
+ * This needs C++20, while the rest of the tree builds as C++17. Only include it from
+ * translation units built as C++20.
+ */
+
+#if !defined(__cpp_impl_coroutine)
+#error "utils/coroutineutils.h needs C++20 coroutines"
+#endif
+
+#include "platform/thread_annotations.h"
+#include "utils/threadutils.h"
+
+#include <coroutine>
+#include <cstdint>
+#include <exception>
+#include <mutex>
+#include <optional>
+#include <type_traits>
+#include <utility>
+
+namespace sstl {
+
+template<typename T = void>
+class Task;
+
+namespace detail {
+
+struct TaskPromiseBase
+{
+    // resumed when the task finishes, by symmetric transfer so chains of tasks don't grow the stack
+    std::coroutine_handle<> continuation = std::noop_coroutine();
+    std::exception_ptr error;
+
+    struct FinalAwaiter
+    {
+        bool await_ready() const noexcept
+        {
+            return false;
+        }
+
+        template<typename Promise>
+        std::coroutine_handle<> await_suspend(std::coroutine_handle<Promise> h) noexcept
+        {
+            return h.promise().continuation;
+        }
+
+        void await_resume() const noexcept
+        {
+        }
+    };
+
+    // lazily started, the task runs when awaited
+    std::suspend_always initial_suspend() const noexcept
+    {
+        return {};
+    }
+
+    FinalAwaiter final_suspend() const noexcept
+    {
+        return {};
+    }
+
+    void unhandled_exception() noexcept
+    {
+        error = std::current_exception();
+    }
+
+    void rethrowIfFailed() const
+    {
+        if (error) {
+            std::rethrow_exception(error);
+        }
+    }
+};
+
+template<typename T>
+struct TaskPromise : TaskPromiseBase
+{
+    std::optional<T> value;
+
+    Task<T> get_return_object() noexcept;
+
+    template<typename U>
+    void return_value(U &&v)
+    {
+        value.emplace(std::forward<U>(v));
+    }
+
+    T result()
+    {
+        rethrowIfFailed();
+        return std::move(*value);
+    }
+};
+
+template<>
+struct TaskPromise<void> : TaskPromiseBase
+{
+    Task<void> get_return_object() noexcept;
+
+    void return_void() const noexcept
+    {
+    }
+
+    void result() const
+    {
+        rethrowIfFailed();
+    }
+};
+
+} // namespace detail
+
+/**
+ * @brief A lazily started coroutine returning T.
+ *
+ * The task runs when awaited, and the awaiting coroutine resumes right after it finishes,
+ * on whatever thread it finished on. Exceptions propagate to the awaiter. The coroutine frame
+ * is the only allocation, and is freed with the Task.
+ */
+template<typename T>
+class [[nodiscard]] Task
+{
+public:
+    using promise_type = detail::TaskPromise<T>;
+    using Handle = std::coroutine_handle<promise_type>;
+
+    Task(Task &&other) noexcept
+        : m_h(std::exchange(other.m_h, {}))
+    {
+    }
+
+    Task &operator=(Task &&other) noexcept
+    {
+        if (this != &other) {
+            reset();
+            m_h = std::exchange(other.m_h, {});
+        }
+        return *this;
+    }
+
+    ~Task()
+    {
+        reset();
+    }
+
+    bool await_ready() const noexcept
+    {
+        return !m_h || m_h.done();
+    }
+
+    std::coroutine_handle<> await_suspend(std::coroutine_handle<> awaiter) noexcept
+    {
+        m_h.promise().continuation = awaiter;
+        return m_h;
+    }
+
+    T await_resume()
+    {
+        return m_h.promise().result();
+    }
+
+private:
+    friend promise_type;
+
+    explicit Task(Handle h) noexcept
+        : m_h(h)
+    {
+    }
+
+    void reset() noexcept
+    {
+        if (m_h) {
+            m_h.destroy();
+            m_h = {};
+        }
+    }
+
+    Handle m_h;
+};
+
+namespace detail {
+
+template<typename T>
+Task<T> TaskPromise<T>::get_return_object() noexcept
+{
+    return Task<T>{std::coroutine_handle<TaskPromise<T>>::from_promise(*this)};
+}
+
+inline Task<void> TaskPromise<void>::get_return_object() noexcept
+{
+    return Task<void>{std::coroutine_handle<TaskPromise<void>>::from_promise(*this)};
+}
+
+/**
+ * @brief A coroutine that starts eagerly and frees itself when done, used to drive a Task.
+ */
+struct Detached
+{
+    struct promise_type
+    {
+        Detached get_return_object() const noexcept
+        {
+            return {};
+        }
+
+        std::suspend_never initial_suspend() const noexcept
+        {
+            return {};
+        }
+
+        std::suspend_never final_suspend() const noexcept
+        {
+            return {};
+        }
+
+        void return_void() const noexcept
+        {
+        }
+
+        void unhandled_exception() const noexcept
+        {
+            std::terminate();
+        }
+    };
+};
+
+template<typename T, typename Result>
+Detached runAndNotify(Task<T> &task, Result &result, std::exception_ptr &error, notification &done)
+{
+    try {
+        if constexpr (std::is_void_v<T>) {
+            co_await task;
+        } else {
+            result.emplace(co_await task);
+        }
+    } catch (...) {
+        error = std::current_exception();
+    }
+    done.notify();
+}
+
+} // namespace detail
+
+/**
+ * @brief Run the task and block the calling thread until it finishes.
+ * For entering coroutine code from plain threads, e.g. in tests.
+ */
+template<typename T>
+T syncWait(Task<T> task)
+{
+    using Result = std::conditional_t<std::is_void_v<T>, std::optional<int>, std::optional<T>>;
+    Result result;
+    std::exception_ptr error;
+    notification done;
+
+    detail::runAndNotify(task, result, error, done);
+    done.wait();
+
+    if (error) {
+        std::rethrow_exception(error);
+    }
+    if constexpr (!std::is_void_v<T>) {
+        return std::move(*result);
+    }
+}
+
+namespace detail {
+
+/**
+ * @brief A suspended coroutine queued in an intrusive FIFO list. The node lives in the
+ * awaiter, which is in the coroutine frame, so queuing allocates nothing.
+ */
+struct WaitNode
+{
+    std::coroutine_handle<> handle;
+    WaitNode *next = nullptr;
+};
+
+class WaitList
+{
+public:
+    bool empty() const noexcept
+    {
+        return m_head == nullptr;
+    }
+
+    WaitNode *front() const noexcept
+    {
+        return m_head;
+    }
+
+    void push(WaitNode *node) noexcept
+    {
+        node->next = nullptr;
+        if (m_tail) {
+            m_tail->next = node;
+        } else {
+            m_head = node;
+        }
+        m_tail = node;
+    }
+
+    WaitNode *pop() noexcept
+    {
+        auto node = m_head;
+        m_head = node->next;
+        if (!m_head) {
+            m_tail = nullptr;
+        }
+        return node;
+    }
+
+    /**
+     * @brief Resume all queued coroutines in order. The list must be detached from any lock.
+     */
+    void resumeAll()
+    {
+        while (!empty()) {
+            // the node is gone once its coroutine resumes
+            pop()->handle.resume();
+        }
+    }
+
+private:
+    WaitNode *m_head = nullptr;
+    WaitNode *m_tail = nullptr;
+};
+
+} // namespace detail
+
+/**
+ * @brief Awaitable version of notification.
+ *
+ * A notify wakes exactly one waiter, or is kept for the next one if none is waiting,
+ * the same auto-reset behavior as notification. Waiters are woken in FIFO order, and resumed
+ * on the thread calling notify, outside of the lock. Await ThreadPool scheduling afterwards
+ * to move off that thread.
+ */
+class async_notification
+{
+    std::mutex m_mu;
+    bool m_notified GUARDED_BY(m_mu) = false;
+    detail::WaitList m_waiters GUARDED_BY(m_mu);
+
+public:
+    class Awaiter
+    {
+        async_notification &m_note;
+        detail::WaitNode m_node;
+
+    public:
+        explicit Awaiter(async_notification &note) noexcept
+            : m_note(note)
+        {
+        }
+
+        bool await_ready() const noexcept
+        {
+            return false;
+        }
+
+        bool await_suspend(std::coroutine_handle<> h)
+        {
+            auto g = with_guard(m_note.m_mu);
+            if (m_note.m_notified) {
+                m_note.m_notified = false;
+                return false;
+            }
+            m_node.handle = h;
+            m_note.m_waiters.push(&m_node);
+            return true;
+        }
+
+        void await_resume() const noexcept
+        {
+        }
+    };
+
+    void notify()
+    {
+        detail::WaitNode *node = nullptr;
+        {
+            auto g = with_guard(m_mu);
+            if (m_waiters.empty()) {
+                m_notified = true;
+                return;
+            }
+            node = m_waiters.pop();
+        }
+        node->handle.resume();
+    }
+
+    bool notified()
+    {
+        auto g = with_guard(m_mu);
+        return m_notified;
+    }
+
+    Awaiter operator co_await() noexcept
+    {
+        return Awaiter{*this};
+    }
+};
+
+/**
+ * @brief Awaitable version of semaphore: `co_await sem.wait(c)` suspends until c can be taken.
+ *
+ * Waiters are served in FIFO order, so a large request is not starved by smaller ones behind it.
+ * They are resumed on the thread calling notify, outside of the lock.
+ */
+class async_semaphore
+{
+    std::mutex m_mu;
+    uint64_t m_count GUARDED_BY(m_mu);
+    detail::WaitList m_waiters GUARDED_BY(m_mu);
+
+    struct CountedNode : detail::WaitNode
+    {
+        uint64_t count = 0;
+    };
+
+public:
+    // Initialized as locked.
+    explicit async_semaphore(uint64_t init = 0)
+        : m_count(init)
+    {
+    }
+
+    class Awaiter
+    {
+        async_semaphore &m_sem;
+        CountedNode m_node;
+
+    public:
+        Awaiter(async_semaphore &sem, uint64_t c) noexcept
+            : m_sem(sem)
+        {
+            m_node.count = c;
+        }
+
+        bool await_ready() const noexcept
+        {
+            return false;
+        }
+
+        bool await_suspend(std::coroutine_handle<> h)
+        {
+            auto g = with_guard(m_sem.m_mu);
+            if (m_sem.m_waiters.empty() && m_sem.m_count >= m_node.count) {
+                m_sem.m_count -= m_node.count;
+                return false;
+            }
+            m_node.handle = h;
+            m_sem.m_waiters.push(&m_node);
+            return true;
+        }
+
+        void await_resume() const noexcept
+        {
+        }
+    };
+
+    Awaiter wait(uint64_t c = 1) noexcept
+    {
+        return Awaiter{*this, c};
+    }
+
+    void notify(uint64_t c = 1)
+    {
+        detail::WaitList ready;
+        {
+            auto g = with_guard(m_mu);
+            m_count += c;
+            while (!m_waiters.empty()) {
+                auto node = static_cast<CountedNode *>(m_waiters.front());
+                if (node->count > m_count) {
+                    break;
+                }
+                m_count -= node->count;
+                ready.push(m_waiters.pop());
+            }
+        }
+        ready.resumeAll();
+    }
+
+    bool may_block(uint64_t c = 1)
+    {
+        auto g = with_guard(m_mu);
+        return !m_waiters.empty() || m_count < c;
+    }
+};
+
+} // namespace sstl
+
+#endif // SALUS_SSTL_COROUTINEUTILS_H
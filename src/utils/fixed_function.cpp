@@ -0,0 +1,74 @@
+/*
+ * Copyright 2019 Peifeng Yu <peifeng@umich.edu>
+ * 
+ * This file is part of Salus
+ * (see https://github.com/SymbioticLab/Salus).
+ * 
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * 
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "utils/fixed_function.hpp"
+
+#include "utils/objectpool.h"
+
+#include <array>
+#include <new>
+
+namespace sstl::detail {
+
+namespace {
+// Block sizes of spill pools, each one serving captures up to its size
+constexpr std::array<size_t, 7> kSpillSizes{64, 128, 256, 512, 1024, 2048, 4096};
+
+BlockPool *spillPool(size_t bytes)
+{
+    // Never destroyed, closures may still be freed during static destruction
+    static auto pools = new std::array<BlockPool, kSpillSizes.size()>;
+    for (size_t i = 0; i != kSpillSizes.size(); ++i) {
+        if (bytes <= kSpillSizes[i]) {
+            return &(*pools)[i];
+        }
+    }
+    return nullptr;
+}
+
+size_t spillSize(size_t bytes)
+{
+    for (auto size : kSpillSizes) {
+        if (bytes <= size) {
+            return size;
+        }
+    }
+    return bytes;
+}
+
+} // namespace
+
+void *allocate_spill(size_t bytes)
+{
+    if (auto pool = spillPool(bytes)) {
+        return pool->allocate(spillSize(bytes));
+    }
+    return ::operator new(bytes);
+}
+
+void deallocate_spill(void *ptr, size_t bytes) noexcept
+{
+    if (auto pool = spillPool(bytes)) {
+        pool->deallocate(ptr, spillSize(bytes));
+        return;
+    }
+    ::operator delete(ptr);
+}
+
+} // namespace sstl::detail
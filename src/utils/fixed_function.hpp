@@ -24,6 +24,7 @@
 #ifndef SALUS_SSTL_FIXED_FUNCTION_H
 #define SALUS_SSTL_FIXED_FUNCTION_H
 
+#include <cstddef>
 #include <cstring>
 #include <stdexcept>
 #include <type_traits>
@@ -31,12 +32,21 @@
 
 namespace sstl {
 
+namespace detail {
+/**
+ * @brief Out of line storage for callables that don't fit inline, drawn from pools of
+ * a few block sizes. Larger ones go to global new.
+ */
+void *allocate_spill(size_t bytes);
+void deallocate_spill(void *ptr, size_t bytes) noexcept;
+} // namespace detail
+
 /**
  * @brief The FixedFunction<R(ARGS...), STORAGE_SIZE> class implements
  * functional object.
  * This function is analog of 'std::function' with limited capabilities:
  *  - It supports only move semantics.
- *  - The size of functional objects is limited to storage size.
+ *  - Functional objects larger than storage size spill to a pooled block.
  * Due to limitations above it is much faster on creation and copying than
  * std::function.
  */
@@ -49,6 +59,9 @@ class FixedFunction<R(ARGS...), STORAGE_SIZE>
 
     typedef R (*func_ptr_type)(ARGS...);
 
+    // Spilled objects keep a pointer to their block in the storage
+    static_assert(STORAGE_SIZE >= sizeof(void *), "storage must at least hold a pointer");
+
 public:
     FixedFunction()
         : m_function_ptr(nullptr)
@@ -57,10 +70,18 @@ public:
     {
     }
 
+    /**
+     * @brief Whether a functional object of type T is stored inline.
+     */
+    template<typename T>
+    static constexpr bool fits_inline = sizeof(T) <= STORAGE_SIZE && alignof(T) <= sizeof(size_t);
+
     /**
      * @brief FixedFunction Constructor from functional object.
      * @param object Functor object will be stored in the internal storage
      * using move constructor. Unmovable objects are prohibited explicitly.
+     * Objects that don't fit are moved to a pooled out of line block, and only
+     * the pointer to it is kept in the internal storage.
      */
     template<typename FUNC>
     FixedFunction(FUNC &&object)
@@ -68,23 +89,48 @@ public:
     {
         typedef typename std::remove_reference<FUNC>::type unref_type;
 
-        static_assert(sizeof(unref_type) < STORAGE_SIZE, "functional object doesn't fit into internal storage");
         static_assert(std::is_move_constructible<unref_type>::value, "Should be of movable type");
 
-        m_method_ptr = [](void *object_ptr, func_ptr_type, ARGS... args) -> R {
-            return static_cast<unref_type *>(object_ptr)->operator()(args...);
-        };
-
-        m_alloc_ptr = [](void *storage_ptr, void *object_ptr) {
-            if (object_ptr) {
-                auto *x_object = static_cast<unref_type *>(object_ptr);
-                new (storage_ptr) unref_type(std::move(*x_object));
-            } else {
-                static_cast<unref_type *>(storage_ptr)->~unref_type();
-            }
-        };
-
-        m_alloc_ptr(&m_storage, &object);
+        if constexpr (fits_inline<unref_type>) {
+            m_method_ptr = [](void *object_ptr, func_ptr_type, ARGS... args) -> R {
+                return static_cast<unref_type *>(object_ptr)->operator()(args...);
+            };
+
+            m_alloc_ptr = [](void *storage_ptr, void *object_ptr) {
+                if (object_ptr) {
+                    auto *x_object = static_cast<unref_type *>(object_ptr);
+                    new (storage_ptr) unref_type(std::move(*x_object));
+                } else {
+                    static_cast<unref_type *>(storage_ptr)->~unref_type();
+                }
+            };
+
+            m_alloc_ptr(&m_storage, &object);
+        } else {
+            static_assert(alignof(unref_type) <= alignof(std::max_align_t),
+                          "functional object is over-aligned for out of line storage");
+
+            m_method_ptr = [](void *object_ptr, func_ptr_type, ARGS... args) -> R {
+                return (*static_cast<unref_type **>(object_ptr))->operator()(args...);
+            };
+
+            // Moving only hands over the pointer, the object itself stays where it is
+            m_alloc_ptr = [](void *storage_ptr, void *object_ptr) {
+                auto &slot = *static_cast<unref_type **>(storage_ptr);
+                if (object_ptr) {
+                    auto &other = *static_cast<unref_type **>(object_ptr);
+                    slot = other;
+                    other = nullptr;
+                } else if (slot) {
+                    slot->~unref_type();
+                    detail::deallocate_spill(slot, sizeof(unref_type));
+                    slot = nullptr;
+                }
+            };
+
+            auto mem = detail::allocate_spill(sizeof(unref_type));
+            *reinterpret_cast<unref_type **>(&m_storage) = new (mem) unref_type(std::move(object));
+        }
     }
 
     /**
@@ -0,0 +1,166 @@
+/*
+ * Copyright 2019 Peifeng Yu <peifeng@umich.edu>
+ * 
+ * This file is part of Salus
+ * (see https://github.com/SymbioticLab/Salus).
+ * 
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * 
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef SALUS_SSTL_MPSCQUEUE_H
+#define SALUS_SSTL_MPSCQUEUE_H
+
+#include "utils/macros.h"
+
+#include <atomic>
+#include <memory>
+#include <type_traits>
+
+namespace sstl {
+
+template<typename T>
+class MpscQueue;
+
+/**
+ * @brief Intrusive hook for MpscQueue. Derive T from MpscHook<T> to make it queueable.
+ *
+ * A node can only be in one queue at a time.
+ */
+template<typename T>
+class MpscHook
+{
+    friend class MpscQueue<T>;
+
+    std::atomic<MpscHook *> m_mpscNext{nullptr};
+    // the queue's reference to the node while it's queued
+    std::shared_ptr<T> m_mpscOwner;
+};
+
+/**
+ * @brief Intrusive unbounded multi-producer single-consumer queue, after Dmitry Vyukov's
+ * non-intrusive MPSC node-based queue.
+ *
+ * push is wait-free and may be called from any thread. pop never blocks and must only be
+ * called from the single consumer thread. Items pushed by one producer are popped in
+ * the order they were pushed.
+ *
+ * pop may return nullptr while a producer is in the middle of a push. Callers must
+ * arrange to be notified after push returns, and try again.
+ */
+template<typename T>
+class MpscQueue
+{
+    using Hook = MpscHook<T>;
+
+public:
+    MpscQueue() noexcept
+        : m_head(&m_stub)
+        , m_tail(&m_stub)
+    {
+    }
+
+    ~MpscQueue()
+    {
+        // release references held by remaining nodes
+        while (pop()) {
+        }
+    }
+
+    SALUS_DISALLOW_COPY_AND_ASSIGN(MpscQueue);
+
+    void push(std::shared_ptr<T> &&item) noexcept
+    {
+        static_assert(std::is_base_of_v<Hook, T>, "T must derive from MpscHook<T>");
+
+        Hook *node = item.get();
+        node->m_mpscOwner = std::move(item);
+        pushNode(node);
+    }
+
+    /**
+     * @brief Pop the oldest item. Only call from the consumer thread.
+     * @returns nullptr if the queue is empty or the next item is not fully pushed yet
+     */
+    std::shared_ptr<T> pop() noexcept
+    {
+        auto tail = m_tail;
+        auto next = tail->m_mpscNext.load(std::memory_order_acquire);
+        if (tail == &m_stub) {
+            if (!next) {
+                return nullptr;
+            }
+            m_tail = next;
+            tail = next;
+            next = next->m_mpscNext.load(std::memory_order_acquire);
+        }
+
+        if (next) {
+            m_tail = next;
+            return take(tail);
+        }
+
+        if (tail != m_head.load(std::memory_order_acquire)) {
+            // a producer swapped head but hasn't linked it yet
+            return nullptr;
+        }
+
+        // tail is the last node, put stub back behind it so tail can be taken
+        pushNode(&m_stub);
+
+        next = tail->m_mpscNext.load(std::memory_order_acquire);
+        if (next) {
+            m_tail = next;
+            return take(tail);
+        }
+        return nullptr;
+    }
+
+    /**
+     * @brief Pop all currently available items, in order, into `out` using `out.emplace_back`.
+     * Only call from the consumer thread.
+     * @returns number of items popped
+     */
+    template<typename Container>
+    size_t drainTo(Container &out)
+    {
+        size_t count = 0;
+        while (auto item = pop()) {
+            out.emplace_back(std::move(item));
+            ++count;
+        }
+        return count;
+    }
+
+private:
+    void pushNode(Hook *node) noexcept
+    {
+        node->m_mpscNext.store(nullptr, std::memory_order_relaxed);
+        auto prev = m_head.exchange(node, std::memory_order_acq_rel);
+        prev->m_mpscNext.store(node, std::memory_order_release);
+    }
+
+    static std::shared_ptr<T> take(Hook *node) noexcept
+    {
+        return std::move(node->m_mpscOwner);
+    }
+
+    // producers side
+    alignas(64) std::atomic<Hook *> m_head;
+    // consumer side
+    alignas(64) Hook *m_tail;
+    Hook m_stub;
+};
+
+} // namespace sstl
+
+#endif // SALUS_SSTL_MPSCQUEUE_H
@@ -18,3 +18,66 @@
  */
 
 #include "objectpool.h"
+
+#include "utils/threadutils.h"
+
+namespace sstl {
+
+BlockPool::~BlockPool() = default;
+
+void *BlockPool::allocate(size_t bytes)
+{
+    size_t expected = 0;
+    if (!m_blockSize.compare_exchange_strong(expected, bytes) && expected != bytes) {
+        // not the size this pool serves
+        return ::operator new(bytes);
+    }
+
+    void *ptr = nullptr;
+    if (m_frees.try_dequeue(ptr)) {
+        return ptr;
+    }
+    return allocateSlab(bytes);
+}
+
+void BlockPool::deallocate(void *ptr, size_t bytes) noexcept
+{
+    if (bytes != m_blockSize) {
+        ::operator delete(ptr);
+        return;
+    }
+
+    if (!m_frees.enqueue(ptr)) {
+        // the free list failed to grow, the block is lost until the pool goes away
+        LOG(WARNING) << "Failed to recycle block of size " << bytes;
+    }
+}
+
+size_t BlockPool::numSlabs() const
+{
+    auto g = sstl::with_guard(m_mu);
+    return m_slabs.size();
+}
+
+void *BlockPool::allocateSlab(size_t bytes)
+{
+    // keep every block aligned as operator new would
+    constexpr auto align = alignof(std::max_align_t);
+    auto stride = (bytes + align - 1) / align * align;
+
+    // not using make_unique to skip zero-initialization
+    std::unique_ptr<std::byte[]> slab(new std::byte[stride * kBlocksPerSlab]);
+    auto base = slab.get();
+    {
+        auto g = sstl::with_guard(m_mu);
+        m_slabs.emplace_back(std::move(slab));
+    }
+
+    // hand out the first block, and put the rest in free list
+    for (size_t i = 1; i != kBlocksPerSlab; ++i) {
+        m_frees.enqueue(base + i * stride);
+    }
+    return base;
+}
+
+} // namespace sstl
@@ -21,10 +21,16 @@
 #define SALUS_SSTL_OBJECTPOOL_H
 
 #include "platform/logging.h"
+#include "platform/thread_annotations.h"
+#include "utils/macros.h"
 
 #include <concurrentqueue.h>
 
+#include <atomic>
+#include <cstddef>
 #include <memory>
+#include <mutex>
+#include <vector>
 
 namespace sstl {
 /**
@@ -101,6 +107,96 @@ private:
     Token m_token;
 };
 
+/**
+ * @brief A pool of fixed size memory blocks carved out of larger slabs. This is thread safe.
+ *
+ * The pool serves the block size of its first allocation, and falls back to global new for
+ * any other size. Freed blocks are recycled, slabs are only released with the pool.
+ */
+class BlockPool
+{
+public:
+    static constexpr size_t kBlocksPerSlab = 64;
+
+    BlockPool() = default;
+    ~BlockPool();
+
+    SALUS_DISALLOW_COPY_AND_ASSIGN(BlockPool);
+
+    void *allocate(size_t bytes);
+    void deallocate(void *ptr, size_t bytes) noexcept;
+
+    size_t blockSize() const noexcept
+    {
+        return m_blockSize;
+    }
+
+    /**
+     * @brief Number of slabs allocated so far.
+     */
+    size_t numSlabs() const;
+
+private:
+    void *allocateSlab(size_t bytes);
+
+    std::atomic<size_t> m_blockSize{0};
+    moodycamel::ConcurrentQueue<void *> m_frees;
+
+    mutable std::mutex m_mu;
+    std::vector<std::unique_ptr<std::byte[]>> m_slabs GUARDED_BY(m_mu);
+};
+
+/**
+ * @brief Allocator drawing from a shared BlockPool, keeping the pool alive.
+ *
+ * Meant for std::allocate_shared, where object and control block share one block.
+ */
+template<typename T>
+class PoolAllocator
+{
+public:
+    using value_type = T;
+
+    explicit PoolAllocator(std::shared_ptr<BlockPool> pool) noexcept
+        : m_pool(std::move(pool))
+    {
+    }
+
+    template<typename U>
+    PoolAllocator(const PoolAllocator<U> &other) noexcept // NOLINT
+        : m_pool(other.m_pool)
+    {
+    }
+
+    T *allocate(size_t n)
+    {
+        return static_cast<T *>(m_pool->allocate(n * sizeof(T)));
+    }
+
+    void deallocate(T *ptr, size_t n) noexcept
+    {
+        m_pool->deallocate(ptr, n * sizeof(T));
+    }
+
+    template<typename U>
+    friend bool operator==(const PoolAllocator &lhs, const PoolAllocator<U> &rhs) noexcept
+    {
+        return lhs.m_pool == rhs.m_pool;
+    }
+
+    template<typename U>
+    friend bool operator!=(const PoolAllocator &lhs, const PoolAllocator<U> &rhs) noexcept
+    {
+        return !(lhs == rhs);
+    }
+
+private:
+    template<typename U>
+    friend class PoolAllocator;
+
+    std::shared_ptr<BlockPool> m_pool;
+};
+
 } // namespace sstl
 
 #endif // SALUS_SSTL_OBJECTPOOL_H
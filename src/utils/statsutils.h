@@ -0,0 +1,157 @@
+/*
+ * Copyright 2019 Peifeng Yu <peifeng@umich.edu>
+ * 
+ * This file is part of Salus
+ * (see https://github.com/SymbioticLab/Salus).
+ * 
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * 
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef SALUS_SSTL_STATSUTILS_H
+#define SALUS_SSTL_STATSUTILS_H
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+namespace sstl {
+
+/**
+ * @brief Stripe used by the calling thread, stable for the lifetime of the thread.
+ */
+size_t threadStripe() noexcept;
+
+/**
+ * @brief Monotonic counter that any thread can bump without locking.
+ *
+ * Each thread adds to one of several cache line sized stripes, so threads bumping the
+ * same counter rarely contend on a cache line. Reading sums up all stripes, and is meant
+ * for an aggregator taking snapshots now and then.
+ */
+template<size_t NStripes = 8>
+class StripedCounter
+{
+public:
+    void add(uint64_t n = 1) noexcept
+    {
+        m_stripes[threadStripe() % NStripes].value.fetch_add(n, std::memory_order_relaxed);
+    }
+
+    uint64_t load() const noexcept
+    {
+        uint64_t sum = 0;
+        for (const auto &s : m_stripes) {
+            sum += s.value.load(std::memory_order_relaxed);
+        }
+        return sum;
+    }
+
+private:
+    struct alignas(64) Stripe
+    {
+        std::atomic_uint_fast64_t value{0};
+    };
+    std::array<Stripe, NStripes> m_stripes;
+};
+
+/**
+ * @brief Histogram of power of two buckets that any thread can record into without locking.
+ *
+ * Bucket 0 counts zeros, bucket i counts values in [2^(i-1), 2^i), and the last bucket
+ * also counts everything larger.
+ */
+template<size_t NBuckets = 32>
+class LogHistogram
+{
+public:
+    struct Snapshot
+    {
+        std::array<uint64_t, NBuckets> buckets{};
+        uint64_t count = 0;
+        uint64_t sum = 0;
+
+        /**
+         * @brief Values recorded after `earlier` was taken
+         */
+        Snapshot since(const Snapshot &earlier) const
+        {
+            Snapshot diff;
+            for (size_t i = 0; i != NBuckets; ++i) {
+                diff.buckets[i] = buckets[i] - earlier.buckets[i];
+            }
+            diff.count = count - earlier.count;
+            diff.sum = sum - earlier.sum;
+            return diff;
+        }
+
+        /**
+         * @brief Upper bound of the bucket holding the `q` quantile, 0 if nothing recorded
+         */
+        uint64_t quantile(double q) const
+        {
+            if (count == 0) {
+                return 0;
+            }
+            auto rank = static_cast<uint64_t>(q * (count - 1));
+            uint64_t seen = 0;
+            for (size_t i = 0; i != NBuckets; ++i) {
+                seen += buckets[i];
+                if (seen > rank) {
+                    return i == 0 ? 0 : (uint64_t{1} << i) - 1;
+                }
+            }
+            return (uint64_t{1} << (NBuckets - 1)) - 1;
+        }
+    };
+
+    void record(uint64_t value) noexcept
+    {
+        m_buckets[bucketOf(value)].fetch_add(1, std::memory_order_relaxed);
+        m_count.fetch_add(1, std::memory_order_relaxed);
+        m_sum.fetch_add(value, std::memory_order_relaxed);
+    }
+
+    /**
+     * @brief Copy of the buckets. Not atomic as a whole, records racing with it may be partly seen.
+     */
+    Snapshot snapshot() const noexcept
+    {
+        Snapshot snap;
+        for (size_t i = 0; i != NBuckets; ++i) {
+            snap.buckets[i] = m_buckets[i].load(std::memory_order_relaxed);
+        }
+        snap.count = m_count.load(std::memory_order_relaxed);
+        snap.sum = m_sum.load(std::memory_order_relaxed);
+        return snap;
+    }
+
+private:
+    static size_t bucketOf(uint64_t value) noexcept
+    {
+        size_t width = 0;
+        while (value) {
+            value >>= 1;
+            ++width;
+        }
+        return width < NBuckets ? width : NBuckets - 1;
+    }
+
+    std::array<std::atomic_uint_fast64_t, NBuckets> m_buckets{};
+    std::atomic_uint_fast64_t m_count{0};
+    std::atomic_uint_fast64_t m_sum{0};
+};
+
+} // namespace sstl
+
+#endif // SALUS_SSTL_STATSUTILS_H
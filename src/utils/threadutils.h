@@ -263,6 +263,19 @@ public:
     void notify();
     bool notified();
     void wait();
+
+    /**
+     * @brief Like wait, but gives up after `timeout`.
+     * @returns true if notified
+     */
+    template<typename Rep, typename Period>
+    bool wait_for(const std::chrono::duration<Rep, Period> &timeout)
+    {
+        auto g = with_uguard(m_mu);
+        auto notified = m_cv.wait_for(g, timeout, [this]() { return m_notified; });
+        m_notified = false;
+        return notified;
+    }
 };
 
 } // namespace sstl
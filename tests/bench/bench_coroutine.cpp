@@ -0,0 +1,116 @@
+/*
+ * Copyright 2019 Peifeng Yu <peifeng@umich.edu>
+ * 
+ * This file is part of Salus
+ * (see https://github.com/SymbioticLab/Salus).
+ * 
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * 
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "execution/threadpool/awaitable.h"
+#include "support/alloccounter.h"
+#include "utils/coroutineutils.h"
+#include "utils/threadutils.h"
+
+#include <benchmark/benchmark.h>
+
+#include <functional>
+
+using salus::test::numAllocations;
+
+namespace {
+
+constexpr int kHops = 64;
+
+/**
+ * Callback style: each async step takes the completion of its caller, and wraps it in
+ * a std::function of its own.
+ */
+void callbackHop(ThreadPool &pool, int left, std::function<void(int)> done)
+{
+    if (left == 0) {
+        done(0);
+        return;
+    }
+    pool.run([&pool, left, done = std::move(done)]() mutable {
+        callbackHop(pool, left - 1, [done = std::move(done)](int hops) { done(hops + 1); });
+    });
+}
+
+/**
+ * The same chain with a coroutine for each step
+ */
+sstl::Task<int> coroutineHop(ThreadPool &pool, int left)
+{
+    if (left == 0) {
+        co_return 0;
+    }
+    co_await scheduleOn(pool);
+    co_return 1 + co_await coroutineHop(pool, left - 1);
+}
+
+/**
+ * A single coroutine written linearly
+ */
+sstl::Task<int> linearHops(ThreadPool &pool, int hops)
+{
+    for (int i = 0; i != hops; ++i) {
+        co_await scheduleOn(pool);
+    }
+    co_return hops;
+}
+
+template<typename Run>
+void runHops(benchmark::State &state, Run &&run)
+{
+    ThreadPool pool(ThreadPoolOptions{}.setNumThreads(1));
+    // the pool allocates while warming up
+    run(pool);
+
+    auto before = numAllocations();
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(run(pool));
+    }
+    state.SetItemsProcessed(state.iterations() * kHops);
+    state.counters["allocs_per_hop"] = benchmark::Counter(static_cast<double>(numAllocations() - before) / kHops,
+                                                          benchmark::Counter::kAvgIterations);
+}
+
+void BM_CallbackHops(benchmark::State &state)
+{
+    runHops(state, [](auto &pool) {
+        sstl::notification finished;
+        int result = 0;
+        callbackHop(pool, kHops, [&](int hops) {
+            result = hops;
+            finished.notify();
+        });
+        finished.wait();
+        return result;
+    });
+}
+BENCHMARK(BM_CallbackHops)->UseRealTime();
+
+void BM_CoroutineHops(benchmark::State &state)
+{
+    runHops(state, [](auto &pool) { return sstl::syncWait(coroutineHop(pool, kHops)); });
+}
+BENCHMARK(BM_CoroutineHops)->UseRealTime();
+
+void BM_LinearCoroutineHops(benchmark::State &state)
+{
+    runHops(state, [](auto &pool) { return sstl::syncWait(linearHops(pool, kHops)); });
+}
+BENCHMARK(BM_LinearCoroutineHops)->UseRealTime();
+
+} // namespace
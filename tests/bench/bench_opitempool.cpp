@@ -0,0 +1,89 @@
+/*
+ * Copyright 2019 Peifeng Yu <peifeng@umich.edu>
+ * 
+ * This file is part of Salus
+ * (see https://github.com/SymbioticLab/Salus).
+ * 
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * 
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "execution/engine/iterationcontext.h"
+#include "support/alloccounter.h"
+#include "support/fakeexecution.h"
+
+#include <benchmark/benchmark.h>
+
+#include <atomic>
+#include <memory>
+
+using namespace salus;
+using namespace salus::test;
+
+namespace {
+
+template<typename Make>
+void runOpItemAlloc(benchmark::State &state, Make &&make)
+{
+    auto sess = std::make_shared<SessionItem>("bench");
+    auto before = numAllocations();
+    for (auto _ : state) {
+        auto item = make(sess);
+        item->sess = sess;
+        benchmark::DoNotOptimize(item.get());
+    }
+    state.counters["allocs_per_op"] = benchmark::Counter(
+        static_cast<double>(numAllocations() - before), benchmark::Counter::kAvgIterations);
+}
+
+void BM_OpItemMakeShared(benchmark::State &state)
+{
+    runOpItemAlloc(state, [](const auto &) { return std::make_shared<OperationItem>(); });
+}
+BENCHMARK(BM_OpItemMakeShared);
+
+void BM_OpItemPooled(benchmark::State &state)
+{
+    runOpItemAlloc(state, [](const auto &sess) {
+        return std::allocate_shared<OperationItem>(sstl::PoolAllocator<OperationItem>(sess->opItemPool));
+    });
+}
+BENCHMARK(BM_OpItemPooled);
+
+/**
+ * The whole path of a tiny CPU op: scheduled through IterationContext, placed by a
+ * scheduling pass, run in the pool and recycled.
+ */
+void BM_ScheduleAndRunOp(benchmark::State &state)
+{
+    ExecutorHarness h(1_sz << 30);
+    auto sess = h.addSession("bench");
+    IterationContext ictx(h.executor(), sess, {});
+    h.executor().runSchedulingPass();
+
+    std::atomic<int64_t> done{0};
+    int64_t queued = 0;
+    auto before = numAllocations();
+    for (auto _ : state) {
+        ictx.scheduleTask(h.makeOp(64, [&done]() { done.fetch_add(1, std::memory_order_relaxed); }));
+        ++queued;
+        h.executor().runSchedulingPass();
+    }
+    h.runUntil([&]() { return done.load() == queued; });
+
+    state.SetItemsProcessed(queued);
+    state.counters["allocs_per_op"] = benchmark::Counter(
+        static_cast<double>(numAllocations() - before), benchmark::Counter::kAvgIterations);
+}
+BENCHMARK(BM_ScheduleAndRunOp)->UseRealTime();
+
+} // namespace
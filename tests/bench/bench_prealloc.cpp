@@ -0,0 +1,158 @@
+/*
+ * Copyright 2019 Peifeng Yu <peifeng@umich.edu>
+ * 
+ * This file is part of Salus
+ * (see https://github.com/SymbioticLab/Salus).
+ * 
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * 
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "support/fakeexecution.h"
+
+#include <benchmark/benchmark.h>
+
+#include <atomic>
+#include <chrono>
+#include <future>
+#include <optional>
+#include <vector>
+
+using namespace salus;
+using namespace salus::test;
+
+namespace {
+
+/**
+ * Reserving for `range(0)` ready ops the way submitTask does, taking the monitor lock per op.
+ */
+void BM_PreAllocatePerOp(benchmark::State &state)
+{
+    ResourceMonitor resMon;
+    resMon.initializeLimits({{resources::CPU0Memory, 1_sz << 40}});
+    const Resources usage{{resources::CPU0Memory, 1024}};
+
+    std::vector<uint64_t> tickets;
+    tickets.reserve(state.range(0));
+    uint64_t locks = 0;
+    for (auto _ : state) {
+        auto before = resMon.lockAcquisitions();
+        for (int64_t i = 0; i != state.range(0); ++i) {
+            Resources missing;
+            tickets.emplace_back(*resMon.preAllocate(usage, &missing));
+        }
+        locks += resMon.lockAcquisitions() - before;
+        state.PauseTiming();
+        for (auto t : tickets) {
+            resMon.freeStaging(t);
+        }
+        tickets.clear();
+        state.ResumeTiming();
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+    state.counters["locks_per_batch"] = benchmark::Counter(static_cast<double>(locks),
+                                                           benchmark::Counter::kAvgIterations);
+}
+BENCHMARK(BM_PreAllocatePerOp)->Arg(1)->Arg(16)->Arg(256);
+
+/**
+ * The same reservations the way submitTaskBatch does, under one LockedProxy.
+ */
+void BM_PreAllocateBatch(benchmark::State &state)
+{
+    ResourceMonitor resMon;
+    resMon.initializeLimits({{resources::CPU0Memory, 1_sz << 40}});
+    const Resources usage{{resources::CPU0Memory, 1024}};
+
+    std::vector<uint64_t> tickets;
+    tickets.reserve(state.range(0));
+    uint64_t locks = 0;
+    for (auto _ : state) {
+        auto before = resMon.lockAcquisitions();
+        {
+            auto proxy = resMon.lock();
+            for (int64_t i = 0; i != state.range(0); ++i) {
+                Resources missing;
+                tickets.emplace_back(*proxy.preAllocate(usage, &missing));
+            }
+        }
+        locks += resMon.lockAcquisitions() - before;
+        state.PauseTiming();
+        for (auto t : tickets) {
+            resMon.freeStaging(t);
+        }
+        tickets.clear();
+        state.ResumeTiming();
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+    state.counters["locks_per_batch"] = benchmark::Counter(static_cast<double>(locks),
+                                                           benchmark::Counter::kAvgIterations);
+}
+BENCHMARK(BM_PreAllocateBatch)->Arg(1)->Arg(16)->Arg(256);
+
+/**
+ * A full scheduling pass admitting `range(0)` ready ops of one session, with the batch path
+ * or submitting one op at a time. Estimating each op takes `range(1)` us. Ops are held until
+ * the pass is over, so only the pass itself takes the monitor lock while measuring.
+ *
+ * Built with SALUS_ENABLE_PARALLEL_SCHED in salus-bench-parallel, where the batch path estimates
+ * 32 or more ops on the thread pool; compare the two binaries for the crossover.
+ */
+template<bool Batch>
+void BM_SchedulingPassReadyOps(benchmark::State &state)
+{
+    ExecutorHarness h(1_sz << 40);
+    h.schedulingParam().batchSubmit = Batch;
+    auto sess = h.addSession("bench");
+    h.executor().runSchedulingPass();
+
+    auto &resMon = h.resourceMonitor();
+    auto idle = [&resMon, full = resMon.lock().denseAvailable()]() {
+        return resMon.lock().denseAvailable().contains(full);
+    };
+    std::atomic<int64_t> done{0};
+    int64_t queued = 0;
+    uint64_t locks = 0;
+    for (auto _ : state) {
+        state.PauseTiming();
+        std::promise<void> gate;
+        auto opened = gate.get_future().share();
+        for (int64_t i = 0; i != state.range(0); ++i) {
+            auto op = h.makeOp(1024, [&done, opened]() {
+                opened.wait();
+                done.fetch_add(1, std::memory_order_relaxed);
+            });
+            op->estimateDelay = std::chrono::microseconds(state.range(1));
+            h.queue(sess, std::move(op));
+        }
+        queued += state.range(0);
+        state.ResumeTiming();
+
+        auto before = resMon.lockAcquisitions();
+        h.executor().runSchedulingPass();
+        locks += resMon.lockAcquisitions() - before;
+
+        state.PauseTiming();
+        gate.set_value();
+        // finished ops return their tickets, wait for that too so they don't count in the next pass
+        h.runUntil([&]() { return done.load() == queued; });
+        ExecutorHarness::waitFor(idle);
+        state.ResumeTiming();
+    }
+    state.SetItemsProcessed(queued);
+    state.counters["locks_per_pass"] = benchmark::Counter(static_cast<double>(locks),
+                                                          benchmark::Counter::kAvgIterations);
+}
+BENCHMARK_TEMPLATE(BM_SchedulingPassReadyOps, true)->ArgsProduct({{16, 32, 256}, {0, 5}})->UseRealTime();
+BENCHMARK_TEMPLATE(BM_SchedulingPassReadyOps, false)->Args({16, 0})->Args({256, 0})->UseRealTime();
+
+} // namespace
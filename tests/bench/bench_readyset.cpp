@@ -0,0 +1,67 @@
+/*
+ * Copyright 2019 Peifeng Yu <peifeng@umich.edu>
+ * 
+ * This file is part of Salus
+ * (see https://github.com/SymbioticLab/Salus).
+ * 
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * 
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "support/fakeexecution.h"
+
+#include <benchmark/benchmark.h>
+
+#include <atomic>
+#include <string>
+#include <vector>
+
+using namespace salus;
+using namespace salus::test;
+
+namespace {
+
+/**
+ * One scheduling pass with `range(0)` idle sessions and 4 busy ones, each busy session
+ * getting one new op per pass.
+ */
+void BM_SchedulingPassIdleSessions(benchmark::State &state)
+{
+    ExecutorHarness h(1_sz << 30);
+
+    for (int64_t i = 0; i != state.range(0); ++i) {
+        h.addSession("idle" + std::to_string(i));
+    }
+    std::vector<PSessionItem> busy;
+    for (int i = 0; i != 4; ++i) {
+        busy.emplace_back(h.addSession("busy" + std::to_string(i)));
+    }
+    // accept sessions
+    h.executor().runSchedulingPass();
+
+    std::atomic<int64_t> done{0};
+    int64_t queued = 0;
+    for (auto _ : state) {
+        for (auto &sess : busy) {
+            h.queue(sess, 1024, [&done]() { done.fetch_add(1, std::memory_order_relaxed); });
+        }
+        queued += static_cast<int64_t>(busy.size());
+        h.executor().runSchedulingPass();
+    }
+
+    // outside of the timed loop
+    h.runUntil([&]() { return done.load() == queued; });
+    state.SetItemsProcessed(queued);
+}
+BENCHMARK(BM_SchedulingPassIdleSessions)->Arg(0)->Arg(100)->Arg(1000)->UseRealTime();
+
+} // namespace
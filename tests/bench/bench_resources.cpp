@@ -0,0 +1,129 @@
+/*
+ * Copyright 2019 Peifeng Yu <peifeng@umich.edu>
+ * 
+ * This file is part of Salus
+ * (see https://github.com/SymbioticLab/Salus).
+ * 
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * 
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "resources/resources.h"
+
+#include <benchmark/benchmark.h>
+
+#include <type_traits>
+#include <vector>
+
+using namespace salus;
+
+namespace {
+
+// Every benchmark runs twice: on the map, and on the dense form the scheduler keeps
+template<bool Dense>
+using Res = std::conditional_t<Dense, DenseResources, Resources>;
+
+/**
+ * A GPU op's usage: memory on both sides and a stream
+ */
+template<bool Dense>
+Res<Dense> opUsage(size_t scale)
+{
+    Resources res{
+        {resources::CPU0Memory, 64 * scale},
+        {{ResourceType::MEMORY, devices::GPU0}, 1024 * scale},
+        {{ResourceType::GPU_STREAM, devices::GPU0}, 1},
+    };
+    if constexpr (Dense) {
+        return DenseResources(res);
+    } else {
+        return res;
+    }
+}
+
+template<bool Dense>
+void BM_ResourcesContains(benchmark::State &state)
+{
+    const auto avail = opUsage<Dense>(1_sz << 20);
+    const auto req = opUsage<Dense>(1);
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(resources::contains(avail, req));
+    }
+}
+BENCHMARK_TEMPLATE(BM_ResourcesContains, false);
+BENCHMARK_TEMPLATE(BM_ResourcesContains, true);
+
+template<bool Dense>
+void BM_ResourcesMergeSubtract(benchmark::State &state)
+{
+    auto avail = opUsage<Dense>(1_sz << 20);
+    const auto req = opUsage<Dense>(1);
+    for (auto _ : state) {
+        resources::subtract(avail, req);
+        resources::merge(avail, req);
+        benchmark::DoNotOptimize(avail);
+    }
+}
+BENCHMARK_TEMPLATE(BM_ResourcesMergeSubtract, false);
+BENCHMARK_TEMPLATE(BM_ResourcesMergeSubtract, true);
+
+/**
+ * Admitting `range(0)` ops against a headroom, the way submitTaskBatch does after reserving for its head
+ */
+template<bool Dense>
+void BM_HeadroomAdmission(benchmark::State &state)
+{
+    const auto limits = opUsage<Dense>(static_cast<size_t>(state.range(0)) / 2);
+    std::vector<Res<Dense>> usages;
+    for (int64_t i = 0; i != state.range(0); ++i) {
+        usages.emplace_back(opUsage<Dense>(1 + static_cast<size_t>(i) % 3));
+    }
+
+    for (auto _ : state) {
+        auto headroom = limits;
+        int64_t admitted = 0;
+        for (const auto &usage : usages) {
+            if (resources::contains(headroom, usage)) {
+                resources::subtractBounded(headroom, usage);
+                ++admitted;
+            }
+        }
+        benchmark::DoNotOptimize(admitted);
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK_TEMPLATE(BM_HeadroomAdmission, false)->Arg(16)->Arg(256);
+BENCHMARK_TEMPLATE(BM_HeadroomAdmission, true)->Arg(16)->Arg(256);
+
+/**
+ * One op's life in the monitor: reserve, allocate from the reservation, free, release the rest.
+ * The map version pays for converting at every call.
+ */
+template<bool Dense>
+void BM_MonitorOpCycle(benchmark::State &state)
+{
+    ResourceMonitor resMon;
+    resMon.initializeLimits(opUsage<false>(1_sz << 20));
+    const auto usage = opUsage<Dense>(2);
+    const auto alloc = opUsage<Dense>(1);
+
+    for (auto _ : state) {
+        auto ticket = *resMon.preAllocate(usage, nullptr);
+        resMon.allocate(ticket, alloc);
+        resMon.free(ticket, alloc);
+        resMon.freeStaging(ticket);
+    }
+}
+BENCHMARK_TEMPLATE(BM_MonitorOpCycle, false);
+BENCHMARK_TEMPLATE(BM_MonitorOpCycle, true);
+
+} // namespace
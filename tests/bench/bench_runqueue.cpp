@@ -0,0 +1,90 @@
+/*
+ * Copyright 2019 Peifeng Yu <peifeng@umich.edu>
+ * 
+ * This file is part of Salus
+ * (see https://github.com/SymbioticLab/Salus).
+ * 
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * 
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "utils/fixed_function.hpp"
+
+#include <benchmark/benchmark.h>
+
+#include <array>
+#include <memory>
+#include <mutex>
+
+#include "execution/threadpool/RunQueue.h"
+
+namespace {
+
+constexpr unsigned kQueueSize = 1024;
+constexpr int kBatch = 256;
+
+template<size_t Inline>
+using Closure = sstl::FixedFunction<void(), Inline>;
+
+/**
+ * A closure capturing Capture bytes
+ */
+template<size_t Capture>
+struct Work
+{
+    uint64_t *sum;
+    std::array<char, Capture - sizeof(uint64_t *)> payload;
+
+    void operator()()
+    {
+        *sum += payload[0];
+    }
+};
+
+/**
+ * Push a batch of closures capturing `Capture` bytes to a RunQueue of closures with `Inline` bytes of
+ * inline storage, then pop and run all of them, as a worker does with its own queue.
+ * Reports the size of a queue slot, which is what the inline size costs every queue.
+ */
+template<size_t Inline, size_t Capture>
+void BM_RunQueuePushPop(benchmark::State &state)
+{
+    using Queue = RunQueue<Closure<Inline>, kQueueSize>;
+    auto q = std::make_unique<Queue>();
+
+    uint64_t sum = 0;
+    Work<Capture> work{&sum, {1}};
+    for (auto _ : state) {
+        for (int i = 0; i != kBatch; ++i) {
+            auto rejected = q->PushFront(work);
+            benchmark::DoNotOptimize(rejected);
+        }
+        while (auto c = q->PopFront()) {
+            c();
+        }
+    }
+    benchmark::DoNotOptimize(sum);
+    state.SetItemsProcessed(state.iterations() * kBatch);
+    state.counters["slot_bytes"] = static_cast<double>(sizeof(Queue)) / kQueueSize;
+    state.counters["spilled"] = Closure<Inline>::template fits_inline<Work<Capture>> ? 0 : 1;
+}
+
+BENCHMARK_TEMPLATE(BM_RunQueuePushPop, 32, 16);
+BENCHMARK_TEMPLATE(BM_RunQueuePushPop, 64, 16);
+BENCHMARK_TEMPLATE(BM_RunQueuePushPop, 128, 16);
+BENCHMARK_TEMPLATE(BM_RunQueuePushPop, 256, 16);
+BENCHMARK_TEMPLATE(BM_RunQueuePushPop, 32, 96);
+BENCHMARK_TEMPLATE(BM_RunQueuePushPop, 64, 96);
+BENCHMARK_TEMPLATE(BM_RunQueuePushPop, 128, 96);
+BENCHMARK_TEMPLATE(BM_RunQueuePushPop, 256, 96);
+
+} // namespace
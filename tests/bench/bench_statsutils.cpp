@@ -0,0 +1,64 @@
+/*
+ * Copyright 2019 Peifeng Yu <peifeng@umich.edu>
+ * 
+ * This file is part of Salus
+ * (see https://github.com/SymbioticLab/Salus).
+ * 
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * 
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "utils/statsutils.h"
+
+#include <benchmark/benchmark.h>
+
+#include <atomic>
+#include <thread>
+
+namespace {
+
+std::atomic_uint_fast64_t sharedCounter{0};
+sstl::StripedCounter<> stripedCounter;
+sstl::LogHistogram<> histogram;
+
+/**
+ * All threads bumping one atomic, what the counters replace.
+ */
+void BM_SharedAtomicAdd(benchmark::State &state)
+{
+    for (auto _ : state) {
+        sharedCounter.fetch_add(1, std::memory_order_relaxed);
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_SharedAtomicAdd)->ThreadRange(1, std::thread::hardware_concurrency())->UseRealTime();
+
+void BM_StripedCounterAdd(benchmark::State &state)
+{
+    for (auto _ : state) {
+        stripedCounter.add();
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_StripedCounterAdd)->ThreadRange(1, std::thread::hardware_concurrency())->UseRealTime();
+
+void BM_LogHistogramRecord(benchmark::State &state)
+{
+    uint64_t v = 0;
+    for (auto _ : state) {
+        histogram.record(v++ & 0xffff);
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_LogHistogramRecord)->ThreadRange(1, std::thread::hardware_concurrency())->UseRealTime();
+
+} // namespace
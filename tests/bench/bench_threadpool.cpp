@@ -0,0 +1,289 @@
+/*
+ * Copyright 2019 Peifeng Yu <peifeng@umich.edu>
+ * 
+ * This file is part of Salus
+ * (see https://github.com/SymbioticLab/Salus).
+ * 
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * 
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "execution/threadpool/threadpool.h"
+
+#include <benchmark/benchmark.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <ctime>
+#include <thread>
+#include <vector>
+
+namespace {
+
+constexpr int64_t kClosuresPerBatch = 1024;
+
+/**
+ * Submit a batch of tiny closures from outside of the pool with `submit` and wait for all of them,
+ * on a pool of `range(0)` workers.
+ */
+template<typename Submit>
+void runClosures(benchmark::State &state, Submit &&submit)
+{
+    ThreadPool pool(ThreadPoolOptions{}.setNumThreads(state.range(0)));
+
+    std::atomic<int64_t> done{0};
+    int64_t expected = 0;
+    for (auto _ : state) {
+        for (int64_t i = 0; i != kClosuresPerBatch; ++i) {
+            submit(pool, i, [&done]() { done.fetch_add(1, std::memory_order_relaxed); });
+        }
+        expected += kClosuresPerBatch;
+        while (done.load(std::memory_order_acquire) != expected) {
+            std::this_thread::yield();
+        }
+    }
+    state.SetItemsProcessed(expected);
+}
+
+/**
+ * Only the default level in use, what the pool costs everyone who doesn't use priorities.
+ */
+void BM_PoolSingleLevel(benchmark::State &state)
+{
+    runClosures(state, [](auto &pool, auto, auto &&f) { pool.run(std::move(f)); });
+}
+BENCHMARK(BM_PoolSingleLevel)->Arg(1)->Arg(4)->UseRealTime();
+
+void BM_PoolTwoLevels(benchmark::State &state)
+{
+    runClosures(state, [](auto &pool, auto i, auto &&f) {
+        pool.run(std::move(f), i % 2 ? ThreadPool::Priority::High : ThreadPool::Priority::Normal);
+    });
+}
+BENCHMARK(BM_PoolTwoLevels)->Arg(1)->Arg(4)->UseRealTime();
+
+/**
+ * A closure running in the pool submits a batch to its own worker queue. No handoff between
+ * threads, so this is mostly the cost of pushing and picking closures.
+ */
+void BM_PoolLocalPushPop(benchmark::State &state)
+{
+    ThreadPool pool(ThreadPoolOptions{}.setNumThreads(1));
+
+    // stay clear of the queue capacity, a full queue runs closures inline
+    constexpr int64_t kLocalBatch = 512;
+    std::atomic<int64_t> done{0};
+    int64_t expected = 0;
+    for (auto _ : state) {
+        pool.run([&pool, &done]() {
+            for (int64_t i = 0; i != kLocalBatch; ++i) {
+                pool.run([&done]() { done.fetch_add(1, std::memory_order_relaxed); });
+            }
+        });
+        expected += kLocalBatch;
+        while (done.load(std::memory_order_acquire) != expected) {
+            std::this_thread::yield();
+        }
+    }
+    state.SetItemsProcessed(expected);
+}
+BENCHMARK(BM_PoolLocalPushPop)->UseRealTime();
+
+/**
+ * Hand `range(0)` closures to a 2 worker pool at once, as the scheduler does after a pass,
+ * either one by one with run() or with a single runBatch(), and wait for all of them.
+ */
+template<typename Submit>
+void submitBatch(benchmark::State &state, Submit &&submit)
+{
+    ThreadPool pool(ThreadPoolOptions{}.setNumThreads(2));
+
+    const auto batch = state.range(0);
+    std::atomic<int64_t> done{0};
+    int64_t expected = 0;
+    std::vector<ThreadPool::Closure> closures;
+    closures.reserve(batch);
+    for (auto _ : state) {
+        for (int64_t i = 0; i != batch; ++i) {
+            closures.emplace_back([&done]() { done.fetch_add(1, std::memory_order_relaxed); });
+        }
+        submit(pool, closures);
+        closures.clear();
+        expected += batch;
+        while (done.load(std::memory_order_acquire) != expected) {
+            std::this_thread::yield();
+        }
+    }
+    state.SetItemsProcessed(expected);
+}
+
+void BM_PoolRunEach(benchmark::State &state)
+{
+    submitBatch(state, [](auto &pool, auto &closures) {
+        for (auto &c : closures) {
+            pool.run(std::move(c));
+        }
+    });
+}
+BENCHMARK(BM_PoolRunEach)->RangeMultiplier(4)->Range(8, 1024)->UseRealTime();
+
+void BM_PoolRunBatch(benchmark::State &state)
+{
+    submitBatch(state, [](auto &pool, auto &closures) { pool.runBatch(closures); });
+}
+BENCHMARK(BM_PoolRunBatch)->RangeMultiplier(4)->Range(8, 1024)->UseRealTime();
+
+/**
+ * Submit a single closure to a 2 worker pool after it has been idle for `range(1)` microseconds,
+ * with fixed (`range(0)` == 0) or adaptive spinning. Reports the time until the closure starts,
+ * and as idle_cpu, the cores the pool keeps busy while it has nothing to do.
+ */
+void BM_PoolWakeup(benchmark::State &state)
+{
+    using namespace std::chrono;
+    ThreadPool pool(ThreadPoolOptions{}.setNumThreads(2).setAdaptiveSpinning(state.range(0) != 0));
+
+    const auto gap = microseconds(state.range(1));
+    double idleCpu = 0;
+    double idleWall = 0;
+    for (auto _ : state) {
+        auto cpu0 = std::clock();
+        auto wall0 = steady_clock::now();
+        std::this_thread::sleep_for(gap);
+        idleCpu += static_cast<double>(std::clock() - cpu0) / CLOCKS_PER_SEC;
+        idleWall += duration<double>(steady_clock::now() - wall0).count();
+
+        std::atomic<bool> ran{false};
+        steady_clock::time_point started;
+        auto submitted = steady_clock::now();
+        pool.run([&ran, &started]() {
+            started = steady_clock::now();
+            ran.store(true, std::memory_order_release);
+        });
+        while (!ran.load(std::memory_order_acquire)) {
+            std::this_thread::yield();
+        }
+        state.SetIterationTime(duration<double>(started - submitted).count());
+    }
+    state.counters["idle_cpu"] = idleWall > 0 ? idleCpu / idleWall : 0;
+}
+BENCHMARK(BM_PoolWakeup)
+    ->ArgNames({"adaptive", "idle_us"})
+    ->ArgsProduct({{0, 1}, {10, 200, 2000}})
+    // manual time only counts the wakeups, fix the iterations so the idle gaps stay bounded
+    ->Iterations(500)
+    ->UseManualTime();
+
+/**
+ * Memory bound closures: each one sums a 1MB slice of a 64MB buffer, on a pool of one worker per CPU
+ * pinned as `range(0)` says. Placement and same-node stealing only matter on multi-node machines,
+ * elsewhere all affinities should be on par.
+ */
+void BM_PoolMemoryBound(benchmark::State &state)
+{
+    const auto affinity = static_cast<ThreadPoolOptions::Affinity>(state.range(0));
+    const size_t threads = std::max(1u, std::thread::hardware_concurrency());
+    ThreadPool pool(ThreadPoolOptions{}.setNumThreads(threads).setAffinity(affinity));
+
+    constexpr size_t kSlice = (1 << 20) / sizeof(uint64_t);
+    constexpr size_t kSlices = 64;
+    std::vector<uint64_t> buffer(kSlice * kSlices, 1);
+
+    std::atomic<uint64_t> sum{0};
+    std::atomic<size_t> done{0};
+    size_t expected = 0;
+    for (auto _ : state) {
+        for (size_t i = 0; i != kSlices; ++i) {
+            pool.run([&buffer, &sum, &done, i]() {
+                uint64_t s = 0;
+                for (size_t j = i * kSlice; j != (i + 1) * kSlice; ++j) {
+                    s += buffer[j];
+                }
+                sum.fetch_add(s, std::memory_order_relaxed);
+                done.fetch_add(1, std::memory_order_release);
+            });
+        }
+        expected += kSlices;
+        while (done.load(std::memory_order_acquire) != expected) {
+            std::this_thread::yield();
+        }
+    }
+    benchmark::DoNotOptimize(sum.load());
+    state.SetBytesProcessed(static_cast<int64_t>(expected * kSlice * sizeof(uint64_t)));
+}
+BENCHMARK(BM_PoolMemoryBound)
+    ->ArgName("affinity")
+    ->Arg(static_cast<int>(ThreadPoolOptions::Affinity::None))
+    ->Arg(static_cast<int>(ThreadPoolOptions::Affinity::Compact))
+    ->Arg(static_cast<int>(ThreadPoolOptions::Affinity::Scatter))
+    ->UseRealTime();
+
+/**
+ * Compute bound parallelFor over 64k items on `range(0)` workers, from one worker up to one per CPU.
+ * The nested variant runs a small parallelFor inside each outer subrange.
+ */
+template<bool Nested>
+void BM_ParallelForScaling(benchmark::State &state)
+{
+    ThreadPool pool(ThreadPoolOptions{}.setNumThreads(state.range(0)));
+
+    constexpr size_t kItems = 1 << 16;
+    constexpr size_t kInner = 16;
+    auto work = [](size_t i) {
+        uint64_t x = i;
+        for (int k = 0; k != 64; ++k) {
+            x = x * 6364136223846793005ull + 1442695040888963407ull;
+        }
+        return x;
+    };
+
+    std::atomic<uint64_t> sum{0};
+    for (auto _ : state) {
+        if constexpr (Nested) {
+            pool.parallelFor(0, kItems / kInner, 0, [&](size_t first, size_t last) {
+                for (auto i = first; i != last; ++i) {
+                    pool.parallelFor(0, kInner, 0, [&, i](size_t f, size_t l) {
+                        uint64_t s = 0;
+                        for (auto j = f; j != l; ++j) {
+                            s += work(i * kInner + j);
+                        }
+                        sum.fetch_add(s, std::memory_order_relaxed);
+                    });
+                }
+            });
+        } else {
+            pool.parallelFor(0, kItems, 0, [&](size_t first, size_t last) {
+                uint64_t s = 0;
+                for (auto i = first; i != last; ++i) {
+                    s += work(i);
+                }
+                sum.fetch_add(s, std::memory_order_relaxed);
+            });
+        }
+    }
+    benchmark::DoNotOptimize(sum.load());
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations() * kItems));
+}
+
+void threadCounts(benchmark::internal::Benchmark *b)
+{
+    const int cpus = std::max(1u, std::thread::hardware_concurrency());
+    for (int n = 1; n < cpus; n *= 2) {
+        b->Arg(n);
+    }
+    b->Arg(cpus);
+}
+BENCHMARK_TEMPLATE(BM_ParallelForScaling, false)->Apply(threadCounts)->UseRealTime();
+BENCHMARK_TEMPLATE(BM_ParallelForScaling, true)->Apply(threadCounts)->UseRealTime();
+
+} // namespace
@@ -0,0 +1,36 @@
+/*
+ * Copyright 2019 Peifeng Yu <peifeng@umich.edu>
+ * 
+ * This file is part of Salus
+ * (see https://github.com/SymbioticLab/Salus).
+ * 
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * 
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef SALUS_TESTS_ALLOCCOUNTER_H
+#define SALUS_TESTS_ALLOCCOUNTER_H
+
+#include <atomic>
+#include <cstdint>
+
+namespace salus::test {
+
+/**
+ * @brief Number of global operator new calls so far. Only counted in binaries linking
+ * bench/alloccounter.cpp, which replaces the global allocation functions.
+ */
+uint64_t numAllocations();
+
+} // namespace salus::test
+
+#endif // SALUS_TESTS_ALLOCCOUNTER_H
@@ -0,0 +1,287 @@
+/*
+ * Copyright 2019 Peifeng Yu <peifeng@umich.edu>
+ * 
+ * This file is part of Salus
+ * (see https://github.com/SymbioticLab/Salus).
+ * 
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * 
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef SALUS_TESTS_FAKEEXECUTION_H
+#define SALUS_TESTS_FAKEEXECUTION_H
+
+#include "execution/engine/resourcecontext.h"
+#include "execution/engine/taskexecutor.h"
+#include "execution/operationtask.h"
+#include "execution/scheduler/operationitem.h"
+#include "execution/scheduler/schedulingparam.h"
+#include "execution/scheduler/sessionitem.h"
+#include "execution/threadpool/threadpool.h"
+#include "resources/resources.h"
+
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace salus::test {
+
+/**
+ * @brief An op that needs a fixed amount of memory on its device and runs `body` inline.
+ */
+class FakeOpTask : public OperationTask
+{
+public:
+    using Body = std::function<void()>;
+
+    explicit FakeOpTask(size_t memory, Body body = {}, std::atomic<int> *live = nullptr)
+        : m_memory(memory)
+        , m_body(std::move(body))
+        , m_live(live)
+    {
+        if (m_live) {
+            m_live->fetch_add(1);
+        }
+    }
+
+    ~FakeOpTask() override
+    {
+        // resource context goes first, it returns the ticket to the monitor
+        m_rctx.reset();
+        if (m_live) {
+            m_live->fetch_sub(1);
+        }
+    }
+
+    std::string DebugString() const override
+    {
+        return "FakeOpTask";
+    }
+
+    uint64_t graphId() const override
+    {
+        return 1;
+    }
+
+    std::string opType() const override
+    {
+        return "Fake";
+    }
+
+    Resources estimatedUsage(const DeviceSpec &dev) override
+    {
+        estimateCalls.fetch_add(1);
+        // stands in for shape inference, which is what makes estimating real ops expensive
+        auto until = std::chrono::steady_clock::now() + estimateDelay;
+        while (std::chrono::steady_clock::now() < until) {
+        }
+        return {{{ResourceType::MEMORY, dev}, m_memory}};
+    }
+
+    bool hasExactEstimation(const DeviceSpec &) override
+    {
+        return true;
+    }
+
+    DeviceTypes supportedDeviceTypes() const override
+    {
+        return m_types;
+    }
+
+    int failedTimes() const override
+    {
+        return 0;
+    }
+
+    bool prepare(std::unique_ptr<ResourceContext> &&rctx) noexcept override
+    {
+        if (refusals > 0) {
+            --refusals;
+            return false;
+        }
+        m_rctx = std::move(rctx);
+        return true;
+    }
+
+    ResourceContext &resourceContext() const override
+    {
+        return *m_rctx;
+    }
+
+    bool isAsync() const override
+    {
+        return false;
+    }
+
+    void run(Callbacks cbs) noexcept override
+    {
+        if (onRun) {
+            onRun(*m_rctx);
+        }
+        if (m_body) {
+            m_body();
+        }
+        cbs.done();
+    }
+
+    void cancel() override
+    {
+    }
+
+    FakeOpTask &setDeviceTypes(std::vector<DeviceType> types)
+    {
+        m_types = std::move(types);
+        return *this;
+    }
+
+    /**
+     * @brief Called with the op's resource context before `body`, e.g. to allocate from staging
+     */
+    std::function<void(const ResourceContext &)> onRun;
+
+    // prepare refuses the resources this many times before accepting
+    int refusals = 0;
+
+    std::atomic<int> estimateCalls{0};
+
+    // estimatedUsage busy waits this long
+    std::chrono::nanoseconds estimateDelay{0};
+
+private:
+    size_t m_memory;
+    Body m_body;
+    std::atomic<int> *m_live;
+    mutable std::vector<DeviceType> m_types{DeviceType::CPU};
+    std::unique_ptr<ResourceContext> m_rctx;
+};
+
+/**
+ * @brief A TaskExecutor without its scheduling thread, passes are driven by the test.
+ */
+class ExecutorHarness
+{
+public:
+    explicit ExecutorHarness(size_t cpuMemory, size_t numThreads = 2)
+        : ExecutorHarness(Resources{{resources::CPU0Memory, cpuMemory}}, numThreads)
+    {
+    }
+
+    explicit ExecutorHarness(const Resources &limits, size_t numThreads = 2)
+        : m_pool(ThreadPoolOptions{}.setNumThreads(numThreads))
+        , m_exec(m_pool, m_resMon, m_param)
+    {
+        m_resMon.initializeLimits(limits);
+    }
+
+    ~ExecutorHarness()
+    {
+        // ops still finishing in the pool refer to the executor
+        waitFor([this]() { return m_live.load() == 0; });
+        // as does paging
+        m_exec.stopExecution();
+    }
+
+    TaskExecutor &executor()
+    {
+        return m_exec;
+    }
+
+    ResourceMonitor &resourceMonitor()
+    {
+        return m_resMon;
+    }
+
+    SchedulingParam &schedulingParam()
+    {
+        return m_param;
+    }
+
+    PSessionItem addSession(std::string handle)
+    {
+        return addSession(std::move(handle), {devices::GPU0});
+    }
+
+    /**
+     * @brief Add a session with lanes on `gpus`, the first one being the primary
+     */
+    PSessionItem addSession(std::string handle, std::vector<DeviceSpec> gpus)
+    {
+        auto sess = std::make_shared<SessionItem>(std::move(handle));
+        sess->gpus = std::move(gpus);
+        m_exec.insertSession(sess);
+        return sess;
+    }
+
+    std::unique_ptr<FakeOpTask> makeOp(size_t memory, FakeOpTask::Body body = {})
+    {
+        return std::make_unique<FakeOpTask>(memory, std::move(body), &m_live);
+    }
+
+    void queue(const PSessionItem &sess, size_t memory, FakeOpTask::Body body = {})
+    {
+        queue(sess, makeOp(memory, std::move(body)));
+    }
+
+    void queue(const PSessionItem &sess, std::unique_ptr<FakeOpTask> op)
+    {
+        auto opItem = std::make_shared<OperationItem>();
+        opItem->sess = sess;
+        opItem->op = std::move(op);
+        m_exec.queueTask(std::move(opItem));
+    }
+
+    /**
+     * @brief Run scheduling passes until `pred` holds
+     * @returns false on timeout
+     */
+    template<typename Pred>
+    bool runUntil(Pred &&pred, std::chrono::milliseconds timeout = std::chrono::seconds(10))
+    {
+        auto deadline = std::chrono::steady_clock::now() + timeout;
+        while (!pred()) {
+            if (std::chrono::steady_clock::now() > deadline) {
+                return false;
+            }
+            m_exec.runSchedulingPass();
+            std::this_thread::yield();
+        }
+        return true;
+    }
+
+    template<typename Pred>
+    static bool waitFor(Pred &&pred, std::chrono::milliseconds timeout = std::chrono::seconds(10))
+    {
+        auto deadline = std::chrono::steady_clock::now() + timeout;
+        while (!pred()) {
+            if (std::chrono::steady_clock::now() > deadline) {
+                return false;
+            }
+            std::this_thread::sleep_for(std::chrono::microseconds(100));
+        }
+        return true;
+    }
+
+private:
+    ThreadPool m_pool;
+    ResourceMonitor m_resMon;
+    SchedulingParam m_param;
+    TaskExecutor m_exec;
+    std::atomic<int> m_live{0};
+};
+
+} // namespace salus::test
+
+#endif // SALUS_TESTS_FAKEEXECUTION_H
@@ -0,0 +1,120 @@
+/*
+ * Copyright 2019 Peifeng Yu <peifeng@umich.edu>
+ * 
+ * This file is part of Salus
+ * (see https://github.com/SymbioticLab/Salus).
+ * 
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * 
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef SALUS_TESTS_TIEREDMEMORY_H
+#define SALUS_TESTS_TIEREDMEMORY_H
+
+#include "support/fakeexecution.h"
+#include "utils/threadutils.h"
+
+#include <atomic>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace salus::test {
+
+/**
+ * @brief Two-tier memory of a fake session: GPU allocations can be moved to CPU on request.
+ *
+ * Like a real device to host copy, GPU memory is freed after the copy completes, not inside
+ * the paging callback, which runs with the session locked.
+ */
+class FakeTieredMemory
+{
+public:
+    ~FakeTieredMemory()
+    {
+        for (auto &t : m_copies) {
+            t.join();
+        }
+    }
+
+    /**
+     * @brief Allocate `memory` on the GPU the op is placed on, which is held until paged out.
+     */
+    std::unique_ptr<FakeOpTask> allocOp(ExecutorHarness &h, size_t memory, std::atomic<int> &done)
+    {
+        auto op = h.makeOp(memory, [&done]() { done.fetch_add(1); });
+        op->setDeviceTypes({DeviceType::GPU});
+        op->onRun = [this, memory](const ResourceContext &rctx) {
+            // runs in the pool, the test checks session usage instead of asserting here
+            if (!rctx.alloc(ResourceType::MEMORY, memory)) {
+                return;
+            }
+            auto g = sstl::with_guard(m_mu);
+            m_onGPU.try_emplace(rctx.ticket(), std::make_unique<ResourceContext>(rctx, rctx.spec()), memory);
+            m_allocated.emplace_back(rctx.ticket());
+        };
+        return op;
+    }
+
+    PagingCallbacks callbacks()
+    {
+        return {[this](uint64_t victim, std::unique_ptr<ResourceContext> &&rctx) -> size_t {
+            auto g = sstl::with_guard(m_mu);
+            auto it = m_onGPU.find(victim);
+            if (it == m_onGPU.end()) {
+                return 0;
+            }
+            auto &[gpuCtx, memory] = it->second;
+            if (!rctx->alloc(ResourceType::MEMORY, memory)) {
+                return 0;
+            }
+            auto released = memory;
+            m_copies.emplace_back([gpuCtx = std::move(gpuCtx), memory = memory]() {
+                gpuCtx->dealloc(ResourceType::MEMORY, memory);
+            });
+            m_paged.emplace_back(victim);
+            m_onCPU.emplace_back(std::move(rctx));
+            m_onGPU.erase(it);
+            return released;
+        }};
+    }
+
+    /**
+     * @brief Tickets in allocation order
+     */
+    std::vector<uint64_t> allocated() const
+    {
+        auto g = sstl::with_guard(m_mu);
+        return m_allocated;
+    }
+
+    std::vector<uint64_t> paged() const
+    {
+        auto g = sstl::with_guard(m_mu);
+        return m_paged;
+    }
+
+private:
+    mutable std::mutex m_mu;
+    std::map<uint64_t, std::pair<std::unique_ptr<ResourceContext>, size_t>> m_onGPU;
+    std::vector<std::unique_ptr<ResourceContext>> m_onCPU;
+    std::vector<uint64_t> m_allocated;
+    std::vector<uint64_t> m_paged;
+    std::vector<std::thread> m_copies;
+};
+
+} // namespace salus::test
+
+#endif // SALUS_TESTS_TIEREDMEMORY_H
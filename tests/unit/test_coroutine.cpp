@@ -0,0 +1,215 @@
+/*
+ * Copyright 2019 Peifeng Yu <peifeng@umich.edu>
+ * 
+ * This file is part of Salus
+ * (see https://github.com/SymbioticLab/Salus).
+ * 
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * 
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "execution/threadpool/awaitable.h"
+#include "utils/coroutineutils.h"
+
+#include <catch2/catch.hpp>
+
+#include <atomic>
+#include <coroutine>
+#include <exception>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+using sstl::Task;
+
+namespace {
+
+/**
+ * Starts right away and frees itself when done, so a test can leave it suspended on an
+ * awaitable and resume it from the same thread.
+ */
+struct Eager
+{
+    struct promise_type
+    {
+        Eager get_return_object() const noexcept
+        {
+            return {};
+        }
+        std::suspend_never initial_suspend() const noexcept
+        {
+            return {};
+        }
+        std::suspend_never final_suspend() const noexcept
+        {
+            return {};
+        }
+        void return_void() const noexcept
+        {
+        }
+        void unhandled_exception() const noexcept
+        {
+            std::terminate();
+        }
+    };
+};
+
+Task<int> answer()
+{
+    co_return 42;
+}
+
+Task<int> sumOfAnswers(int n)
+{
+    int sum = 0;
+    for (int i = 0; i != n; ++i) {
+        sum += co_await answer();
+    }
+    co_return sum;
+}
+
+Task<> fail()
+{
+    throw std::runtime_error("failed");
+    co_return;
+}
+
+Task<bool> catchFailure()
+{
+    try {
+        co_await fail();
+    } catch (const std::runtime_error &) {
+        co_return true;
+    }
+    co_return false;
+}
+
+Task<std::thread::id> hop(ThreadPool &pool)
+{
+    co_await scheduleOn(pool);
+    co_return std::this_thread::get_id();
+}
+
+Eager waitAndRecord(sstl::async_notification &note, std::vector<int> &order, int id)
+{
+    co_await note;
+    order.push_back(id);
+}
+
+Eager takeAndRecord(sstl::async_semaphore &sem, uint64_t c, std::vector<int> &order, int id)
+{
+    co_await sem.wait(c);
+    order.push_back(id);
+}
+
+/**
+ * Takes turns with its peer: wait for mine, hop onto the pool, hand the turn over.
+ */
+Task<> takeTurns(ThreadPool &pool, sstl::async_semaphore &mine, sstl::async_semaphore &theirs, int rounds,
+                 std::atomic<int> &turns)
+{
+    for (int i = 0; i != rounds; ++i) {
+        co_await mine.wait();
+        co_await scheduleOn(pool);
+        turns.fetch_add(1);
+        theirs.notify();
+    }
+}
+
+} // namespace
+
+TEST_CASE("Tasks return values and exceptions to the awaiter", "[coroutine]")
+{
+    CHECK(sstl::syncWait(answer()) == 42);
+    CHECK(sstl::syncWait(sumOfAnswers(3)) == 126);
+    CHECK_THROWS_AS(sstl::syncWait(fail()), std::runtime_error);
+    CHECK(sstl::syncWait(catchFailure()));
+}
+
+TEST_CASE("Awaiting a thread pool resumes on a worker", "[coroutine][threadpool]")
+{
+    ThreadPool pool(ThreadPoolOptions{}.setNumThreads(1));
+    CHECK(sstl::syncWait(hop(pool)) != std::this_thread::get_id());
+}
+
+TEST_CASE("async_notification wakes one waiter per notify", "[coroutine]")
+{
+    sstl::async_notification note;
+    std::vector<int> order;
+
+    SECTION("notified before waiting")
+    {
+        note.notify();
+        CHECK(note.notified());
+        waitAndRecord(note, order, 0);
+        CHECK(order == std::vector<int>{0});
+        CHECK_FALSE(note.notified());
+    }
+
+    SECTION("waiters in order")
+    {
+        waitAndRecord(note, order, 1);
+        waitAndRecord(note, order, 2);
+        CHECK(order.empty());
+
+        note.notify();
+        CHECK(order == std::vector<int>{1});
+        note.notify();
+        CHECK(order == std::vector<int>{1, 2});
+
+        // nobody waiting, kept for the next one
+        note.notify();
+        CHECK(note.notified());
+        waitAndRecord(note, order, 3);
+        CHECK(order == std::vector<int>{1, 2, 3});
+    }
+}
+
+TEST_CASE("async_semaphore serves waiters in order", "[coroutine]")
+{
+    sstl::async_semaphore sem(1);
+    std::vector<int> order;
+
+    // available, taken without suspending
+    takeAndRecord(sem, 1, order, 0);
+    CHECK(order == std::vector<int>{0});
+
+    takeAndRecord(sem, 2, order, 1);
+    takeAndRecord(sem, 1, order, 2);
+    CHECK(sem.may_block(1));
+
+    // enough for the second one, but the first one is ahead
+    sem.notify();
+    CHECK(order == std::vector<int>{0});
+
+    sem.notify(2);
+    CHECK(order == std::vector<int>{0, 1, 2});
+    CHECK_FALSE(sem.may_block(0));
+    CHECK(sem.may_block(1));
+}
+
+TEST_CASE("Coroutines take turns on a pool through semaphores", "[coroutine][threadpool]")
+{
+    constexpr int kRounds = 1000;
+    ThreadPool pool(ThreadPoolOptions{}.setNumThreads(2));
+    sstl::async_semaphore ping;
+    sstl::async_semaphore pong;
+    std::atomic<int> turns{0};
+
+    std::thread t1([&]() { sstl::syncWait(takeTurns(pool, ping, pong, kRounds, turns)); });
+    std::thread t2([&]() { sstl::syncWait(takeTurns(pool, pong, ping, kRounds, turns)); });
+    ping.notify();
+    t1.join();
+    t2.join();
+
+    CHECK(turns.load() == 2 * kRounds);
+}
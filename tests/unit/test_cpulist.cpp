@@ -0,0 +1,124 @@
+/*
+ * Copyright 2019 Peifeng Yu <peifeng@umich.edu>
+ * 
+ * This file is part of Salus
+ * (see https://github.com/SymbioticLab/Salus).
+ * 
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * 
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "platform/thread_annotations.h"
+
+#include <catch2/catch.hpp>
+
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cstdlib>
+#include <fstream>
+#include <string>
+#include <vector>
+
+using salus::threading::numa_nodes;
+using salus::threading::parse_cpu_list;
+
+namespace {
+
+/**
+ * A throwaway directory laid out like /sys/devices/system/node
+ */
+class FakeNodeDir
+{
+public:
+    FakeNodeDir()
+    {
+        char tmpl[] = "/tmp/salus-nodes-XXXXXX";
+        REQUIRE(mkdtemp(tmpl) != nullptr);
+        m_root = tmpl;
+    }
+
+    ~FakeNodeDir()
+    {
+        for (auto it = m_files.rbegin(); it != m_files.rend(); ++it) {
+            unlink(it->c_str());
+        }
+        for (auto it = m_dirs.rbegin(); it != m_dirs.rend(); ++it) {
+            rmdir(it->c_str());
+        }
+        rmdir(m_root.c_str());
+    }
+
+    void add(const std::string &entry, const std::string &cpulist)
+    {
+        auto dir = m_root + "/" + entry;
+        REQUIRE(mkdir(dir.c_str(), 0755) == 0);
+        m_dirs.emplace_back(dir);
+
+        auto file = dir + "/cpulist";
+        std::ofstream(file) << cpulist << "\n";
+        m_files.emplace_back(file);
+    }
+
+    const std::string &path() const
+    {
+        return m_root;
+    }
+
+private:
+    std::string m_root;
+    std::vector<std::string> m_dirs;
+    std::vector<std::string> m_files;
+};
+
+} // namespace
+
+TEST_CASE("Parse cpulist with multiple ranges", "[cpulist]")
+{
+    CHECK(parse_cpu_list("0-3,8-11") == std::vector<int>{0, 1, 2, 3, 8, 9, 10, 11});
+    CHECK(parse_cpu_list("0-1,4,6-7") == std::vector<int>{0, 1, 4, 6, 7});
+    CHECK(parse_cpu_list("5") == std::vector<int>{5});
+    CHECK(parse_cpu_list("0-1,24-25,48-49,72-73")
+          == std::vector<int>{0, 1, 24, 25, 48, 49, 72, 73});
+}
+
+TEST_CASE("Parse cpulist skips empty and malformed ranges", "[cpulist]")
+{
+    CHECK(parse_cpu_list("").empty());
+    CHECK(parse_cpu_list("0,,2") == std::vector<int>{0, 2});
+    CHECK(parse_cpu_list("x,3") == std::vector<int>{3});
+    CHECK(parse_cpu_list("3-1").empty());
+}
+
+TEST_CASE("NUMA nodes are read in node id order", "[cpulist]")
+{
+    FakeNodeDir sysfs;
+    sysfs.add("node10", "40-43");
+    sysfs.add("node0", "0-3,8-11");
+    sysfs.add("node2", "4-7,12-15");
+    // memory only node
+    sysfs.add("node1", "");
+    // not nodes
+    sysfs.add("possible", "0-10");
+    sysfs.add("nodex", "99");
+
+    auto nodes = numa_nodes(sysfs.path());
+    REQUIRE(nodes.size() == 3);
+    CHECK(nodes[0] == std::vector<int>{0, 1, 2, 3, 8, 9, 10, 11});
+    CHECK(nodes[1] == std::vector<int>{4, 5, 6, 7, 12, 13, 14, 15});
+    CHECK(nodes[2] == std::vector<int>{40, 41, 42, 43});
+}
+
+TEST_CASE("NUMA nodes are empty without topology", "[cpulist]")
+{
+    CHECK(numa_nodes("/nonexistent/salus/node").empty());
+}
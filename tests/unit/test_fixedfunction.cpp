@@ -0,0 +1,172 @@
+/*
+ * Copyright 2019 Peifeng Yu <peifeng@umich.edu>
+ * 
+ * This file is part of Salus
+ * (see https://github.com/SymbioticLab/Salus).
+ * 
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * 
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "utils/fixed_function.hpp"
+
+#include <catch2/catch.hpp>
+
+#include <array>
+
+namespace {
+
+struct Counts
+{
+    int constructed = 0;
+    int destroyed = 0;
+    int calls = 0;
+
+    int live() const
+    {
+        return constructed - destroyed;
+    }
+};
+
+/**
+ * Callable of about Size bytes that counts its own constructions, destructions and calls
+ */
+template<size_t Size>
+struct Tracked
+{
+    Counts *counts;
+    int value;
+    std::array<char, Size> payload{};
+
+    Tracked(Counts *c, int v)
+        : counts(c)
+        , value(v)
+    {
+        ++counts->constructed;
+    }
+
+    Tracked(Tracked &&other)
+        : counts(other.counts)
+        , value(other.value)
+        , payload(other.payload)
+    {
+        ++counts->constructed;
+    }
+
+    Tracked(const Tracked &) = delete;
+
+    ~Tracked()
+    {
+        ++counts->destroyed;
+    }
+
+    int operator()()
+    {
+        ++counts->calls;
+        return value;
+    }
+};
+
+using Small = sstl::FixedFunction<int(), 32>;
+using SmallCapture = Tracked<8>;
+using LargeCapture = Tracked<256>;
+// beyond the largest spill pool block, goes to global new
+using HugeCapture = Tracked<8192>;
+
+static_assert(Small::fits_inline<SmallCapture>);
+static_assert(!Small::fits_inline<LargeCapture>);
+static_assert(!Small::fits_inline<HugeCapture>);
+
+} // namespace
+
+TEMPLATE_TEST_CASE("FixedFunction move keeps one live callable", "[fixedfunction]", SmallCapture, LargeCapture,
+                   HugeCapture)
+{
+    Counts counts;
+    {
+        Small f{TestType(&counts, 42)};
+        REQUIRE(f);
+        CHECK(counts.live() == 1);
+
+        Small g(std::move(f));
+        CHECK_FALSE(f);
+        REQUIRE(g);
+        CHECK(g() == 42);
+        if (!Small::fits_inline<TestType>) {
+            // spilled callables are not moved, only the pointer to them is
+            CHECK(counts.live() == 1);
+            CHECK(counts.constructed == 2);
+        }
+    }
+    CHECK(counts.live() == 0);
+    CHECK(counts.calls == 1);
+}
+
+TEMPLATE_TEST_CASE("FixedFunction move assign destroys the old callable once", "[fixedfunction]", SmallCapture,
+                   LargeCapture, HugeCapture)
+{
+    // an inline callable leaves a moved-from copy behind until its owner goes away
+    constexpr bool spilled = !Small::fits_inline<TestType>;
+    Counts older;
+    Counts newer;
+    {
+        Small f{TestType(&older, 1)};
+        Small g{TestType(&newer, 2)};
+        CHECK(older.live() == 1);
+
+        f = std::move(g);
+        CHECK(older.live() == 0);
+        CHECK(older.destroyed == older.constructed);
+        if (spilled) {
+            CHECK(newer.live() == 1);
+        }
+        CHECK_FALSE(g);
+        CHECK(f() == 2);
+
+        // moving back and forth keeps a single live spilled callable
+        g = std::move(f);
+        f = std::move(g);
+        CHECK(f() == 2);
+
+        // into an empty one
+        Small h;
+        h = std::move(f);
+        CHECK(h() == 2);
+        if (spilled) {
+            CHECK(newer.live() == 1);
+        }
+    }
+    CHECK(older.live() == 0);
+    CHECK(newer.live() == 0);
+}
+
+TEMPLATE_TEST_CASE("FixedFunction destroys its callable exactly once", "[fixedfunction]", SmallCapture,
+                   LargeCapture, HugeCapture)
+{
+    Counts counts;
+    {
+        Small f{TestType(&counts, 7)};
+        Small moved(std::move(f));
+        Small assigned;
+        assigned = std::move(moved);
+        // f and moved are empty, their destructors must not touch the callable again
+    }
+    CHECK(counts.live() == 0);
+    CHECK(counts.destroyed == counts.constructed);
+}
+
+TEST_CASE("Empty FixedFunction throws when called", "[fixedfunction]")
+{
+    Small f;
+    CHECK_FALSE(f);
+    CHECK_THROWS_AS(f(), std::runtime_error);
+}
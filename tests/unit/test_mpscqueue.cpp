@@ -0,0 +1,141 @@
+/*
+ * Copyright 2019 Peifeng Yu <peifeng@umich.edu>
+ * 
+ * This file is part of Salus
+ * (see https://github.com/SymbioticLab/Salus).
+ * 
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * 
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "utils/mpscqueue.h"
+
+#include <catch2/catch.hpp>
+
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <vector>
+
+namespace {
+
+struct Item : public sstl::MpscHook<Item>
+{
+    int producer = 0;
+    int seq = 0;
+
+    Item(int p, int s)
+        : producer(p)
+        , seq(s)
+    {
+    }
+};
+
+} // namespace
+
+TEST_CASE("MpscQueue pops in push order on one thread", "[mpscqueue]")
+{
+    sstl::MpscQueue<Item> q;
+    CHECK(q.pop() == nullptr);
+
+    for (int i = 0; i != 10; ++i) {
+        q.push(std::make_shared<Item>(0, i));
+    }
+    for (int i = 0; i != 10; ++i) {
+        auto item = q.pop();
+        REQUIRE(item);
+        CHECK(item->seq == i);
+    }
+    CHECK(q.pop() == nullptr);
+
+    // popped nodes can be queued again
+    auto item = std::make_shared<Item>(0, 42);
+    q.push(std::shared_ptr<Item>(item));
+    auto popped = q.pop();
+    q.push(std::move(popped));
+    CHECK(q.pop() == item);
+    CHECK(q.pop() == nullptr);
+}
+
+TEST_CASE("MpscQueue releases queued items on destruction", "[mpscqueue]")
+{
+    std::weak_ptr<Item> weak;
+    {
+        sstl::MpscQueue<Item> q;
+        auto item = std::make_shared<Item>(0, 0);
+        weak = item;
+        q.push(std::move(item));
+        CHECK_FALSE(weak.expired());
+    }
+    CHECK(weak.expired());
+}
+
+TEST_CASE("MpscQueue keeps per-producer order and loses nothing under contention", "[mpscqueue]")
+{
+    constexpr int kProducers = 4;
+    constexpr int kItemsPerProducer = 50000;
+
+    sstl::MpscQueue<Item> q;
+    std::atomic<int> started{0};
+
+    std::vector<std::thread> producers;
+    for (int p = 0; p != kProducers; ++p) {
+        producers.emplace_back([&, p]() {
+            started.fetch_add(1);
+            while (started.load() != kProducers) {
+            }
+            for (int i = 0; i != kItemsPerProducer; ++i) {
+                q.push(std::make_shared<Item>(p, i));
+            }
+        });
+    }
+
+    // consume concurrently with the producers
+    std::vector<int> next(kProducers, 0);
+    int received = 0;
+    bool ordered = true;
+    while (received != kProducers * kItemsPerProducer) {
+        auto item = q.pop();
+        if (!item) {
+            // empty, or a push in progress
+            std::this_thread::yield();
+            continue;
+        }
+        ordered = ordered && item->seq == next[item->producer];
+        next[item->producer] = item->seq + 1;
+        ++received;
+    }
+    for (auto &thr : producers) {
+        thr.join();
+    }
+
+    CHECK(ordered);
+    for (int p = 0; p != kProducers; ++p) {
+        CHECK(next[p] == kItemsPerProducer);
+    }
+    CHECK(q.pop() == nullptr);
+}
+
+TEST_CASE("MpscQueue drainTo takes everything pushed before it", "[mpscqueue]")
+{
+    sstl::MpscQueue<Item> q;
+    for (int i = 0; i != 100; ++i) {
+        q.push(std::make_shared<Item>(0, i));
+    }
+    std::vector<std::shared_ptr<Item>> out;
+    CHECK(q.drainTo(out) == 100);
+    REQUIRE(out.size() == 100);
+    for (int i = 0; i != 100; ++i) {
+        CHECK(out[i]->seq == i);
+    }
+    CHECK(q.drainTo(out) == 0);
+}
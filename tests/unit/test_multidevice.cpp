@@ -0,0 +1,154 @@
+/*
+ * Copyright 2019 Peifeng Yu <peifeng@umich.edu>
+ * 
+ * This file is part of Salus
+ * (see https://github.com/SymbioticLab/Salus).
+ * 
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * 
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "support/fakeexecution.h"
+#include "support/tieredmemory.h"
+
+#include "execution/scheduler/impl/fair.h"
+
+#include <catch2/catch.hpp>
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+using namespace salus;
+using namespace salus::test;
+
+static_assert(devices::kNumScheduledGPUs > 1, "Multi-device tests need SALUS_ENABLE_MULTI_DEVICE");
+
+TEST_CASE("Limits cover the discovered GPUs only", "[multidevice]")
+{
+    auto gpuMemory = [](int id) { return ResourceTag{ResourceType::MEMORY, DeviceSpec{DeviceType::GPU, id}}; };
+
+    ResourceMonitor resMon;
+    resMon.initializeLimitsForGPUs({1000, 2000});
+    auto avail = resMon.lock().denseAvailable();
+    CHECK(avail.get(resources::GPU0Memory) == 1000);
+    CHECK(avail.get(resources::GPU1Memory) == 2000);
+    CHECK(avail.get({ResourceType::GPU_STREAM, devices::GPU1}) == 128);
+    CHECK_FALSE(avail.has(gpuMemory(2)));
+
+    // more GPUs than the scheduler tracks, the extra ones are left out
+    resMon.initializeLimitsForGPUs(std::vector<size_t>(devices::kNumScheduledGPUs + 2, 1000));
+    avail = resMon.lock().denseAvailable();
+    CHECK(avail.has(gpuMemory(devices::kNumScheduledGPUs - 1)));
+    CHECK_FALSE(avail.has(gpuMemory(devices::kNumScheduledGPUs)));
+}
+
+TEST_CASE("Ops pre-allocate on the session's primary GPU first", "[multidevice]")
+{
+    ExecutorHarness h({{resources::CPU0Memory, 1_sz << 30},
+                       {resources::GPU0Memory, 1000},
+                       {resources::GPU1Memory, 1000}});
+    auto sess = h.addSession("sess", {devices::GPU1, devices::GPU0});
+
+    FakeTieredMemory mem;
+    std::atomic<int> done{0};
+
+    h.queue(sess, mem.allocOp(h, 600, done));
+    REQUIRE(h.runUntil([&]() { return done.load() == 1; }));
+    CHECK(sess->resourceUsage(resources::GPU1Memory) == 600);
+    CHECK(sess->resourceUsage(resources::GPU0Memory) == 0);
+
+    // no room left on GPU1, falls back to the next GPU of the session
+    h.queue(sess, mem.allocOp(h, 600, done));
+    REQUIRE(h.runUntil([&]() { return done.load() == 2; }));
+    CHECK(sess->resourceUsage(resources::GPU1Memory) == 600);
+    CHECK(sess->resourceUsage(resources::GPU0Memory) == 600);
+}
+
+TEST_CASE("Paging picks victims by memory on the blocked GPU", "[multidevice][paging]")
+{
+    ExecutorHarness h({{resources::CPU0Memory, 1_sz << 30},
+                       {resources::GPU0Memory, 500},
+                       {resources::GPU1Memory, 1000}});
+    auto big = h.addSession("big", {devices::GPU1});
+    auto cold = h.addSession("cold", {devices::GPU0, devices::GPU1});
+    auto blocked = h.addSession("blocked", {devices::GPU1});
+
+    FakeTieredMemory bigMem;
+    FakeTieredMemory coldMem;
+    cold->setPagingCallbacks(coldMem.callbacks());
+
+    std::atomic<int> done{0};
+    h.queue(big, bigMem.allocOp(h, 500, done));
+    REQUIRE(h.runUntil([&]() { return done.load() == 1; }));
+
+    // the older and larger ticket of the cold session is on GPU0, which paging GPU1 must not pick
+    h.queue(cold, coldMem.allocOp(h, 400, done));
+    REQUIRE(h.runUntil([&]() { return done.load() == 2; }));
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    h.queue(cold, coldMem.allocOp(h, 150, done));
+    REQUIRE(h.runUntil([&]() { return done.load() == 3; }));
+    REQUIRE(cold->resourceUsage(resources::GPU0Memory) == 400);
+    REQUIRE(cold->resourceUsage(resources::GPU1Memory) == 150);
+    auto allocated = coldMem.allocated();
+    REQUIRE(allocated.size() == 2);
+
+    // only 350 left on GPU1
+    auto op = h.makeOp(400, [&done]() { done.fetch_add(1); });
+    op->setDeviceTypes({DeviceType::GPU});
+    h.queue(blocked, std::move(op));
+    REQUIRE(h.runUntil([&]() { return done.load() == 4; }));
+
+    auto paged = coldMem.paged();
+    REQUIRE(paged.size() == 1);
+    CHECK(paged.front() == allocated.back());
+    CHECK(cold->resourceUsage(resources::GPU0Memory) == 400);
+    CHECK(cold->resourceUsage(resources::GPU1Memory) == 0);
+    CHECK(cold->resourceUsage(resources::CPU0Memory) == 150);
+
+    CHECK(bigMem.paged().empty());
+    CHECK(big->resourceUsage(resources::GPU1Memory) == 500);
+}
+
+TEST_CASE("Fair sharing charges memory on all GPUs of a session", "[multidevice][fair]")
+{
+    ExecutorHarness h(1_sz << 30);
+    FairScheduler fair(h.executor());
+
+    // on GPU0 alone, spread has less than single, but more in total
+    auto spread = std::make_shared<SessionItem>("spread");
+    spread->gpus = {devices::GPU0, devices::GPU1};
+    spread->notifyAlloc(1, 1, resources::GPU0Memory, 200);
+    spread->notifyAlloc(1, 1, resources::GPU1Memory, 200);
+    auto single = std::make_shared<SessionItem>("single");
+    single->notifyAlloc(1, 2, resources::GPU0Memory, 300);
+    CHECK(spread->gpuMemoryUsage() == 400);
+    CHECK(single->gpuMemoryUsage() == 300);
+
+    SessionList sessions{spread, single};
+    boost::container::small_vector<PSessionItem, 2> candidates;
+
+    // both are new, virtual time starts from zero
+    SessionChangeSet added;
+    added.numAddedSessions = sessions.size();
+    added.addedSessionBegin = sessions.begin();
+    added.addedSessionEnd = sessions.end();
+    fair.notifyPreSchedulingIteration(sessions, added, &candidates);
+    REQUIRE(candidates.size() == 2);
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    fair.notifyPreSchedulingIteration(sessions, {}, &candidates);
+    REQUIRE(candidates.size() == 2);
+    CHECK(candidates[0] == single);
+    CHECK(candidates[1] == spread);
+}
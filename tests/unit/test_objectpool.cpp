@@ -0,0 +1,163 @@
+/*
+ * Copyright 2019 Peifeng Yu <peifeng@umich.edu>
+ * 
+ * This file is part of Salus
+ * (see https://github.com/SymbioticLab/Salus).
+ * 
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * 
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "utils/objectpool.h"
+
+#include <catch2/catch.hpp>
+
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <set>
+#include <thread>
+#include <vector>
+
+TEST_CASE("BlockPool recycles freed blocks instead of growing", "[objectpool]")
+{
+    sstl::BlockPool pool;
+    constexpr size_t kSize = 200;
+
+    std::vector<void *> blocks;
+    for (size_t i = 0; i != sstl::BlockPool::kBlocksPerSlab; ++i) {
+        blocks.emplace_back(pool.allocate(kSize));
+    }
+    CHECK(pool.numSlabs() == 1);
+    CHECK(pool.blockSize() == kSize);
+
+    // distinct and aligned like operator new
+    std::set<void *> unique(blocks.begin(), blocks.end());
+    CHECK(unique.size() == blocks.size());
+    for (auto ptr : blocks) {
+        CHECK(reinterpret_cast<uintptr_t>(ptr) % alignof(std::max_align_t) == 0);
+    }
+
+    for (int round = 0; round != 10; ++round) {
+        for (auto ptr : blocks) {
+            pool.deallocate(ptr, kSize);
+        }
+        for (auto &ptr : blocks) {
+            ptr = pool.allocate(kSize);
+            CHECK(unique.count(ptr) == 1);
+        }
+    }
+    CHECK(pool.numSlabs() == 1);
+
+    // one more than a slab holds needs a new slab
+    auto extra = pool.allocate(kSize);
+    CHECK(pool.numSlabs() == 2);
+    pool.deallocate(extra, kSize);
+    for (auto ptr : blocks) {
+        pool.deallocate(ptr, kSize);
+    }
+}
+
+TEST_CASE("BlockPool serves other sizes from global new", "[objectpool]")
+{
+    sstl::BlockPool pool;
+    auto block = pool.allocate(64);
+    auto other = pool.allocate(128);
+    CHECK(pool.numSlabs() == 1);
+    CHECK(pool.blockSize() == 64);
+    std::memset(other, 0xab, 128);
+    pool.deallocate(other, 128);
+    pool.deallocate(block, 64);
+}
+
+TEST_CASE("BlockPool hands out each block to one owner across threads", "[objectpool]")
+{
+    sstl::BlockPool pool;
+    constexpr size_t kSize = 96;
+    constexpr int kThreads = 4;
+    constexpr int kRounds = 2000;
+    constexpr int kLive = 16;
+
+    std::atomic<bool> corrupted{false};
+    std::vector<std::thread> threads;
+    for (int t = 0; t != kThreads; ++t) {
+        threads.emplace_back([&, t]() {
+            std::vector<unsigned char *> live;
+            for (int r = 0; r != kRounds; ++r) {
+                auto tag = static_cast<unsigned char>(t * kRounds + r);
+                auto ptr = static_cast<unsigned char *>(pool.allocate(kSize));
+                std::memset(ptr, tag, kSize);
+                live.emplace_back(ptr);
+                if (live.size() == kLive) {
+                    for (auto p : live) {
+                        // nobody else wrote to a block we own
+                        if (std::memcmp(p, p + 1, kSize - 1) != 0) {
+                            corrupted = true;
+                        }
+                        pool.deallocate(p, kSize);
+                    }
+                    live.clear();
+                }
+            }
+            for (auto p : live) {
+                pool.deallocate(p, kSize);
+            }
+        });
+    }
+    for (auto &thr : threads) {
+        thr.join();
+    }
+    CHECK_FALSE(corrupted);
+    // at most kThreads * kLive blocks are live at any time
+    CHECK(pool.numSlabs() <= (kThreads * kLive) / sstl::BlockPool::kBlocksPerSlab + kThreads);
+}
+
+namespace {
+struct Tracked
+{
+    static inline std::atomic<int> alive{0};
+    char payload[40];
+
+    Tracked()
+    {
+        alive.fetch_add(1);
+    }
+    ~Tracked()
+    {
+        alive.fetch_sub(1);
+    }
+};
+} // namespace
+
+TEST_CASE("PoolAllocator with allocate_shared reuses the block and keeps the pool alive", "[objectpool]")
+{
+    auto pool = std::make_shared<sstl::BlockPool>();
+    std::weak_ptr<sstl::BlockPool> weakPool = pool;
+
+    // object and control block share one block, and freed blocks are reused
+    for (size_t i = 0; i != 4 * sstl::BlockPool::kBlocksPerSlab; ++i) {
+        auto item = std::allocate_shared<Tracked>(sstl::PoolAllocator<Tracked>(pool));
+        CHECK(Tracked::alive.load() == 1);
+    }
+    CHECK(Tracked::alive.load() == 0);
+    CHECK(pool->numSlabs() == 1);
+
+    auto second = std::allocate_shared<Tracked>(sstl::PoolAllocator<Tracked>(pool));
+
+    // the object outlives the last outside reference to its pool
+    pool.reset();
+    CHECK_FALSE(weakPool.expired());
+    second.reset();
+    CHECK(weakPool.expired());
+    CHECK(Tracked::alive.load() == 0);
+}
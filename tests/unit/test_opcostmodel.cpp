@@ -0,0 +1,102 @@
+/*
+ * Copyright 2019 Peifeng Yu <peifeng@umich.edu>
+ * 
+ * This file is part of Salus
+ * (see https://github.com/SymbioticLab/Salus).
+ * 
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * 
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "execution/scheduler/opcostmodel.h"
+
+#include <catch2/catch.hpp>
+
+#include <string>
+
+using namespace salus;
+using namespace std::chrono;
+
+namespace {
+
+void train(OpCostModel &model, const std::string &opType, DeviceType dt, microseconds dur)
+{
+    for (uint64_t i = 0; i != OpCostModel::kMinSamples; ++i) {
+        model.record(opType, dt, dur, {});
+    }
+}
+
+DeviceType first(OpCostModel &model, const std::string &opType, size_t transferBytes)
+{
+    OpCostModel::Devices devs{devices::CPU0, devices::GPU0};
+    model.place(opType, devs, transferBytes);
+    return devs.front().type;
+}
+
+} // namespace
+
+TEST_CASE("Cost model moves ops to where they finish first", "[costmodel]")
+{
+    OpCostModel model;
+    train(model, "MatMul", DeviceType::CPU, microseconds(100));
+    train(model, "MatMul", DeviceType::GPU, microseconds(50));
+
+    OpCostModel::Devices devs{devices::CPU0, devices::GPU0};
+    auto pred = model.place("MatMul", devs, 0);
+    CHECK(devs.front() == devices::GPU0);
+    CHECK(pred.execUs[static_cast<size_t>(DeviceType::CPU)] == Approx(100));
+    CHECK(pred.execUs[static_cast<size_t>(DeviceType::GPU)] == Approx(50));
+
+    // the copy makes the GPU finish later than staying on CPU: 50 + 10 + 85 > 100
+    constexpr size_t kBytes = 512 * 1024;
+    static_assert(50 + OpCostModel::kTransferLatencyUs + kBytes / OpCostModel::kTransferBytesPerUs > 100);
+    CHECK(first(model, "MatMul", kBytes) == DeviceType::CPU);
+
+    // ops of unknown type keep the given order
+    devs = {devices::CPU0, devices::GPU0};
+    pred = model.place("", devs, 0);
+    CHECK(devs.front() == devices::CPU0);
+    CHECK(pred.execUs[static_cast<size_t>(DeviceType::GPU)] < 0);
+}
+
+TEST_CASE("Cost model explores device types lacking samples", "[costmodel]")
+{
+    OpCostModel model;
+    train(model, "Add", DeviceType::CPU, microseconds(10));
+
+    uint64_t explored = 0;
+    for (uint64_t i = 1; i <= 2 * OpCostModel::kExploreInterval; ++i) {
+        if (first(model, "Add", 0) == DeviceType::GPU) {
+            ++explored;
+            CHECK(i % OpCostModel::kExploreInterval == 0);
+        }
+    }
+    CHECK(explored == 2);
+    CHECK(model.dumpCounters().find("Add: decisions=32 moved=2 explored=2") != std::string::npos);
+}
+
+TEST_CASE("Cost model pins large ops", "[costmodel]")
+{
+    OpCostModel model;
+    train(model, "Conv", DeviceType::CPU, microseconds(10000));
+    train(model, "Conv", DeviceType::GPU, microseconds(1));
+    train(model, "Big", DeviceType::CPU, microseconds(10));
+
+    CHECK(first(model, "Conv", OpCostModel::kMaxMovedBytes) == DeviceType::GPU);
+    CHECK(first(model, "Conv", OpCostModel::kMaxMovedBytes + 1) == DeviceType::CPU);
+
+    // not even explored
+    for (uint64_t i = 0; i != 2 * OpCostModel::kExploreInterval; ++i) {
+        CHECK(first(model, "Big", OpCostModel::kMaxMovedBytes + 1) == DeviceType::CPU);
+    }
+    CHECK(model.dumpCounters().find("Big: decisions=32 moved=0 explored=0") != std::string::npos);
+}
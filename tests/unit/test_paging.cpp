@@ -0,0 +1,73 @@
+/*
+ * Copyright 2019 Peifeng Yu <peifeng@umich.edu>
+ * 
+ * This file is part of Salus
+ * (see https://github.com/SymbioticLab/Salus).
+ * 
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * 
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "support/fakeexecution.h"
+#include "support/tieredmemory.h"
+
+#include <catch2/catch.hpp>
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+
+using namespace salus;
+using namespace salus::test;
+
+TEST_CASE("Blocked GPU op gets memory paged out from a colder session", "[paging]")
+{
+    ExecutorHarness h({{resources::CPU0Memory, 1_sz << 30}, {resources::GPU0Memory, 1000}});
+    auto big = h.addSession("big");
+    auto cold = h.addSession("cold");
+    auto blocked = h.addSession("blocked");
+
+    FakeTieredMemory bigMem;
+    FakeTieredMemory coldMem;
+    cold->setPagingCallbacks(coldMem.callbacks());
+
+    std::atomic<int> done{0};
+    h.queue(big, bigMem.allocOp(h, 500, done));
+    REQUIRE(h.runUntil([&]() { return done.load() == 1; }));
+
+    // two tickets in the cold session, the first one unused for longer, so paged first
+    h.queue(cold, coldMem.allocOp(h, 150, done));
+    REQUIRE(h.runUntil([&]() { return done.load() == 2; }));
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    h.queue(cold, coldMem.allocOp(h, 150, done));
+    REQUIRE(h.runUntil([&]() { return done.load() == 3; }));
+    REQUIRE(cold->resourceUsage(resources::GPU0Memory) == 300);
+    auto allocated = coldMem.allocated();
+    REQUIRE(allocated.size() == 2);
+
+    // only 200 left, paging one cold ticket is not enough, both go to CPU
+    auto op = h.makeOp(400, [&done]() { done.fetch_add(1); });
+    op->setDeviceTypes({DeviceType::GPU});
+    h.queue(blocked, std::move(op));
+    REQUIRE(h.runUntil([&]() { return done.load() == 4; }));
+
+    auto paged = coldMem.paged();
+    REQUIRE(paged.size() == 2);
+    CHECK(paged == allocated);
+    CHECK(cold->stats.paged.load() == 2);
+    CHECK(cold->resourceUsage(resources::GPU0Memory) == 0);
+    CHECK(cold->resourceUsage(resources::CPU0Memory) == 300);
+
+    // the largest session is kept on GPU
+    CHECK(bigMem.paged().empty());
+    CHECK(big->resourceUsage(resources::GPU0Memory) == 500);
+}
@@ -0,0 +1,136 @@
+/*
+ * Copyright 2019 Peifeng Yu <peifeng@umich.edu>
+ * 
+ * This file is part of Salus
+ * (see https://github.com/SymbioticLab/Salus).
+ * 
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * 
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "support/fakeexecution.h"
+#include "utils/containerutils.h"
+
+#include <catch2/catch.hpp>
+
+#include <atomic>
+
+using namespace salus;
+using namespace salus::test;
+
+namespace {
+
+size_t availableMemory(ResourceMonitor &resMon)
+{
+    return sstl::getOrDefault(resMon.lock().available(), resources::CPU0Memory, 0);
+}
+
+} // namespace
+
+TEST_CASE("Batch admits whole ops and leaves the rest untouched", "[prealloc]")
+{
+    ExecutorHarness h(1000, 4);
+    auto sess = h.addSession("s");
+    h.executor().runSchedulingPass();
+
+    std::atomic<bool> release{false};
+    std::atomic<int> running{0};
+    std::atomic<int> done{0};
+    auto body = [&]() {
+        running.fetch_add(1);
+        ExecutorHarness::waitFor([&]() { return release.load(); });
+        done.fetch_add(1);
+    };
+    h.queue(sess, 600, body);
+    h.queue(sess, 300, body);
+    h.queue(sess, 300, body);
+
+    h.executor().runSchedulingPass();
+    REQUIRE(ExecutorHarness::waitFor([&]() { return running.load() == 2; }));
+
+    // the two smaller ops hold exactly their estimates, the 600 one holds nothing
+    CHECK(availableMemory(h.resourceMonitor()) == 400);
+    CHECK(sess->stats.scheduled.load() == 2);
+
+    release = true;
+    REQUIRE(h.runUntil([&]() { return done.load() == 3; }));
+    REQUIRE(ExecutorHarness::waitFor([&]() { return availableMemory(h.resourceMonitor()) == 1000; }));
+}
+
+TEST_CASE("All admissible ops of a session go out in one pass", "[prealloc]")
+{
+    ExecutorHarness h(1_sz << 30);
+    auto sess = h.addSession("s");
+    h.executor().runSchedulingPass();
+
+    constexpr int kOps = 64;
+    std::atomic<int> done{0};
+    for (int i = 0; i != kOps; ++i) {
+        h.queue(sess, 1024, [&done]() { done.fetch_add(1); });
+    }
+
+    h.executor().runSchedulingPass();
+    CHECK(sess->stats.scheduled.load() == kOps);
+    REQUIRE(ExecutorHarness::waitFor([&]() { return done.load() == kOps; }));
+    REQUIRE(ExecutorHarness::waitFor([&]() { return availableMemory(h.resourceMonitor()) == (1_sz << 30); }));
+}
+
+TEST_CASE("Ops not fitting anywhere are retried until they fit", "[prealloc]")
+{
+    ExecutorHarness h(1000);
+    auto sess = h.addSession("s");
+
+    std::atomic<int> done{0};
+    for (int i = 0; i != 10; ++i) {
+        h.queue(sess, 400, [&done]() { done.fetch_add(1); });
+    }
+
+    // at most two fit at a time, the rest stay queued without partial reservations
+    REQUIRE(h.runUntil([&]() {
+        CHECK(availableMemory(h.resourceMonitor()) >= 200);
+        return done.load() == 10;
+    }));
+}
+
+TEST_CASE("Ops are estimated and placed once however many times they are tried", "[prealloc]")
+{
+    ExecutorHarness h(1_sz << 30);
+    auto sess = h.addSession("s");
+    h.executor().runSchedulingPass();
+
+    std::atomic<bool> release{false};
+    std::atomic<bool> running{false};
+    auto op = h.makeOp(1024, [&]() {
+        running = true;
+        ExecutorHarness::waitFor([&]() { return release.load(); });
+    });
+    op->setDeviceTypes({DeviceType::GPU, DeviceType::CPU});
+    // go through the per-op fallback path a few times
+    op->refusals = 8;
+    auto *raw = op.get();
+    h.queue(sess, std::move(op));
+
+    h.executor().runSchedulingPass();
+    // refused once in the batch, then on each device in the fallback
+    REQUIRE(raw->refusals == 5);
+    // one for each device, plus the transfer size for the cost model
+    const auto calls = raw->estimateCalls.load();
+    CHECK(calls == 3);
+
+    // keep the session active with new ops, so the refused one is tried in every pass
+    REQUIRE(h.runUntil([&]() {
+        h.queue(sess, 1);
+        return running.load();
+    }));
+    CHECK(raw->estimateCalls.load() == calls);
+    release = true;
+}
@@ -0,0 +1,127 @@
+/*
+ * Copyright 2019 Peifeng Yu <peifeng@umich.edu>
+ * 
+ * This file is part of Salus
+ * (see https://github.com/SymbioticLab/Salus).
+ * 
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * 
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "support/fakeexecution.h"
+
+#include <catch2/catch.hpp>
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+using namespace salus;
+using namespace salus::test;
+
+TEST_CASE("Only sessions with queued ops are scheduled", "[readyset]")
+{
+    ExecutorHarness h(1_sz << 30);
+
+    std::vector<PSessionItem> idle;
+    for (int i = 0; i != 100; ++i) {
+        idle.emplace_back(h.addSession("idle" + std::to_string(i)));
+    }
+    std::vector<PSessionItem> busy;
+    for (int i = 0; i != 4; ++i) {
+        busy.emplace_back(h.addSession("busy" + std::to_string(i)));
+    }
+
+    std::atomic<int> done{0};
+    constexpr int kOpsPerSession = 50;
+    for (auto &sess : busy) {
+        for (int i = 0; i != kOpsPerSession; ++i) {
+            h.queue(sess, 1024, [&done]() { done.fetch_add(1); });
+        }
+    }
+
+    REQUIRE(h.runUntil([&]() { return done.load() == kOpsPerSession * 4; }));
+
+    for (auto &sess : busy) {
+        CHECK(sess->stats.scheduled.load() == kOpsPerSession);
+    }
+    for (auto &sess : idle) {
+        CHECK(sess->stats.scheduled.load() == 0);
+        CHECK(sess->stats.blocked.load() == 0);
+    }
+}
+
+TEST_CASE("Blocked session is retried once resources are released", "[readyset]")
+{
+    ExecutorHarness h(1000);
+    auto sess = h.addSession("s");
+
+    std::atomic<bool> release{false};
+    std::atomic<int> firstRunning{0};
+    std::atomic<int> secondRan{0};
+    h.queue(sess, 600, [&]() {
+        firstRunning = 1;
+        ExecutorHarness::waitFor([&]() { return release.load(); });
+    });
+    h.queue(sess, 600, [&]() { secondRan = 1; });
+
+    REQUIRE(h.runUntil([&]() { return firstRunning.load() == 1; }));
+
+    // nothing new is queued and nothing is freed, so the second op stays blocked
+    for (int i = 0; i != 20; ++i) {
+        h.executor().runSchedulingPass();
+    }
+    CHECK(secondRan.load() == 0);
+    CHECK(sess->stats.blocked.load() > 0);
+
+    // finishing the first op frees its memory, which alone must get the session retried
+    release = true;
+    REQUIRE(h.runUntil([&]() { return secondRan.load() == 1; }));
+}
+
+TEST_CASE("Ops queued while passes run are not lost", "[readyset]")
+{
+    ExecutorHarness h(1_sz << 30, 4);
+
+    constexpr int kProducers = 4;
+    constexpr int kOpsPerProducer = 500;
+    std::vector<PSessionItem> sessions;
+    for (int i = 0; i != kProducers / 2; ++i) {
+        sessions.emplace_back(h.addSession("s" + std::to_string(i)));
+    }
+
+    std::atomic<int> done{0};
+    std::vector<std::thread> producers;
+    for (int p = 0; p != kProducers; ++p) {
+        // two producers per session, so the ready flag races with both pushes and draining
+        producers.emplace_back([&, p]() {
+            auto &sess = sessions[p % sessions.size()];
+            for (int i = 0; i != kOpsPerProducer; ++i) {
+                h.queue(sess, 16, [&done]() { done.fetch_add(1); });
+                if (i % 64 == 0) {
+                    std::this_thread::yield();
+                }
+            }
+        });
+    }
+
+    REQUIRE(h.runUntil([&]() { return done.load() == kProducers * kOpsPerProducer; }));
+    for (auto &thr : producers) {
+        thr.join();
+    }
+
+    uint64_t scheduled = 0;
+    for (auto &sess : sessions) {
+        scheduled += sess->stats.scheduled.load();
+    }
+    CHECK(scheduled == kProducers * kOpsPerProducer);
+}
@@ -0,0 +1,66 @@
+/*
+ * Copyright 2019 Peifeng Yu <peifeng@umich.edu>
+ * 
+ * This file is part of Salus
+ * (see https://github.com/SymbioticLab/Salus).
+ * 
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * 
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "resources/resources.h"
+
+#include <catch2/catch.hpp>
+
+using namespace salus;
+
+TEST_CASE("Dense lookups of unseen tags don't intern them", "[resources]")
+{
+    const ResourceTag cpu1{ResourceType::MEMORY, DeviceSpec{DeviceType::CPU, 1}};
+    const ResourceTag gpuOut{ResourceType::MEMORY, DeviceSpec{DeviceType::GPU, devices::kMaxGPUs}};
+
+    DenseResources res(Resources{{resources::CPU0Memory, 100}});
+    for (const auto &tag : {cpu1, gpuOut}) {
+        CHECK_FALSE(DenseResources::findSlot(tag));
+        CHECK_FALSE(res.has(tag));
+        CHECK(res.get(tag) == 0);
+        CHECK_FALSE(DenseResources::findSlot(tag));
+    }
+    CHECK(res.get(resources::CPU0Memory) == 100);
+}
+
+TEST_CASE("Dense arithmetic matches the map version", "[resources]")
+{
+    const ResourceTag gpu1{ResourceType::MEMORY, DeviceSpec{DeviceType::GPU, 1}};
+    const Resources avail{{resources::CPU0Memory, 100}, {gpu1, 50}};
+    const Resources req{{resources::CPU0Memory, 30}, {gpu1, 60}};
+
+    DenseResources davail(avail);
+    DenseResources dreq(req);
+    CHECK(davail.contains(dreq) == resources::contains(avail, req));
+
+    auto merged = avail;
+    resources::merge(merged, req);
+    CHECK(DenseResources(avail).merge(dreq).toResources() == merged);
+
+    auto bounded = avail;
+    resources::subtractBounded(bounded, req);
+    davail.subtractBounded(dreq);
+    CHECK(davail.toResources() == bounded);
+
+    size_t seen = 0;
+    dreq.forEach([&](const auto &tag, auto val) {
+        CHECK(req.at(tag) == val);
+        ++seen;
+    });
+    CHECK(seen == req.size());
+}
@@ -0,0 +1,125 @@
+/*
+ * Copyright 2019 Peifeng Yu <peifeng@umich.edu>
+ * 
+ * This file is part of Salus
+ * (see https://github.com/SymbioticLab/Salus).
+ * 
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * 
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "utils/statsutils.h"
+
+#include <catch2/catch.hpp>
+
+#include <thread>
+#include <vector>
+
+TEST_CASE("StripedCounter sums adds from all threads", "[stats]")
+{
+    sstl::StripedCounter<> counter;
+    CHECK(counter.load() == 0);
+
+    constexpr int kThreads = 8;
+    constexpr int kAdds = 100000;
+    std::vector<std::thread> threads;
+    for (int t = 0; t != kThreads; ++t) {
+        threads.emplace_back([&counter, t]() {
+            for (int i = 0; i != kAdds; ++i) {
+                counter.add(t % 2 ? 1 : 2);
+            }
+        });
+    }
+    for (auto &t : threads) {
+        t.join();
+    }
+    CHECK(counter.load() == uint64_t{kAdds} * (kThreads / 2) * 3);
+}
+
+TEST_CASE("LogHistogram puts values in power of two buckets", "[stats]")
+{
+    sstl::LogHistogram<8> hist;
+    for (uint64_t v : {0, 1, 2, 3, 4, 7, 8, 127, 128, 100000}) {
+        hist.record(v);
+    }
+
+    auto snap = hist.snapshot();
+    CHECK(snap.count == 10);
+    CHECK(snap.sum == 0 + 1 + 2 + 3 + 4 + 7 + 8 + 127 + 128 + 100000);
+    CHECK(snap.buckets[0] == 1); // 0
+    CHECK(snap.buckets[1] == 1); // 1
+    CHECK(snap.buckets[2] == 2); // 2, 3
+    CHECK(snap.buckets[3] == 2); // 4, 7
+    CHECK(snap.buckets[4] == 1); // 8
+    CHECK(snap.buckets[7] == 3); // 127, and the overflow of 128 and 100000
+}
+
+TEST_CASE("LogHistogram quantiles and differences", "[stats]")
+{
+    sstl::LogHistogram<> hist;
+    CHECK(hist.snapshot().quantile(0.5) == 0);
+
+    for (int i = 0; i != 90; ++i) {
+        hist.record(10);
+    }
+    auto first = hist.snapshot();
+    for (int i = 0; i != 10; ++i) {
+        hist.record(1000);
+    }
+    auto second = hist.snapshot();
+
+    CHECK(second.quantile(0.5) == 15);
+    CHECK(second.quantile(0.99) == 1023);
+    CHECK(second.quantile(0.0) == 15);
+
+    auto diff = second.since(first);
+    CHECK(diff.count == 10);
+    CHECK(diff.sum == 10000);
+    CHECK(diff.quantile(0.5) == 1023);
+}
+
+TEST_CASE("LogHistogram loses no records from concurrent threads", "[stats]")
+{
+    sstl::LogHistogram<> hist;
+
+    constexpr int kThreads = 4;
+    constexpr int kRecords = 50000;
+    std::vector<std::thread> threads;
+    for (int t = 0; t != kThreads; ++t) {
+        threads.emplace_back([&hist]() {
+            for (int i = 0; i != kRecords; ++i) {
+                hist.record(static_cast<uint64_t>(i));
+            }
+        });
+    }
+
+    // snapshots taken meanwhile never see more than has been recorded
+    uint64_t last = 0;
+    for (int i = 0; i != 100; ++i) {
+        auto count = hist.snapshot().count;
+        CHECK(count >= last);
+        CHECK(count <= uint64_t{kThreads} * kRecords);
+        last = count;
+    }
+    for (auto &t : threads) {
+        t.join();
+    }
+
+    auto snap = hist.snapshot();
+    CHECK(snap.count == uint64_t{kThreads} * kRecords);
+    uint64_t total = 0;
+    for (auto b : snap.buckets) {
+        total += b;
+    }
+    CHECK(total == snap.count);
+    CHECK(snap.sum == uint64_t{kThreads} * kRecords * (kRecords - 1) / 2);
+}
@@ -0,0 +1,374 @@
+/*
+ * Copyright 2019 Peifeng Yu <peifeng@umich.edu>
+ * 
+ * This file is part of Salus
+ * (see https://github.com/SymbioticLab/Salus).
+ * 
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * 
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "execution/threadpool/threadpool.h"
+#include "config.h"
+
+#include <catch2/catch.hpp>
+
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace {
+
+/**
+ * Keeps the only worker of a pool busy until released, so closures submitted meanwhile
+ * all sit in its queue and the pick order is up to the pool.
+ */
+class WorkerGate
+{
+public:
+    explicit WorkerGate(ThreadPool &pool)
+    {
+        pool.run([this]() {
+            m_entered = true;
+            while (!m_open) {
+                std::this_thread::yield();
+            }
+        });
+        while (!m_entered) {
+            std::this_thread::yield();
+        }
+    }
+
+    void open()
+    {
+        m_open = true;
+    }
+
+private:
+    std::atomic<bool> m_entered{false};
+    std::atomic<bool> m_open{false};
+};
+
+struct RunOrder
+{
+    std::mutex mu;
+    std::vector<int> order;
+
+    void record(int id)
+    {
+        std::lock_guard<std::mutex> g(mu);
+        order.push_back(id);
+    }
+
+    void waitFor(size_t n)
+    {
+        while (true) {
+            {
+                std::lock_guard<std::mutex> g(mu);
+                if (order.size() == n) {
+                    return;
+                }
+            }
+            std::this_thread::yield();
+        }
+    }
+};
+
+/**
+ * Fill the worker queues of a pool whose workers are all held, until a closure is rejected.
+ * @returns number of closures queued
+ */
+int fillQueues(ThreadPool &pool, std::atomic<int> &done)
+{
+    int queued = 0;
+    while (!pool.tryRun([&done]() { ++done; })) {
+        ++queued;
+    }
+    return queued;
+}
+
+template<typename Pred>
+bool waitFor(Pred &&pred)
+{
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+    while (!pred()) {
+        if (std::chrono::steady_clock::now() > deadline) {
+            return false;
+        }
+        std::this_thread::yield();
+    }
+    return true;
+}
+
+} // namespace
+
+TEST_CASE("ThreadPool runs higher priority closures first", "[threadpool]")
+{
+    ThreadPool pool(ThreadPoolOptions{}.setNumThreads(1));
+    RunOrder ro;
+
+    WorkerGate gate(pool);
+    // ids below 4 are Normal, the rest High
+    for (int i = 0; i != 8; ++i) {
+        pool.run([&ro, i]() { ro.record(i); },
+                 i < 4 ? ThreadPool::Priority::Normal : ThreadPool::Priority::High);
+    }
+    gate.open();
+    ro.waitFor(8);
+
+    // an aging pick may let one Normal closure in early, but never more
+    size_t lastHigh = 0;
+    for (size_t i = 0; i != ro.order.size(); ++i) {
+        if (ro.order[i] >= 4) {
+            lastHigh = i;
+        }
+    }
+    CHECK(lastHigh <= 4);
+}
+
+TEST_CASE("ThreadPool does not starve lower priority closures", "[threadpool]")
+{
+    ThreadPool pool(ThreadPoolOptions{}.setNumThreads(1));
+    RunOrder ro;
+
+    constexpr int kHigh = 64;
+    WorkerGate gate(pool);
+    pool.run([&ro]() { ro.record(-1); }, ThreadPool::Priority::Low);
+    for (int i = 0; i != kHigh; ++i) {
+        pool.run([&ro, i]() { ro.record(i); }, ThreadPool::Priority::High);
+    }
+    gate.open();
+    ro.waitFor(kHigh + 1);
+
+    // with more picks than the aging period, the Low closure gets a turn before High runs out
+    CHECK(ro.order.back() != -1);
+}
+
+TEST_CASE("ThreadPool runs single level closures in submission order", "[threadpool]")
+{
+    ThreadPool pool(ThreadPoolOptions{}.setNumThreads(1));
+    RunOrder ro;
+
+    WorkerGate gate(pool);
+    for (int i = 0; i != 32; ++i) {
+        pool.run([&ro, i]() { ro.record(i); });
+    }
+    gate.open();
+    ro.waitFor(32);
+
+    std::vector<int> expected(32);
+    for (int i = 0; i != 32; ++i) {
+        expected[i] = i;
+    }
+    CHECK(ro.order == expected);
+}
+
+TEST_CASE("ThreadPool worker counters add up", "[threadpool]")
+{
+    ThreadPool pool(ThreadPoolOptions{}.setNumThreads(1));
+
+    // a closure in the pool fills the worker's own queue, then some more from outside
+    constexpr int kLocal = 64;
+    constexpr int kRemote = 16;
+    std::atomic<int> done{0};
+    pool.run([&pool, &done]() {
+        for (int i = 0; i != kLocal; ++i) {
+            pool.run([&done]() { ++done; });
+        }
+        ++done;
+    });
+    for (int i = 0; i != kRemote; ++i) {
+        pool.run([&done]() { ++done; });
+    }
+    while (done != kLocal + kRemote + 1) {
+        std::this_thread::yield();
+    }
+
+    auto stats = pool.workerStats();
+#if defined(SALUS_ENABLE_THREADPOOL_STATS)
+    REQUIRE(stats.size() == 1);
+    const auto &ws = stats[0];
+    CHECK(ws.tasks == kLocal + kRemote + 1);
+    CHECK(ws.localTasks + ws.stolenTasks + ws.overflowTasks == ws.tasks);
+    CHECK(ws.maxQueueDepth >= kLocal);
+    // the worker may be parked right now, but never unparked more than parked
+    CHECK(ws.unparks <= ws.parks);
+    CHECK(ws.parks - ws.unparks <= 1);
+#else
+    // compiled out, nothing is kept
+    CHECK(stats.empty());
+#endif
+}
+
+TEST_CASE("Elastic ThreadPool grows when busy and shrinks when idle", "[threadpool]")
+{
+    using namespace std::chrono;
+    ThreadPool pool(ThreadPoolOptions{}.setNumThreads(4).setElastic(1, milliseconds(10)));
+    CHECK(pool.numActiveThreads() == 1);
+
+    // keep every worker busy and keep submitting, until the pool grows
+    std::atomic<bool> release{false};
+    std::atomic<int> running{0};
+    auto deadline = steady_clock::now() + seconds(5);
+    while (pool.numActiveThreads() < 4 && steady_clock::now() < deadline) {
+        pool.run([&release, &running]() {
+            ++running;
+            while (!release) {
+                std::this_thread::sleep_for(microseconds(100));
+            }
+            --running;
+        });
+        std::this_thread::sleep_for(microseconds(500));
+    }
+    CHECK(pool.numActiveThreads() == 4);
+    release = true;
+
+    // idle workers retire the next time they look for work
+    deadline = steady_clock::now() + seconds(5);
+    while (pool.numActiveThreads() > 1 && steady_clock::now() < deadline) {
+        pool.run([]() {});
+        std::this_thread::sleep_for(milliseconds(2));
+    }
+    CHECK(pool.numActiveThreads() == 1);
+    while (running != 0) {
+        std::this_thread::yield();
+    }
+}
+
+TEST_CASE("Elastic ThreadPool loses no closure while workers retire", "[threadpool]")
+{
+    using namespace std::chrono;
+    // retire on every idle moment, so submissions keep racing with retiring workers
+    ThreadPool pool(ThreadPoolOptions{}.setNumThreads(4).setElastic(1, milliseconds(0)));
+
+    std::atomic<int> done{0};
+    int expected = 0;
+    bool stuck = false;
+    for (int round = 0; round != 2000 && !stuck; ++round) {
+        const int burst = 1 + round % 8;
+        for (int i = 0; i != burst; ++i) {
+            pool.run([&done]() { ++done; });
+        }
+        expected += burst;
+
+        const auto deadline = steady_clock::now() + seconds(5);
+        while (done != expected) {
+            if (steady_clock::now() > deadline) {
+                stuck = true;
+                break;
+            }
+            std::this_thread::yield();
+        }
+    }
+    CHECK_FALSE(stuck);
+    CHECK(done == expected);
+}
+
+TEST_CASE("Nested parallelFor completes", "[threadpool]")
+{
+    // Inner loops run inside outer subranges, so every worker can end up waiting in an
+    // inner group while subranges of that group get forked by other threads
+    for (size_t threads : {1, 2, 4}) {
+        ThreadPool pool(ThreadPoolOptions{}.setNumThreads(threads));
+        for (int round = 0; round != 50; ++round) {
+            std::atomic<size_t> sum{0};
+            pool.parallelFor(0, 32, 1, [&pool, &sum](size_t first, size_t last) {
+                for (auto i = first; i != last; ++i) {
+                    pool.parallelFor(0, 32, 1, [&sum, i](size_t f, size_t l) {
+                        for (auto j = f; j != l; ++j) {
+                            sum += i * 32 + j;
+                        }
+                    });
+                }
+            });
+            CHECK(sum == 1024 * 1023 / 2);
+        }
+    }
+}
+
+TEST_CASE("ThreadPool handles full queues as the policy says", "[threadpool]")
+{
+    ThreadPool pool(ThreadPoolOptions{}.setNumThreads(1).setMaxOverflow(2));
+    std::atomic<int> done{0};
+
+    WorkerGate gate(pool);
+    auto queued = fillQueues(pool, done);
+    CHECK(queued > 0);
+    CHECK(pool.overflowStats().rejected == 1);
+
+    // Overflow goes to the overflow queue until that is full as well
+    CHECK_FALSE(pool.tryRun([&done]() { ++done; }, ThreadPool::Priority::Normal, ThreadPool::OverflowPolicy::Overflow));
+    CHECK_FALSE(pool.tryRun([&done]() { ++done; }, ThreadPool::Priority::Normal, ThreadPool::OverflowPolicy::Overflow));
+    CHECK(pool.tryRun([&done]() { ++done; }, ThreadPool::Priority::Normal, ThreadPool::OverflowPolicy::Overflow));
+
+    // Inline runs right here
+    auto caller = std::this_thread::get_id();
+    std::thread::id ranOn;
+    CHECK_FALSE(pool.tryRun([&ranOn]() { ranOn = std::this_thread::get_id(); }, ThreadPool::Priority::Normal,
+                            ThreadPool::OverflowPolicy::Inline));
+    CHECK(ranOn == caller);
+
+    // Reject hands it back
+    CHECK(pool.tryRun([&done]() { ++done; }, ThreadPool::Priority::Normal, ThreadPool::OverflowPolicy::Reject));
+
+    auto stats = pool.overflowStats();
+    CHECK(stats.overflowed == 2);
+    CHECK(stats.inlined == 1);
+    CHECK(stats.rejected == 3);
+    CHECK(stats.depth == 2);
+    CHECK(stats.maxDepth == 2);
+
+    // nothing is submitted after this, so the overflowed closures only run if the worker
+    // checks the overflow queue before parking
+    gate.open();
+    REQUIRE(waitFor([&]() { return done == queued + 2; }));
+    stats = pool.overflowStats();
+    CHECK(stats.depth == 0);
+    CHECK(stats.maxDepth == 2);
+}
+
+TEST_CASE("ThreadPool batches count what didn't fit", "[threadpool]")
+{
+    ThreadPool pool(ThreadPoolOptions{}.setNumThreads(1).setMaxOverflow(1));
+    std::atomic<int> done{0};
+
+    WorkerGate gate(pool);
+    auto queued = fillQueues(pool, done);
+
+    std::vector<ThreadPool::Closure> batch;
+    for (int i = 0; i != 3; ++i) {
+        batch.emplace_back([&done]() { ++done; });
+    }
+    // one fits in the overflow queue, the rest are left in place
+    CHECK(pool.runBatch(batch, ThreadPool::Priority::Normal, ThreadPool::OverflowPolicy::Overflow) == 2);
+    CHECK_FALSE(batch[0]);
+    CHECK(batch[1]);
+    CHECK(batch[2]);
+
+    CHECK(pool.runBatch(batch.data() + 1, batch.data() + 2, ThreadPool::Priority::Normal,
+                        ThreadPool::OverflowPolicy::Inline) == 0);
+    CHECK(done == 1);
+    CHECK(pool.runBatch(batch.data() + 2, batch.data() + 3, ThreadPool::Priority::Normal,
+                        ThreadPool::OverflowPolicy::Reject) == 1);
+    CHECK(batch[2]);
+
+    auto stats = pool.overflowStats();
+    CHECK(stats.overflowed == 1);
+    CHECK(stats.inlined == 1);
+    // one from filling, two from the Overflow batch and one from the Reject one
+    CHECK(stats.rejected == 4);
+
+    gate.open();
+    REQUIRE(waitFor([&]() { return done == queued + 2; }));
+}
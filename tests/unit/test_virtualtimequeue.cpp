@@ -0,0 +1,110 @@
+/*
+ * Copyright 2019 Peifeng Yu <peifeng@umich.edu>
+ * 
+ * This file is part of Salus
+ * (see https://github.com/SymbioticLab/Salus).
+ * 
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * 
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "execution/scheduler/virtualtimequeue.h"
+
+#include <catch2/catch.hpp>
+
+#include <vector>
+
+using namespace salus;
+
+namespace {
+
+std::vector<int> keys(const VirtualTimeQueue<int> &q)
+{
+    std::vector<int> res;
+    for (const auto &[vtime, key] : q) {
+        res.emplace_back(key);
+    }
+    return res;
+}
+
+} // namespace
+
+TEST_CASE("Virtual time queue follows charges", "[vtime]")
+{
+    VirtualTimeQueue<int> q;
+    q.update(1, 10);
+    q.update(2, 20);
+    q.update(3, 30);
+    CHECK(keys(q) == std::vector<int>{1, 2, 3});
+    CHECK(q.minVirtualTime() == 10);
+
+    q.charge(1, 25);
+    CHECK(keys(q) == std::vector<int>{2, 3, 1});
+    CHECK(q.virtualTime(1) == 35);
+    CHECK(q.minVirtualTime() == 20);
+
+    // ties are broken by key
+    q.charge(2, 10);
+    CHECK(keys(q) == std::vector<int>{2, 3, 1});
+
+    // missing keys start from 0
+    q.charge(4, 5);
+    CHECK(keys(q) == std::vector<int>{4, 2, 3, 1});
+    CHECK(q.size() == 4);
+}
+
+TEST_CASE("Virtual time queue erase", "[vtime]")
+{
+    VirtualTimeQueue<int> q;
+    q.update(1, 10);
+    q.update(2, 20);
+    q.update(3, 30);
+
+    CHECK(q.erase(1));
+    CHECK_FALSE(q.erase(1));
+    CHECK(keys(q) == std::vector<int>{2, 3});
+    CHECK_FALSE(q.virtualTime(1));
+    CHECK(q.minVirtualTime() == 20);
+
+    // an erased key comes back fresh
+    q.charge(1, 25);
+    CHECK(keys(q) == std::vector<int>{2, 1, 3});
+
+    q.clear();
+    CHECK(q.empty());
+    CHECK(q.minVirtualTime() == 0);
+}
+
+TEST_CASE("Tenant sessions split the tenant's weight", "[vtime]")
+{
+    TenantShares shares;
+    shares.add(7, 4.0);
+    shares.add(7, 4.0);
+    shares.add(9, 1.0);
+
+    CHECK(shares.effectiveWeight(7, 4.0) == 2.0);
+    CHECK(shares.effectiveWeight(9, 1.0) == 1.0);
+    // ungrouped and unknown tenants keep their own weight
+    CHECK(shares.effectiveWeight(TenantShares::NoTenant, 3.0) == 3.0);
+    CHECK(shares.effectiveWeight(11, 5.0) == 5.0);
+
+    // the larger weight wins when sessions disagree
+    shares.add(7, 6.0);
+    CHECK(shares.effectiveWeight(7, 4.0) == 2.0);
+
+    // ungrouped sessions aren't counted
+    shares.add(TenantShares::NoTenant, 1.0);
+    CHECK(shares.effectiveWeight(TenantShares::NoTenant, 1.0) == 1.0);
+
+    shares.clear();
+    CHECK(shares.effectiveWeight(7, 4.0) == 4.0);
+}